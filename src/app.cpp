@@ -1,12 +1,16 @@
 #include "app.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 #include <sstream>
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 
+#include <stb_image_write.h>
+
 VKAPI_ATTR VkBool32 VKAPI_CALL _debugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 	VkDebugUtilsMessageTypeFlagsEXT,
@@ -24,40 +28,46 @@ VKAPI_ATTR VkBool32 VKAPI_CALL _debugCallback(
 	return VK_FALSE;
 }
 
-App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_API, GLFW_NO_API } }) {
-	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
-	// the callbacks are installed here but they're overriden below, so we still need to manually call those
-	// functions in the handlers
-	ImGui_ImplGlfw_InitForVulkan(_window.getRawHandle(), true);
-	// imgui-vulkan is initialized later with the queue & render pass
-
-	_window.setMouseButtonHandler([this](int button, int action, int mods) {
-		_onMouseButtonEvent(button, action, mods);
-		});
-	_window.setCursorPosHandler([this](double x, double y) {
-		_onMouseMoveEvent(x, y);
-		});
-	_window.setScrollHandler([this](double x, double y) {
-		_onScrollEvent(x, y);
-		});
+App::App(
+	std::string scene, bool ignorePointLights, const LightGeneratorSettings &lightSettings,
+	bool compactGBuffer, bool visibilityBuffer, bool bindlessMaterials, bool gpuCulling, bool asyncCompute,
+	std::optional<vk::Extent2D> headlessExtent
+) {
+	if (!headlessExtent) {
+		_window = glfw::Window({ { GLFW_CLIENT_API, GLFW_NO_API } });
+
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		// the callbacks are installed here but they're overriden below, so we still need to manually call those
+		// functions in the handlers
+		ImGui_ImplGlfw_InitForVulkan(_window->getRawHandle(), true);
+		// imgui-vulkan is initialized later with the queue & render pass
+
+		_window->setMouseButtonHandler([this](int button, int action, int mods) {
+			_onMouseButtonEvent(button, action, mods);
+			});
+		_window->setCursorPosHandler([this](double x, double y) {
+			_onMouseMoveEvent(x, y);
+			});
+		_window->setScrollHandler([this](double x, double y) {
+			_onScrollEvent(x, y);
+			});
+	}
 
 	{
-		vk::Extent2D extent = _window.getFramebufferSize();
+		vk::Extent2D extent = _window ? _window->getFramebufferSize() : headlessExtent.value();
 		_camera.aspectRatio = extent.width / static_cast<float>(extent.height);
 		_camera.recomputeAttributes();
 	}
 
-	std::vector<const char*> requiredExtensions = glfw::getRequiredInstanceExtensions();
+	std::vector<const char*> requiredExtensions;
+	std::vector<const char*> requiredDeviceExtensions;
+	if (_window) {
+		requiredExtensions = glfw::getRequiredInstanceExtensions();
+		requiredDeviceExtensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
 	requiredExtensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	requiredExtensions.emplace_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-	std::vector<const char*> requiredDeviceExtensions{
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-#ifndef RENDERDOC_CAPTURE
-		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
-		VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME
-#endif
-	};
 	std::vector<const char*> requiredLayers{
 #ifndef NDEBUG
 		"VK_LAYER_KHRONOS_validation"
@@ -69,10 +79,10 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 	vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeature;
 	accelerationStructureFeature.setAccelerationStructure(true);
 	std::vector<const char*> requiredDeviceRayTracingExtensions{
-#ifndef RENDERDOC_CAPTURE
+		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+		VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
 		VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
-		VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
-#endif
+		VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME
 	};
 
 	{ // check extension & layer support
@@ -125,6 +135,8 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 	_dynamicDispatcher.init(_instance.get());
 	std::vector<void*> featureStructs; // VKRay
+	bool supportsRTExtensions = false;
+	bool isDiscreteGpu = false;
 	{ // pick physical device
 		auto physicalDevices = _instance->enumeratePhysicalDevices();
 		for (const vk::PhysicalDevice& dev : physicalDevices) {
@@ -135,7 +147,11 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			std::cout << "    Driver version: " << props.driverVersion << "\n";
 			std::cout << "\n";
 			if (props.deviceType != vk::PhysicalDeviceType::eDiscreteGpu) {
-				continue;
+				// in headless mode, integrated GPUs and CPU implementations like lavapipe are accepted, but discrete
+				// GPUs are still preferred
+				if (_window || (_physicalDevice && isDiscreteGpu)) {
+					continue;
+				}
 			}
 			bool supportsExtensions = checkSupport<&vk::ExtensionProperties::extensionName>(
 				requiredDeviceExtensions, dev.enumerateDeviceExtensionProperties(),
@@ -146,28 +162,37 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			}
 
 			// #VKRay Extension Checking
-			bool supportsRTExtensions = checkSupport<&vk::ExtensionProperties::extensionName>(
+			supportsRTExtensions = checkSupport<&vk::ExtensionProperties::extensionName>(
 				requiredDeviceRayTracingExtensions, dev.enumerateDeviceExtensionProperties(),
 				"device extensions", "    "
 				);
-			if (supportsRTExtensions) {
-				featureStructs.emplace_back(&raytracingFeature);
-				featureStructs.emplace_back(&accelerationStructureFeature);
-				requiredDeviceExtensions.insert(
-					requiredDeviceExtensions.end(),
-					requiredDeviceRayTracingExtensions.begin(), requiredDeviceRayTracingExtensions.end()
-				);
-			}
 
 			_physicalDevice = dev;
+			isDiscreteGpu = props.deviceType == vk::PhysicalDeviceType::eDiscreteGpu;
 		}
 	}
 	if (!_physicalDevice) {
-		std::cout << "Failed to find suitable discrete gpu device\n";
+		std::cout << (_window ? "Failed to find suitable discrete gpu device\n" : "Failed to find suitable device\n");
 		std::abort();
 	}
+#ifndef RENDERDOC_CAPTURE
+	_hardwareRayTracing = supportsRTExtensions;
+#endif
+	if (_hardwareRayTracing) {
+		featureStructs.emplace_back(&raytracingFeature);
+		featureStructs.emplace_back(&accelerationStructureFeature);
+		requiredDeviceExtensions.insert(
+			requiredDeviceExtensions.end(),
+			requiredDeviceRayTracingExtensions.begin(), requiredDeviceRayTracingExtensions.end()
+		);
+	} else {
+		std::cout << "Hardware ray tracing is unavailable, only software visibility tests can be used\n";
+		_visibilityTestMethod = VisibilityTestMethod::software;
+	}
 
-	_surface = _window.createSurface(_instance.get());
+	if (_window) {
+		_surface = _window->createSurface(_instance.get());
+	}
 
 	{
 		auto queueFamilyProps = _physicalDevice.getQueueFamilyProperties();
@@ -178,7 +203,7 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			if (props.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)) {
 				_graphicsComputeQueueIndex = static_cast<uint32_t>(i);
 			}
-			if (_physicalDevice.getSurfaceSupportKHR(static_cast<uint32_t>(i), _surface.get())) {
+			if (_surface && _physicalDevice.getSurfaceSupportKHR(static_cast<uint32_t>(i), _surface.get())) {
 				_presentQueueIndex = static_cast<uint32_t>(i);
 				std::cout << " [Surface support]";
 			}
@@ -191,6 +216,65 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 				return props.queueFlags & vk::QueueFlagBits::eGraphics;
 			}
 		) - queueFamilyProps.begin());
+		if (!_surface) {
+			// nothing is presented, so this is only used to initialize _presentQueue
+			_presentQueueIndex = _graphicsComputeQueueIndex;
+		}
+		if (asyncCompute) {
+			// the passes on the compute queue are profiled too, so it needs to support timestamps
+			auto computeFamily = std::find_if(
+				queueFamilyProps.begin(), queueFamilyProps.end(),
+				[](const vk::QueueFamilyProperties& props) {
+					return
+						(props.queueFlags & vk::QueueFlagBits::eCompute) &&
+						!(props.queueFlags & vk::QueueFlagBits::eGraphics) &&
+						props.timestampValidBits != 0;
+				}
+			);
+			if (computeFamily != queueFamilyProps.end()) {
+				_asyncComputeQueueIndex = static_cast<uint32_t>(computeFamily - queueFamilyProps.begin());
+				std::cout << "Using queue family " << _asyncComputeQueueIndex.value() << " for async compute\n\n";
+			} else {
+				std::cout << "No dedicated compute queue family, disabling async compute\n\n";
+			}
+		}
+
+		auto supportedFeatures = _physicalDevice.getFeatures2<
+			vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features
+		>();
+		const vk::PhysicalDeviceFeatures &supportedFeatures10 =
+			supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features;
+		const vk::PhysicalDeviceVulkan12Features &supportedFeatures12 =
+			supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>();
+		if (visibilityBuffer && !supportedFeatures10.geometryShader) {
+			std::cout << "Geometry shaders are not supported, disabling the visibility buffer\n\n";
+			visibilityBuffer = false;
+		}
+		if (bindlessMaterials) {
+			if (
+				!supportedFeatures12.runtimeDescriptorArray ||
+				!supportedFeatures12.shaderSampledImageArrayNonUniformIndexing
+			) {
+				std::cout << "Descriptor indexing is not supported, disabling bindless materials\n\n";
+				bindlessMaterials = false;
+			}
+		}
+		if (gpuCulling) {
+			// all nodes are drawn with a single call, so materials can't be bound for each of them
+			if (!bindlessMaterials) {
+				std::cout << "GPU culling requires bindless materials, disabling it\n\n";
+				gpuCulling = false;
+			} else if (
+				!supportedFeatures10.multiDrawIndirect ||
+				!supportedFeatures10.drawIndirectFirstInstance ||
+				!supportedFeatures12.drawIndirectCount
+			) {
+				std::cout << "Indirect draw counts are not supported, disabling GPU culling\n\n";
+				gpuCulling = false;
+			}
+		}
+		_gpuCullingSupported = gpuCulling;
+		_gpuCulling = gpuCulling;
 
 		// Setup Vulkan 1.2 Physical Device Info
 		vk::PhysicalDeviceFeatures2 features10;
@@ -198,9 +282,20 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 		vk::PhysicalDeviceVulkan12Features features12;
 		features10.features
 			.setSamplerAnisotropy(true)
-			.setShaderInt64(true);
+			.setShaderInt64(true)
+			// needed for gl_PrimitiveID in visibilityBuffer.frag
+			.setGeometryShader(visibilityBuffer)
+			// GPU culling draws all visible nodes with one call, and passes node indices as first instances
+			.setMultiDrawIndirect(gpuCulling)
+			.setDrawIndirectFirstInstance(gpuCulling);
 		features12
-			.setBufferDeviceAddress(true);
+			.setBufferDeviceAddress(true)
+			// used to synchronize the async compute queue with the graphics queue
+			.setTimelineSemaphore(_asyncComputeQueueIndex.has_value())
+			// used to index the texture array of bindless materials, see bindlessMaterials.glsl
+			.setRuntimeDescriptorArray(bindlessMaterials)
+			.setShaderSampledImageArrayNonUniformIndexing(bindlessMaterials)
+			.setDrawIndirectCount(gpuCulling);
 		features10.pNext = &features11;
 		features11.pNext = &features12;
 
@@ -226,9 +321,14 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 		std::array<float, 1> queuePriorities{ 1.0f };
 		std::vector<vk::DeviceQueueCreateInfo> queueInfos{
-			vk::DeviceQueueCreateInfo({}, _graphicsComputeQueueIndex, queuePriorities),
-			vk::DeviceQueueCreateInfo({}, _presentQueueIndex, queuePriorities)
+			vk::DeviceQueueCreateInfo({}, _graphicsComputeQueueIndex, queuePriorities)
 		};
+		if (_presentQueueIndex != _graphicsComputeQueueIndex) {
+			queueInfos.emplace_back(vk::DeviceQueueCreateInfo({}, _presentQueueIndex, queuePriorities));
+		}
+		if (_asyncComputeQueueIndex) {
+			queueInfos.emplace_back(vk::DeviceQueueCreateInfo({}, _asyncComputeQueueIndex.value(), queuePriorities));
+		}
 
 		vk::DeviceCreateInfo deviceInfo;
 		deviceInfo
@@ -241,6 +341,14 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 
 	_allocator = vma::Allocator::create(vulkanApiVersion, _instance.get(), _physicalDevice, _device.get());
+	if (_asyncComputeQueueIndex) {
+		// buffers are used on both queues without ownership transfers, while the G-buffers are transferred by the frame
+		// graph
+		_allocator.setBufferQueueFamilies({ _graphicsComputeQueueIndex, _asyncComputeQueueIndex.value() });
+	}
+
+	_pipelineCache = PipelineCache::load(_device.get(), _physicalDevice, "pipelineCache.bin");
+	Pass::pipelineCache = _pipelineCache.get();
 
 	// create command pools
 	{
@@ -249,10 +357,28 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setQueueFamilyIndex(_graphicsComputeQueueIndex)
 			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
 		_commandPool = _device->createCommandPoolUnique(poolInfo);
+		if (_asyncComputeQueueIndex) {
+			poolInfo.setQueueFamilyIndex(_asyncComputeQueueIndex.value());
+			_asyncComputeCommandPool = _device->createCommandPoolUnique(poolInfo);
+		}
 	}
 	_transientCommandBufferPool = TransientCommandBufferPool(_device.get(), _graphicsComputeQueueIndex);
+	_gpuProfiler = GpuProfiler::create(
+		_device.get(), _physicalDevice, _graphicsComputeQueueIndex,
+		static_cast<uint32_t>(numGBuffers + maxFramesInFlight + numGBuffers)
+	);
 
-	{
+	if (headlessExtent) {
+		_offscreenImage = _allocator.createImage2D(
+			headlessExtent.value(), offscreenImageFormat,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc
+		);
+		_offscreenReadbackBuffer = _allocator.createBuffer(
+			headlessExtent->width * headlessExtent->height * 4,
+			vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU
+		);
+		_swapchain = Swapchain::createOffscreen({ _offscreenImage.get() }, offscreenImageFormat, headlessExtent.value());
+	} else {
 		_swapchainSharedQueues = { _graphicsComputeQueueIndex, _presentQueueIndex };
 		vk::SurfaceCapabilitiesKHR capabilities = _physicalDevice.getSurfaceCapabilitiesKHR(_surface.get());
 		vk::SurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(_physicalDevice, _surface.get());
@@ -262,7 +388,7 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setMinImageCount(chooseImageCount(capabilities))
 			.setImageFormat(surfaceFormat.format)
 			.setImageColorSpace(surfaceFormat.colorSpace)
-			.setImageExtent(chooseSwapExtent(capabilities, _window))
+			.setImageExtent(chooseSwapExtent(capabilities, _window.value()))
 			.setPresentMode(choosePresentMode(_physicalDevice, _surface.get()))
 			.setImageArrayLayers(1)
 			.setPreTransform(capabilities.currentTransform)
@@ -288,14 +414,17 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 	}
 
 	{ // create descriptor pools
-		std::array<vk::DescriptorPoolSize, 6> staticPoolSizes{
+		std::vector<vk::DescriptorPoolSize> staticPoolSizes{
 			vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 100),
 			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 100),
 			vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 100),
 			vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 100),
-			vk::DescriptorPoolSize(vk::DescriptorType::eAccelerationStructureKHR, 100),
-			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 100)
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 100),
+			vk::DescriptorPoolSize(vk::DescriptorType::eInputAttachment, 100)
 		};
+		if (_hardwareRayTracing) {
+			staticPoolSizes.emplace_back(vk::DescriptorType::eAccelerationStructureKHR, 100);
+		}
 		vk::DescriptorPoolCreateInfo staticPoolInfo;
 		staticPoolInfo
 			.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
@@ -303,14 +432,25 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setMaxSets(100);
 		_staticDescriptorPool = _device->createDescriptorPoolUnique(staticPoolInfo);
 
-		std::array<vk::DescriptorPoolSize, 1> texturePoolSizes{
-			vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, static_cast<uint32_t>(3 * _gltfScene.m_materials.size()))
-		};
+		// with bindless materials, this only holds the set with all textures and the buffers that index them
+		std::vector<vk::DescriptorPoolSize> texturePoolSizes;
+		uint32_t maxTextureSets = 1;
+		if (bindlessMaterials) {
+			texturePoolSizes.emplace_back(
+				vk::DescriptorType::eCombinedImageSampler, SceneBuffers::getBindlessTextureCount(_gltfScene)
+			);
+			texturePoolSizes.emplace_back(vk::DescriptorType::eStorageBuffer, 4);
+		} else {
+			texturePoolSizes.emplace_back(
+				vk::DescriptorType::eCombinedImageSampler, static_cast<uint32_t>(3 * _gltfScene.m_materials.size())
+			);
+			maxTextureSets = static_cast<uint32_t>(_gltfScene.m_materials.size());
+		}
 		vk::DescriptorPoolCreateInfo texturePoolInfo;
 		texturePoolInfo
 			.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
 			.setPoolSizes(texturePoolSizes)
-			.setMaxSets(static_cast<uint32_t>(_gltfScene.m_materials.size()));
+			.setMaxSets(maxTextureSets);
 		_textureDescriptorPool = _device->createDescriptorPoolUnique(texturePoolInfo);
 
 		// initialize imgui descriptor pool
@@ -341,33 +481,76 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 	_graphicsComputeQueue = _device->getQueue(_graphicsComputeQueueIndex, 0);
 	_presentQueue = _device->getQueue(_presentQueueIndex, 0);
+	if (_asyncComputeQueueIndex) {
+		_asyncComputeQueue = _device->getQueue(_asyncComputeQueueIndex.value(), 0);
+		_frameGraph.setQueueFamilies({ _graphicsComputeQueueIndex, _asyncComputeQueueIndex.value() });
+
+		vk::SemaphoreTypeCreateInfo timelineInfo;
+		timelineInfo
+			.setSemaphoreType(vk::SemaphoreType::eTimeline)
+			.setInitialValue(0);
+		vk::SemaphoreCreateInfo semaphoreInfo;
+		semaphoreInfo.setPNext(&timelineInfo);
+		for (std::size_t i = 0; i < 2; ++i) {
+			_queueTimelines.emplace_back(_device->createSemaphoreUnique(semaphoreInfo));
+		}
+		_queueTimelineValues.resize(_queueTimelines.size(), 0);
+	}
 
 
 	_sceneBuffers = SceneBuffers::create(
 		_gltfScene,
 		_allocator, _transientCommandBufferPool,
-		_device.get(), _graphicsComputeQueue
+		_device.get(), _graphicsComputeQueue,
+		lightSettings
 	);
-#ifndef RENDERDOC_CAPTURE
-	_sceneRtBuffers = SceneRaytraceBuffers::create(
-		_device.get(), _allocator, _transientCommandBufferPool, _graphicsComputeQueue,
-		_sceneBuffers, _gltfScene, _dynamicDispatcher
-	);
-#endif
+	if (_hardwareRayTracing) {
+		_sceneRtBuffers = SceneRaytraceBuffers::create(
+			_device.get(), _allocator, _transientCommandBufferPool, _graphicsComputeQueue,
+			_sceneBuffers, _gltfScene, _dynamicDispatcher
+		);
+	}
 	std::cout << "Building AABB tree...";
 	_aabbTree = AabbTree::build(_gltfScene);
 	std::cout << " done\n";
 	_aabbTreeBuffers = AabbTreeBuffers::create(_aabbTree, _allocator);
 
 
-	// create g buffer pass
-	GBuffer::Formats::initialize(_physicalDevice);
-	_gBufferPass = Pass::create<GBufferPass>(_device.get(), _swapchain.getImageExtent());
+	_uniformRingBuffer = UniformRingBuffer::create(_physicalDevice);
+	_gBufferUniformOffset = _uniformRingBuffer.reserve<GBufferPass::Uniforms>();
+	_restirUniformOffset = _uniformRingBuffer.reserve<shader::RestirUniforms>();
+	_lightingPassUniformOffset = _uniformRingBuffer.reserve<shader::LightingPassUniforms>();
+	_cullingUniformOffset = _uniformRingBuffer.reserve<CullingPass::Uniforms>();
+	_uniformRingBuffer.allocate(_allocator, numGBuffers);
 
-	{
-		_gBufferResources.uniformBuffer = _allocator.createTypedBuffer<GBufferPass::Uniforms>(
-			1, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+
+	// create passes
+	GBuffer::Formats::initialize(_physicalDevice, compactGBuffer, visibilityBuffer);
+	_shaderConfig.compactGBuffer = compactGBuffer;
+	// all passes are created here so that their pipelines are compiled in parallel
+	runInParallel({
+		[&]() {
+			_gBufferPass = Pass::create<GBufferPass>(
+				_device.get(), _swapchain.getImageExtent(),
+				bindlessMaterials ? SceneBuffers::getBindlessTextureCount(_gltfScene) : 0
 			);
+		},
+		[&]() { _spatialReusePass = Pass::create<SpatialReusePass>(_device.get()); },
+		[&]() { _restirPass = Pass::create<RestirPass>(_device.get(), _dynamicDispatcher, _hardwareRayTracing); },
+		[&]() {
+			_unbiasedReusePass = UnbiasedReusePass::create(_device.get(), _dynamicDispatcher, _hardwareRayTracing);
+			_unbiasedReusePass.setDispatchLoaderDynamic(_dynamicDispatcher);
+		},
+		[&]() { _lightingPass = Pass::create<LightingPass>(_device.get(), _swapchain.getImageFormat()); },
+		[&]() {
+			if (gpuCulling) {
+				_cullingPass = Pass::create<CullingPass>(_device.get());
+			}
+		}
+	});
+
+	{
+		_gBufferResources.uniformBuffer = _uniformRingBuffer.getBuffer();
 
 		std::array<vk::DescriptorSetLayout, 1> gBufferUniformLayout{ _gBufferPass.getUniformsDescriptorSetLayout() };
 		vk::DescriptorSetAllocateInfo gBufferUniformAlloc;
@@ -376,28 +559,48 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setSetLayouts(gBufferUniformLayout);
 		_gBufferResources.uniformDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferUniformAlloc)[0]);
 
-		std::array<vk::DescriptorSetLayout, 1> gBufferMatricesLayout{ _gBufferPass.getMatricesDescriptorSetLayout() };
-		vk::DescriptorSetAllocateInfo gBufferMatricesAlloc;
-		gBufferMatricesAlloc
-			.setDescriptorPool(_staticDescriptorPool.get())
-			.setSetLayouts(gBufferMatricesLayout);
-		_gBufferResources.matrixDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferMatricesAlloc)[0]);
+		if (bindlessMaterials) {
+			std::array<vk::DescriptorSetLayout, 1> gBufferBindlessLayout{ _gBufferPass.getBindlessDescriptorSetLayout() };
+			vk::DescriptorSetAllocateInfo gBufferBindlessAlloc;
+			gBufferBindlessAlloc
+				.setDescriptorPool(_textureDescriptorPool.get())
+				.setSetLayouts(gBufferBindlessLayout);
+			_gBufferResources.bindlessDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferBindlessAlloc)[0]);
+		} else {
+			std::array<vk::DescriptorSetLayout, 1> gBufferMatricesLayout{ _gBufferPass.getMatricesDescriptorSetLayout() };
+			vk::DescriptorSetAllocateInfo gBufferMatricesAlloc;
+			gBufferMatricesAlloc
+				.setDescriptorPool(_staticDescriptorPool.get())
+				.setSetLayouts(gBufferMatricesLayout);
+			_gBufferResources.matrixDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferMatricesAlloc)[0]);
+
+			std::array<vk::DescriptorSetLayout, 1> gBufferMaterialsLayout{ _gBufferPass.getMaterialDescriptorSetLayout() };
+			vk::DescriptorSetAllocateInfo gBufferMaterialsAlloc;
+			gBufferMaterialsAlloc
+				.setDescriptorPool(_staticDescriptorPool.get())
+				.setSetLayouts(gBufferMaterialsLayout);
+			_gBufferResources.materialDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferMaterialsAlloc)[0]);
+
+			// Scene textures
+			std::vector<vk::DescriptorSetLayout> gBufferTexturesLayout(_gltfScene.m_materials.size());
+			std::fill(gBufferTexturesLayout.begin(), gBufferTexturesLayout.end(), _gBufferPass.getTexturesDescriptorSetLayout());
+			vk::DescriptorSetAllocateInfo gBufferSceneTexturesAlloc;
+			gBufferSceneTexturesAlloc
+				.setDescriptorPool(_textureDescriptorPool.get())
+				.setSetLayouts(gBufferTexturesLayout);
+			_gBufferResources.materialTexturesDescriptors = _device->allocateDescriptorSetsUnique(gBufferSceneTexturesAlloc);
+		}
 
-		std::array<vk::DescriptorSetLayout, 1> gBufferMaterialsLayout{ _gBufferPass.getMaterialDescriptorSetLayout() };
-		vk::DescriptorSetAllocateInfo gBufferMaterialsAlloc;
-		gBufferMaterialsAlloc
-			.setDescriptorPool(_staticDescriptorPool.get())
-			.setSetLayouts(gBufferMaterialsLayout);
-		_gBufferResources.materialDescriptor = std::move(_device->allocateDescriptorSetsUnique(gBufferMaterialsAlloc)[0]);
-
-		// Scene textures
-		std::vector<vk::DescriptorSetLayout> gBufferTexturesLayout(_gltfScene.m_materials.size());
-		std::fill(gBufferTexturesLayout.begin(), gBufferTexturesLayout.end(), _gBufferPass.getTexturesDescriptorSetLayout());
-		vk::DescriptorSetAllocateInfo gBufferSceneTexturesAlloc;
-		gBufferSceneTexturesAlloc
-			.setDescriptorPool(_textureDescriptorPool.get())
-			.setSetLayouts(gBufferTexturesLayout);
-		_gBufferResources.materialTexturesDescriptors = _device->allocateDescriptorSetsUnique(gBufferSceneTexturesAlloc);
+		if (visibilityBuffer) {
+			std::array<vk::DescriptorSetLayout, numGBuffers> resolveLayouts;
+			std::fill(resolveLayouts.begin(), resolveLayouts.end(), _gBufferPass.getResolveDescriptorSetLayout());
+			vk::DescriptorSetAllocateInfo resolveAlloc;
+			resolveAlloc
+				.setDescriptorPool(_staticDescriptorPool.get())
+				.setSetLayouts(resolveLayouts);
+			auto resolveSets = _device->allocateDescriptorSetsUnique(resolveAlloc);
+			std::move(resolveSets.begin(), resolveSets.end(), _gBufferResolveDescriptors.begin());
+		}
 	}
 	_gBufferPass.initializeResourcesFor(_gltfScene, _sceneBuffers, _device, _gBufferResources);
 
@@ -405,36 +608,57 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 	_gBufferPass.scene = &_gltfScene;
 	_gBufferPass.sceneBuffers = &_sceneBuffers;
 
+	if (gpuCulling) {
+		std::array<vk::DescriptorSetLayout, numGBuffers> setLayouts;
+		std::fill(setLayouts.begin(), setLayouts.end(), _cullingPass.getDescriptorSetLayout());
+		vk::DescriptorSetAllocateInfo allocInfo;
+		allocInfo
+			.setDescriptorPool(_staticDescriptorPool.get())
+			.setSetLayouts(setLayouts);
+		auto newSets = _device->allocateDescriptorSetsUnique(allocInfo);
+		std::move(newSets.begin(), newSets.end(), _cullingDescriptors.begin());
+
+		for (std::size_t i = 0; i < numGBuffers; ++i) {
+			_drawCommandBuffers[i] = _allocator.createBuffer(
+				static_cast<uint32_t>(CullingPass::getDrawCommandBufferSize(_gltfScene.m_nodes.size())),
+				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+				vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+				VMA_MEMORY_USAGE_GPU_ONLY
+			);
+			_cullingPass.initializeDescriptorSetFor(
+				_sceneBuffers, _uniformRingBuffer.getBuffer(), _drawCommandBuffers[i].get(),
+				_device.get(), _cullingDescriptors[i].get()
+			);
+		}
+		_cullingPass.nodeCount = static_cast<uint32_t>(_gltfScene.m_nodes.size());
+	}
+
 	for (GBuffer& gbuf : _gBuffers) {
 		gbuf = GBuffer::create(_allocator, _device.get(), _swapchain.getImageExtent(), _gBufferPass);
 	}
 	_transitionGBufferLayouts();
+	_initializeGBufferResolveDescriptors();
 
 
-	_restirUniformBuffer = _allocator.createTypedBuffer<shader::RestirUniforms>(
-		1, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-	{
-		auto* restirUniforms = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
-		restirUniforms->screenSize = nvmath::uvec2(_swapchain.getImageExtent().width, _swapchain.getImageExtent().height);
-		restirUniforms->frame = 0;
-		restirUniforms->spatialPosThreshold = posThreshold;
-		restirUniforms->spatialNormalThreshold = norThreshold;
-		restirUniforms->flags = 0;
-		if (_visibilityTestMethod != VisibilityTestMethod::disabled) {
-			restirUniforms->flags |= RESTIR_VISIBILITY_REUSE_FLAG;
-		}
-		if (_enableTemporalReuse) {
-			restirUniforms->flags |= RESTIR_TEMPORAL_REUSE_FLAG;
-		}
-		restirUniforms->spatialNeighbors = 4;
-		restirUniforms->spatialRadius = 30.0f;
-		_restirUniformBuffer.unmap();
-		_restirUniformBuffer.flush();
-	}
+	_lightTileBuffer = _allocator.createBuffer(
+		static_cast<uint32_t>(RestirPass::getLightTileBufferSize()),
+		vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY
+	);
+	_gBufferResource = _frameGraph.addResource("G-Buffer", numGBuffers);
+	_gBufferKeyResource = _frameGraph.addResource("G-Buffer Keys", numGBuffers);
+	_drawCommandResource = _frameGraph.addResource("Draw Commands", numGBuffers);
+	_reservoirResource = _frameGraph.addResource("Reservoirs", numGBuffers);
+	_lightTileResource = _frameGraph.addResource("Light Tiles");
+	_reservoirTemporaryResource = _frameGraph.addTransientBuffer(
+		"Temporary Reservoirs", vk::BufferUsageFlagBits::eStorageBuffer
+	);
+	// the rest of the uniforms are set before each frame
+	_restirUniforms.screenSize = nvmath::uvec2(_swapchain.getImageExtent().width, _swapchain.getImageExtent().height);
+	_restirUniforms.frame = 0;
+	_restirUniforms.spatialNeighbors = 4;
+	_restirUniforms.spatialRadius = 30.0f;
 
 
-	_spatialReusePass = Pass::create<SpatialReusePass>(_device.get());
 	{
 		std::array<vk::DescriptorSetLayout, numGBuffers> setLayouts;
 		std::fill(setLayouts.begin(), setLayouts.end(), _spatialReusePass.getDescriptorSetLayout());
@@ -459,10 +683,9 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 
 	// Hardware RT pass for visibility test
-	_restirPass = Pass::create<RestirPass>(_device.get(), _dynamicDispatcher);
-#ifndef RENDERDOC_CAPTURE
-	_restirPass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice);
-#endif
+	if (_hardwareRayTracing) {
+		_restirPass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice);
+	}
 	{
 		std::array<vk::DescriptorSetLayout, numGBuffers> setLayouts;
 		std::fill(setLayouts.begin(), setLayouts.end(), _restirPass.getFrameDescriptorSetLayout());
@@ -481,8 +704,7 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setSetLayouts(setLayout);
 		_restirStaticDescriptor = std::move(_device->allocateDescriptorSetsUnique(allocInfo)[0]);
 	}
-#ifndef RENDERDOC_CAPTURE
-	{
+	if (_hardwareRayTracing) {
 		vk::DescriptorSetLayout setLayout = _restirPass.getHardwareRayTraceDescriptorSetLayout();
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo
@@ -490,7 +712,6 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setSetLayouts(setLayout);
 		_restirHardwareRayTraceDescriptor = std::move(_device->allocateDescriptorSetsUnique(allocInfo)[0]);
 	}
-#endif
 	{
 		vk::DescriptorSetLayout setLayout = _restirPass.getSoftwareRayTraceDescriptorSetLayout();
 		vk::DescriptorSetAllocateInfo allocInfo;
@@ -501,11 +722,9 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 	}
 
 
-	_unbiasedReusePass = UnbiasedReusePass::create(_device.get(), _dynamicDispatcher);
-	_unbiasedReusePass.setDispatchLoaderDynamic(_dynamicDispatcher);
-#ifndef RENDERDOC_CAPTURE
-	_unbiasedReusePass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice, _dynamicDispatcher);
-#endif
+	if (_hardwareRayTracing) {
+		_unbiasedReusePass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice, _dynamicDispatcher);
+	}
 	{
 		std::array<vk::DescriptorSetLayout, numGBuffers> setLayouts;
 		std::fill(setLayouts.begin(), setLayouts.end(), _unbiasedReusePass.getFrameDescriptorSetLayout());
@@ -516,8 +735,7 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 		auto newSets = _device->allocateDescriptorSetsUnique(allocInfo);
 		std::move(newSets.begin(), newSets.end(), _unbiasedReusePassFrameDescriptors.begin());
 	}
-#ifndef RENDERDOC_CAPTURE
-	{
+	if (_hardwareRayTracing) {
 		vk::DescriptorSetLayout setLayout = _unbiasedReusePass.getHardwareRaytraceDescriptorSetLayout();
 		vk::DescriptorSetAllocateInfo allocInfo;
 		allocInfo
@@ -525,7 +743,6 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 			.setSetLayouts(setLayout);
 		_unbiasedReusePassHwRaytraceDescriptors = std::move(_device->allocateDescriptorSetsUnique(allocInfo)[0]);
 	}
-#endif
 	{
 		vk::DescriptorSetLayout setLayout = _unbiasedReusePass.getSoftwareRaytraceDescriptorSetLayout();
 		vk::DescriptorSetAllocateInfo allocInfo;
@@ -538,11 +755,7 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 	_updateRestirBuffers();
 
 
-	// create lighting pass
-	_lightingPass = Pass::create<LightingPass>(_device.get(), _swapchain.getImageFormat());
-	_lightingPassUniformBuffer = _allocator.createTypedBuffer<shader::LightingPassUniforms>(
-		1, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
+	// lighting pass resources
 	{
 		std::array<vk::DescriptorSetLayout, numGBuffers> lightingPassDescLayout;
 		std::fill(lightingPassDescLayout.begin(), lightingPassDescLayout.end(), _lightingPass.getDescriptorSetLayout());
@@ -557,12 +770,15 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 
 	_lightingPass.imageExtent = _swapchain.getImageExtent();
 
+	// passes are created with the default configuration
+	_updateShaderConfig();
 
-	_imguiPass = Pass::create<ImGuiPass>(_device.get(), _swapchain.getImageFormat());
-	_imguiPass.imageExtent = _swapchain.getImageExtent();
 
-	// finish initializing imgui
-	{
+	if (_window) {
+		_imguiPass = Pass::create<ImGuiPass>(_device.get(), _swapchain.getImageFormat());
+		_imguiPass.imageExtent = _swapchain.getImageExtent();
+
+		// finish initializing imgui
 		ImGui_ImplVulkan_InitInfo imguiInit{};
 		imguiInit.Instance = _instance.get();
 		imguiInit.PhysicalDevice = _physicalDevice;
@@ -570,24 +786,15 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 		imguiInit.QueueFamily = _graphicsComputeQueueIndex;
 		imguiInit.Queue = _graphicsComputeQueue;
 		imguiInit.DescriptorPool = _imguiDescriptorPool.get();
+		imguiInit.PipelineCache = _pipelineCache.get();
 		imguiInit.MinImageCount = _swapchainInfo.minImageCount;
 		imguiInit.ImageCount = static_cast<uint32_t>(_swapchain.getImages().size());
 		ImGui_ImplVulkan_Init(&imguiInit, _imguiPass.getPass());
-	}
-	{
+
 		TransientCommandBuffer cmdBuffer = _transientCommandBufferPool.begin(_graphicsComputeQueue);
 		ImGui_ImplVulkan_CreateFontsTexture(cmdBuffer.get());
 	}
 
-	{ // create main command buffers
-		vk::CommandBufferAllocateInfo bufferInfo;
-		bufferInfo
-			.setCommandPool(_commandPool.get())
-			.setCommandBufferCount(static_cast<uint32_t>(_mainCommandBuffers.size()))
-			.setLevel(vk::CommandBufferLevel::ePrimary);
-		auto newBuffers = std::move(_device->allocateCommandBuffersUnique(bufferInfo));
-		std::move(newBuffers.begin(), newBuffers.end(), _mainCommandBuffers.begin());
-	}
 	_recordMainCommandBuffers();
 	_createSwapchainBuffers();
 
@@ -612,16 +819,21 @@ App::App(std::string scene, bool ignorePointLights) : _window({ { GLFW_CLIENT_AP
 		vk::FenceCreateInfo fenceInfo;
 		fenceInfo
 			.setFlags(vk::FenceCreateFlagBits::eSignaled);
-		_mainFence = _device->createFenceUnique(fenceInfo);
+		_offscreenFence = _device->createFenceUnique(fenceInfo);
 	}
+
+	_prevFrameProjectionView = _camera.projectionViewMatrix;
 }
 
 App::~App() {
 	_device->waitIdle();
+	_pipelineCache.save();
 
-	ImGui_ImplVulkan_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
+	if (_window) {
+		ImGui_ImplVulkan_Shutdown();
+		ImGui_ImplGlfw_Shutdown();
+		ImGui::DestroyContext();
+	}
 }
 
 void App::updateGui() {
@@ -640,23 +852,38 @@ void App::updateGui() {
 		"WorldPosition",
 		"Naive Point Light Visualization"
 	};
-	_viewParamChanged = ImGui::Combo("Debug Mode", &_debugMode, debugModes, IM_ARRAYSIZE(debugModes)) || _viewParamChanged;
-	_viewParamChanged = ImGui::SliderFloat("Gamma", &_gamma, 1.0f, 5.0f) || _viewParamChanged;
+	ImGui::Combo("Debug Mode", &_debugMode, debugModes, IM_ARRAYSIZE(debugModes));
+	ImGui::SliderFloat("Gamma", &_gamma, 1.0f, 5.0f);
+	if (_gpuCullingSupported) {
+		_renderPathChanged = ImGui::Checkbox("GPU Culling", &_gpuCulling) || _renderPathChanged;
+		if (_gpuCulling && ImGui::Button("Validate GPU Culling") && validateGpuCulling()) {
+			std::cout << "GPU culling matches the CPU reference\n";
+		}
+	}
 
 	ImGui::Separator();
 
 	ImGui::SliderInt("Initial Light Samples (log2)", &_log2InitialLightSamples, 0, 10);
+	ImGui::Checkbox("Adaptive Light Samples", &_adaptiveLightSampling);
+	if (_adaptiveLightSampling) {
+		ImGui::SliderInt("Min Initial Light Samples (log2)", &_log2MinInitialLightSamples, 0, _log2InitialLightSamples);
+	}
+	const char *lightSamplingMethods[]{
+		"Alias Table",
+		"Light BVH",
+		"Light Tiles"
+	};
+	_renderPathChanged = ImGui::Combo(
+		"Light Sampling", reinterpret_cast<int*>(&_lightSamplingMethod),
+		lightSamplingMethods, IM_ARRAYSIZE(lightSamplingMethods)
+	) || _renderPathChanged;
 
 	ImGui::Separator();
 
 	const char* visibilityTestMethods[]{
 		"Disabled",
 		"Software",
-#ifdef RENDERDOC_CAPTURE
-		"Hardware (Unavailable)"
-#else
-		"Hardware"
-#endif
+		_hardwareRayTracing ? "Hardware" : "Hardware (Unavailable)"
 	};
 	_renderPathChanged = ImGui::Combo(
 		"Visibility Test", reinterpret_cast<int*>(&_visibilityTestMethod),
@@ -681,34 +908,163 @@ void App::updateGui() {
 
 	ImGui::Separator();
 
+	if (ImGui::TreeNode("Shader Configuration")) {
+		const char *reservoirSizes[]{ "1", "2", "4" };
+		int reservoirSizeIndex = static_cast<int>(
+			std::find(
+				RestirShaderConfig::reservoirSizes.begin(), RestirShaderConfig::reservoirSizes.end(),
+				_shaderConfig.reservoirSize
+			) - RestirShaderConfig::reservoirSizes.begin()
+		);
+		if (ImGui::Combo("Reservoir Size", &reservoirSizeIndex, reservoirSizes, IM_ARRAYSIZE(reservoirSizes))) {
+			_shaderConfig.reservoirSize = RestirShaderConfig::reservoirSizes[reservoirSizeIndex];
+			_renderPathChanged = true;
+		}
+		_renderPathChanged = ImGui::Checkbox("Unbiased MIS", &_shaderConfig.unbiasedMis) || _renderPathChanged;
+
+		int unbiasedReuseNeighbors = static_cast<int>(_shaderConfig.unbiasedReuseNeighbors);
+		if (ImGui::SliderInt("Unbiased Reuse Neighbors", &unbiasedReuseNeighbors, 1, 8)) {
+			_shaderConfig.unbiasedReuseNeighbors = static_cast<uint32_t>(unbiasedReuseNeighbors);
+			_renderPathChanged = true;
+		}
+		_renderPathChanged = ImGui::Checkbox("Pairwise MIS", &_shaderConfig.pairwiseMis) || _renderPathChanged;
+
+		constexpr std::array<std::pair<uint32_t, uint32_t>, 5> groupSizes{
+			std::pair<uint32_t, uint32_t>(64, 1), { 32, 2 }, { 16, 4 }, { 8, 8 }, { 16, 16 }
+		};
+		const char *groupSizeNames[]{ "64 x 1", "32 x 2", "16 x 4", "8 x 8", "16 x 16" };
+		int groupSizeIndex = static_cast<int>(
+			std::find(
+				groupSizes.begin(), groupSizes.end(),
+				std::pair<uint32_t, uint32_t>(_shaderConfig.groupSizeX, _shaderConfig.groupSizeY)
+			) - groupSizes.begin()
+		);
+		if (ImGui::Combo("Group Size", &groupSizeIndex, groupSizeNames, IM_ARRAYSIZE(groupSizeNames))) {
+			std::tie(_shaderConfig.groupSizeX, _shaderConfig.groupSizeY) = groupSizes[groupSizeIndex];
+			_renderPathChanged = true;
+		}
+
+		_renderPathChanged = ImGui::Checkbox("Tiled Reservoir Layout", &_shaderConfig.tiledReservoirLayout) || _renderPathChanged;
+		// one reservoir per 2x2 pixels, with edge-aware upsampling in the lighting pass
+		_renderPathChanged = ImGui::Checkbox("Half Resolution ReSTIR", &_shaderConfig.halfResolution) || _renderPathChanged;
+
+		// trades reuse radius for locality of memory accesses
+		_renderPathChanged = ImGui::Checkbox("Tiled Spatial Reuse", &_shaderConfig.tiledReuse) || _renderPathChanged;
+		if (_shaderConfig.tiledReuse) {
+			int tileApron = static_cast<int>(_shaderConfig.tileApron);
+			if (ImGui::SliderInt("Tile Apron", &tileApron, 1, 16)) {
+				_shaderConfig.tileApron = static_cast<uint32_t>(tileApron);
+				_renderPathChanged = true;
+			}
+		}
+
+		ImGui::TreePop();
+	}
+
+	ImGui::Separator();
+
 	ImGui::LabelText("Resolution", "%" PRIu32 " x %" PRIu32, _swapchain.getImageExtent().width, _swapchain.getImageExtent().height);
 	ImGui::LabelText("FPS", "%f", _fpsCounter.getFpsAverageWindow());
 
+	if (ImGui::TreeNode("GPU Timings")) {
+		_gpuProfiler.drawGui();
+		if (ImGui::Button("Export CSV")) {
+			_gpuProfiler.exportCsv("gpuTimings.csv");
+		}
+		ImGui::TreePop();
+	}
+
 	ImGui::Render();
 }
 
+void App::_updateFrameUniforms() {
+	if (_renderPathChanged) {
+		_device->waitIdle();
+		_updateShaderConfig();
+		_updateRestirBuffers();
+		_recordMainCommandBuffers();
+		_initializeLightingPassResources();
+
+		_restirUniforms.frame = 0;
+		_renderPathChanged = false;
+	}
+
+	nvmath::mat4 inverseProjectionView = nvmath::invert(_camera.projectionViewMatrix);
+
+	auto &gBufferUniforms = _uniformRingBuffer.at<GBufferPass::Uniforms>(_currentGBufferFrame, _gBufferUniformOffset);
+	gBufferUniforms.projectionViewMatrix = _camera.projectionViewMatrix;
+	gBufferUniforms.prevFrameProjectionViewMatrix = _prevFrameProjectionView;
+	gBufferUniforms.inverseProjectionViewMatrix = inverseProjectionView;
+	gBufferUniforms.screenSize = nvmath::uvec2(
+		_swapchain.getImageExtent().width, _swapchain.getImageExtent().height
+	);
+
+	++_restirUniforms.frame;
+	_restirUniforms.inverseProjectionViewMatrix = inverseProjectionView;
+	_restirUniforms.cameraPos = _camera.position;
+	_restirUniforms.initialLightSampleCount = 1 << _log2InitialLightSamples;
+	_restirUniforms.temporalSampleCountMultiplier = _temporalReuseSampleMultiplier;
+	_restirUniforms.minInitialLightSampleCount = 1 << std::min(_log2MinInitialLightSamples, _log2InitialLightSamples);
+	_restirUniforms.spatialPosThreshold = posThreshold;
+	_restirUniforms.spatialNormalThreshold = norThreshold;
+	_restirUniforms.flags = 0;
+	if (_visibilityTestMethod != VisibilityTestMethod::disabled) {
+		_restirUniforms.flags |= RESTIR_VISIBILITY_REUSE_FLAG;
+	}
+	if (_enableTemporalReuse) {
+		_restirUniforms.flags |= RESTIR_TEMPORAL_REUSE_FLAG;
+	}
+	if (_adaptiveLightSampling) {
+		_restirUniforms.flags |= RESTIR_ADAPTIVE_SAMPLING_FLAG;
+	}
+	if (_lightSamplingMethod == LightSamplingMethod::lightBvh) {
+		_restirUniforms.flags |= RESTIR_LIGHT_BVH_SAMPLING_FLAG;
+	} else if (_lightSamplingMethod == LightSamplingMethod::lightTiles) {
+		_restirUniforms.flags |= RESTIR_LIGHT_TILES_SAMPLING_FLAG;
+	}
+	_uniformRingBuffer.at<shader::RestirUniforms>(_currentGBufferFrame, _restirUniformOffset) = _restirUniforms;
+
+	_lightingPassUniforms.inverseProjectionViewMatrix = inverseProjectionView;
+	_lightingPassUniforms.cameraPos = _camera.position;
+	_lightingPassUniforms.bufferSize = nvmath::uvec2(_swapchain.getImageExtent().width, _swapchain.getImageExtent().height);
+	_lightingPassUniforms.debugMode = _debugMode;
+	_lightingPassUniforms.gamma = _gamma;
+	_uniformRingBuffer.at<shader::LightingPassUniforms>(_currentGBufferFrame, _lightingPassUniformOffset) =
+		_lightingPassUniforms;
+
+	if (_gpuCulling) {
+		_uniformRingBuffer.at<CullingPass::Uniforms>(_currentGBufferFrame, _cullingUniformOffset) =
+			CullingPass::getUniforms(_camera.projectionViewMatrix, static_cast<uint32_t>(_gltfScene.m_nodes.size()));
+	}
+
+	_uniformRingBuffer.flush(_currentGBufferFrame);
+
+	// the previous frame's matrix is needed for motion vectors
+	_prevFrameProjectionView = _camera.projectionViewMatrix;
+}
+
 void App::mainLoop() {
+	assert(!isHeadless());
+
 	std::size_t currentPresentFrame = 0;
-	std::size_t currentGBufferFrame = 0;
 	bool needsResize = false;
-	vk::Extent2D windowSize = _window.getFramebufferSize();
-	nvmath::mat4 prevFrameProjectionView = _camera.projectionViewMatrix;
+	vk::Extent2D windowSize = _window->getFramebufferSize();
 
-	while (!_window.shouldClose()) {
+	while (!_window->shouldClose()) {
 		glfwPollEvents();
 
-		vk::Extent2D newWindowSize = _window.getFramebufferSize();
+		vk::Extent2D newWindowSize = _window->getFramebufferSize();
 		if (needsResize || newWindowSize != windowSize) {
 			_device->waitIdle();
 
 			while (newWindowSize.width == 0 && newWindowSize.height == 0) {
 				glfwWaitEvents();
-				newWindowSize = _window.getFramebufferSize();
+				newWindowSize = _window->getFramebufferSize();
 			}
 			windowSize = newWindowSize;
 
 			_swapchainInfo.setImageExtent(chooseSwapExtent(
-				_physicalDevice.getSurfaceCapabilitiesKHR(_surface.get()), _window
+				_physicalDevice.getSurfaceCapabilitiesKHR(_surface.get()), _window.value()
 			));
 
 
@@ -717,19 +1073,17 @@ void App::mainLoop() {
 
 			_swapchain = Swapchain::create(_device.get(), _swapchainInfo);
 
-			currentGBufferFrame = 0;
+			_currentGBufferFrame = 0;
 
 			for (GBuffer& gbuf : _gBuffers) {
 				gbuf.resize(_allocator, _device.get(), _swapchain.getImageExtent(), _gBufferPass);
 			}
 			_transitionGBufferLayouts();
-			_gBufferPass.onResized(_device.get(), _swapchain.getImageExtent());
+			_initializeGBufferResolveDescriptors();
+			_gBufferPass.onResized(_swapchain.getImageExtent());
 
-			auto* restirUniforms = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
-			restirUniforms->screenSize = nvmath::uvec2(windowSize.width, windowSize.height);
-			restirUniforms->frame = 0;
-			_restirUniformBuffer.unmap();
-			_restirUniformBuffer.flush();
+			_restirUniforms.screenSize = nvmath::uvec2(windowSize.width, windowSize.height);
+			_restirUniforms.frame = 0;
 
 			_spatialReusePass.screenSize = windowSize;
 
@@ -742,10 +1096,11 @@ void App::mainLoop() {
 
 			_recordMainCommandBuffers();
 			_createSwapchainBuffers();
+			// the number of images may have changed, and all frames have finished
+			_inFlightImageFences.assign(_swapchainBuffers.size(), nullptr);
 
 			_camera.aspectRatio = _swapchain.getImageExtent().width / static_cast<float>(_swapchain.getImageExtent().height);
 			_camera.recomputeAttributes();
-			_cameraUpdated = true;
 		}
 
 		_fpsCounter.tick();
@@ -754,7 +1109,13 @@ void App::mainLoop() {
 			"ReSTIR | FPS: " <<
 			std::fixed << std::setprecision(2) << _fpsCounter.getFpsAverageWindow() << " (Window: " << _fpsCounter.timeWindow << "s)  " <<
 			std::fixed << std::setprecision(2) << _fpsCounter.getFpsRunningAverage() << " (RA: " << _fpsCounter.alpha << ")";
-		_window.setTitle(ss.str());
+		_window->setTitle(ss.str());
+
+		// the image available semaphore of this frame is reused after this fence has been signaled
+		while (_device->waitForFences(
+			{ _inFlightFences[currentPresentFrame].get() }, true, std::numeric_limits<std::uint64_t>::max()
+		) == vk::Result::eTimeout) {
+		}
 
 		auto [result, imageIndex] = _device->acquireNextImageKHR(
 			_swapchain.getSwapchain().get(), std::numeric_limits<std::uint64_t>::max(),
@@ -767,117 +1128,101 @@ void App::mainLoop() {
 
 		updateGui();
 
-		{
-			while (_device->waitForFences(_mainFence.get(), true, std::numeric_limits<uint64_t>::max()) == vk::Result::eTimeout) {
-			}
-			_device->resetFences(_mainFence.get());
-
-			auto* restirUniforms = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
-			++restirUniforms->frame;
-			restirUniforms->initialLightSampleCount = 1 << _log2InitialLightSamples;
-			restirUniforms->prevFrameProjectionViewMatrix = prevFrameProjectionView;
-			restirUniforms->temporalSampleCountMultiplier = _temporalReuseSampleMultiplier;
-
-			if (_enableTemporalReuse) {
-				restirUniforms->flags |= RESTIR_TEMPORAL_REUSE_FLAG;
-			} else {
-				restirUniforms->flags &= ~RESTIR_TEMPORAL_REUSE_FLAG;
-			}
-
-			if (_cameraUpdated || _viewParamChanged) {
-				_graphicsComputeQueue.waitIdle();
-
-				auto* gBufferUniforms = _gBufferResources.uniformBuffer.mapAs<GBufferPass::Uniforms>();
-				gBufferUniforms->projectionViewMatrix = _camera.projectionViewMatrix;
-				_gBufferResources.uniformBuffer.unmap();
-				_gBufferResources.uniformBuffer.flush();
-
-				restirUniforms->cameraPos = _camera.position;
-
-				auto* lightingPassUniforms = _lightingPassUniformBuffer.mapAs<shader::LightingPassUniforms>();
-				lightingPassUniforms->cameraPos = _camera.position;
-				lightingPassUniforms->bufferSize = nvmath::uvec2(_swapchain.getImageExtent().width, _swapchain.getImageExtent().height);
-				lightingPassUniforms->debugMode = _debugMode;
-				lightingPassUniforms->gamma = _gamma;
-				_lightingPassUniformBuffer.unmap();
-				_lightingPassUniformBuffer.flush();
-
-				_cameraUpdated = false;
-				_viewParamChanged = false;
-			} else if (_renderPathChanged) {
-				_device->waitIdle();
-				_updateRestirBuffers();
-				_recordMainCommandBuffers();
-				_initializeLightingPassResources();
-
-				restirUniforms->frame = 0;
-				restirUniforms->spatialPosThreshold = posThreshold;
-				restirUniforms->spatialNormalThreshold = norThreshold;
-				if (_visibilityTestMethod != VisibilityTestMethod::disabled) {
-					restirUniforms->flags |= RESTIR_VISIBILITY_REUSE_FLAG;
-				} else {
-					restirUniforms->flags &= ~RESTIR_VISIBILITY_REUSE_FLAG;
+		// only wait for the frames that used the same swapchain image or G-buffer, which are usually not the last frame
+		for (vk::Fence fence : { _inFlightImageFences[imageIndex], _inFlightGBufferFences[_currentGBufferFrame] }) {
+			if (fence) {
+				while (_device->waitForFences(
+					{ fence }, true, std::numeric_limits<std::uint64_t>::max()
+				) == vk::Result::eTimeout) {
 				}
-
-				_renderPathChanged = false;
 			}
-
-			_restirUniformBuffer.unmap();
-			_restirUniformBuffer.flush();
-
-			std::array<vk::CommandBuffer, 1> gBufferCommandBuffers{ _mainCommandBuffers[currentGBufferFrame].get() };
-			vk::SubmitInfo submitInfo;
-			submitInfo
-				.setCommandBuffers(gBufferCommandBuffers);
-			_graphicsComputeQueue.submit(submitInfo, _mainFence.get());
-
-			prevFrameProjectionView = _camera.projectionViewMatrix;
 		}
+		_device->resetFences({ _inFlightFences[currentPresentFrame].get() });
 
-		while (_device->waitForFences(
-			{ _inFlightFences[currentPresentFrame].get() }, true, std::numeric_limits<std::uint64_t>::max()
-		) == vk::Result::eTimeout) {
-		}
-		if (_inFlightImageFences[imageIndex]) {
-			while (_device->waitForFences(
-				{ _inFlightImageFences[imageIndex].get() }, true, std::numeric_limits<std::uint64_t>::max()
-			) == vk::Result::eTimeout) {
-			}
+		auto mainProfilerSlot = static_cast<uint32_t>(_currentGBufferFrame);
+		auto presentProfilerSlot = static_cast<uint32_t>(numGBuffers + currentPresentFrame);
+		uint32_t computeProfilerSlot = _getMainProfilerSlot(mainProfilerSlot, _getComputeQueue());
+		_gpuProfiler.collect(_device.get(), mainProfilerSlot);
+		_gpuProfiler.collect(_device.get(), presentProfilerSlot);
+		if (computeProfilerSlot != mainProfilerSlot) {
+			_gpuProfiler.collect(_device.get(), computeProfilerSlot);
 		}
-		_device->resetFences({ _inFlightFences[currentPresentFrame].get() });
 
+		_updateFrameUniforms();
+
+		// with deferred lighting, this frame lights the G-buffer of the previous frame, which does not exist if the
+		// frame graph has just been rebuilt
+		bool deferLighting = _isLightingDeferred();
+		bool drawLighting = !deferLighting || _frameGraphFrames > 0;
+		std::size_t lightingFrame =
+			deferLighting ? (_currentGBufferFrame + numGBuffers - 1) % numGBuffers : _currentGBufferFrame;
 		{ // record present command buffer
 			vk::CommandBuffer commandBuffer = _swapchainBuffers[imageIndex].commandBuffer.get();
 			vk::Framebuffer frameBuffer = _swapchainBuffers[imageIndex].framebuffer.get();
 
 			vk::CommandBufferBeginInfo beginInfo;
 			commandBuffer.begin(beginInfo);
+			_gpuProfiler.beginFrame(commandBuffer, presentProfilerSlot);
 
-			transitionImageLayout(
-				commandBuffer, _swapchain.getImages()[imageIndex], _swapchain.getImageFormat(),
-				vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal
-			);
+			if (drawLighting) {
+				_frameGraph.record(
+					_getLightingSegment(), commandBuffer, static_cast<uint32_t>(_currentGBufferFrame)
+				);
+				transitionImageLayout(
+					commandBuffer, _swapchain.getImages()[imageIndex], _swapchain.getImageFormat(),
+					vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal
+				);
 
-			_lightingPass.descriptorSet = _lightingPassDescriptorSets[currentGBufferFrame].get();
-			_lightingPass.issueCommands(commandBuffer, frameBuffer);
+				_lightingPass.descriptorSet = _lightingPassDescriptorSets[lightingFrame].get();
+				_lightingPass.uniformOffset =
+					_uniformRingBuffer.getDynamicOffset(lightingFrame, _lightingPassUniformOffset);
+				_gpuProfiler.beginSection(commandBuffer, presentProfilerSlot, "Lighting");
+				_lightingPass.issueCommands(commandBuffer, frameBuffer);
+				_gpuProfiler.endSection(commandBuffer, presentProfilerSlot);
+			} else {
+				vk::Image image = _swapchain.getImages()[imageIndex];
+				transitionImageLayout(
+					commandBuffer, image, _swapchain.getImageFormat(),
+					vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal
+				);
+				commandBuffer.clearColorImage(
+					image, vk::ImageLayout::eTransferDstOptimal,
+					vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }),
+					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+				);
+				transitionImageLayout(
+					commandBuffer, image, _swapchain.getImageFormat(),
+					vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eColorAttachmentOptimal
+				);
+			}
 
+			_gpuProfiler.beginSection(commandBuffer, presentProfilerSlot, "ImGui");
 			_imguiPass.issueCommands(commandBuffer, frameBuffer);
+			_gpuProfiler.endSection(commandBuffer, presentProfilerSlot);
 
 			commandBuffer.end();
 		}
 
 		std::array<vk::Semaphore, 1> signalSemaphores{ _renderFinishedSemaphore[currentPresentFrame].get() };
 		{
-			std::array<vk::Semaphore, 1> waitSemaphores{ _imageAvailableSemaphore[currentPresentFrame].get() };
-			std::array<vk::PipelineStageFlags, 1> waitStages{ vk::PipelineStageFlagBits::eColorAttachmentOutput };
-			std::array<vk::CommandBuffer, 1> cmdBuffers{ _swapchainBuffers[imageIndex].commandBuffer.get() };
-			vk::SubmitInfo submitInfo;
-			submitInfo
-				.setWaitSemaphores(waitSemaphores)
-				.setWaitDstStageMask(waitStages)
-				.setCommandBuffers(cmdBuffers)
-				.setSignalSemaphores(signalSemaphores);
-			_graphicsComputeQueue.submit(submitInfo, _inFlightFences[currentPresentFrame].get());
+			vk::Fence fence = _inFlightFences[currentPresentFrame].get();
+			_submitMainCommandBuffers(
+				_swapchainBuffers[imageIndex].commandBuffer.get(),
+				_imageAvailableSemaphore[currentPresentFrame].get(), signalSemaphores[0], fence
+			);
+			_gpuProfiler.onSubmitted(mainProfilerSlot);
+			_gpuProfiler.onSubmitted(presentProfilerSlot);
+			if (computeProfilerSlot != mainProfilerSlot) {
+				_gpuProfiler.onSubmitted(computeProfilerSlot);
+			}
+			_inFlightImageFences[imageIndex] = fence;
+			// with deferred lighting, the fence also covers the compute passes of the previous frame that lighting
+			// waits for, but not those of this frame
+			if (!deferLighting) {
+				_inFlightGBufferFences[_currentGBufferFrame] = fence;
+			} else if (drawLighting) {
+				_inFlightGBufferFences[lightingFrame] = fence;
+			}
 		}
 
 		std::vector<vk::SwapchainKHR> swapchains{ _swapchain.getSwapchain().get() };
@@ -897,13 +1242,295 @@ void App::mainLoop() {
 		}
 
 		currentPresentFrame = (currentPresentFrame + 1) % maxFramesInFlight;
-		currentGBufferFrame = (currentGBufferFrame + 1) % numGBuffers;
+		_currentGBufferFrame = (_currentGBufferFrame + 1) % numGBuffers;
+	}
+}
+
+void App::_submitMainCommandBuffers(
+	vk::CommandBuffer lightingCommandBuffer, vk::Semaphore waitSemaphore, vk::Semaphore signalSemaphore,
+	vk::Fence fence
+) {
+	struct Batch {
+		std::vector<vk::Semaphore> waitSemaphores;
+		// ignored for binary semaphores
+		std::vector<uint64_t> waitValues;
+		std::vector<vk::PipelineStageFlags> waitStages;
+		std::vector<vk::Semaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		vk::CommandBuffer commandBuffer;
+		vk::TimelineSemaphoreSubmitInfo timelineInfo;
+	};
+
+	const std::vector<FrameGraph::Segment> &segments = _frameGraph.getSegments();
+	auto frame = static_cast<uint32_t>(_currentGBufferFrame);
+	std::size_t numFramesKept = _segmentTimelineValues.size();
+	std::vector<uint64_t> &signalledValues = _segmentTimelineValues[_frameGraphFrames % numFramesKept];
+	std::vector<Batch> batches(segments.size());
+	for (std::size_t i = 0; i < segments.size(); ++i) {
+		const FrameGraph::Segment &segment = segments[i];
+		Batch &batch = batches[i];
+		if (segment.external) {
+			// the main command buffers are in separate batches so that they do not wait for the swapchain image
+			batch.commandBuffer = lightingCommandBuffer;
+			if (waitSemaphore) {
+				batch.waitSemaphores.emplace_back(waitSemaphore);
+				batch.waitValues.emplace_back(0);
+				batch.waitStages.emplace_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+			}
+			if (signalSemaphore) {
+				batch.signalSemaphores.emplace_back(signalSemaphore);
+				batch.signalValues.emplace_back(0);
+			}
+		} else {
+			batch.commandBuffer = _mainCommandBuffers[frame][i].get();
+		}
+		if (_queueTimelines.empty()) {
+			continue;
+		}
+
+		// wait for the latest segment on each other queue that this segment depends on. segments of frames before the
+		// frame graph was built have all finished
+		std::vector<uint64_t> waitValues(_queueTimelines.size(), 0);
+		for (const FrameGraph::Dependency &dependency : _frameGraph.getDependencies(i, frame)) {
+			if (dependency.framesAgo <= _frameGraphFrames) {
+				uint64_t &value = waitValues[segments[dependency.segment].queue];
+				value = std::max(value, _segmentTimelineValues[
+					(_frameGraphFrames - dependency.framesAgo) % numFramesKept
+				][dependency.segment]);
+			}
+		}
+		for (std::size_t queue = 0; queue < waitValues.size(); ++queue) {
+			if (waitValues[queue] > 0) {
+				batch.waitSemaphores.emplace_back(_queueTimelines[queue].get());
+				batch.waitValues.emplace_back(waitValues[queue]);
+				batch.waitStages.emplace_back(vk::PipelineStageFlagBits::eAllCommands);
+			}
+		}
+		signalledValues[i] = ++_queueTimelineValues[segment.queue];
+		batch.signalSemaphores.emplace_back(_queueTimelines[segment.queue].get());
+		batch.signalValues.emplace_back(signalledValues[i]);
+	}
+
+	// batches may wait for batches on the other queue that are submitted afterwards, which is allowed for timeline
+	// semaphores
+	std::array<vk::Queue, 2> queues{ _graphicsComputeQueue, _asyncComputeQueue };
+	for (uint32_t queue = 0; queue < queues.size(); ++queue) {
+		std::vector<vk::SubmitInfo> submitInfos;
+		for (std::size_t i = 0; i < segments.size(); ++i) {
+			if (segments[i].queue != queue) {
+				continue;
+			}
+			Batch &batch = batches[i];
+			vk::SubmitInfo &submitInfo = submitInfos.emplace_back();
+			submitInfo
+				.setWaitSemaphores(batch.waitSemaphores)
+				.setWaitDstStageMask(batch.waitStages)
+				.setCommandBuffers(batch.commandBuffer)
+				.setSignalSemaphores(batch.signalSemaphores);
+			if (!_queueTimelines.empty()) {
+				batch.timelineInfo
+					.setWaitSemaphoreValues(batch.waitValues)
+					.setSignalSemaphoreValues(batch.signalValues);
+				submitInfo.setPNext(&batch.timelineInfo);
+			}
+		}
+		if (!submitInfos.empty()) {
+			queues[queue].submit(submitInfos, queue == 0 ? fence : nullptr);
+		}
+	}
+	++_frameGraphFrames;
+}
+
+void App::renderOffscreenFrame() {
+	assert(isHeadless());
+
+	while (_device->waitForFences(
+		{ _offscreenFence.get() }, true, std::numeric_limits<std::uint64_t>::max()
+	) == vk::Result::eTimeout) {
+	}
+	_device->resetFences({ _offscreenFence.get() });
+
+	// there's only one offscreen image, so it's recorded into the first present slot every frame
+	auto mainProfilerSlot = static_cast<uint32_t>(_currentGBufferFrame);
+	auto presentProfilerSlot = static_cast<uint32_t>(numGBuffers);
+	uint32_t computeProfilerSlot = _getMainProfilerSlot(mainProfilerSlot, _getComputeQueue());
+	_gpuProfiler.collect(_device.get(), mainProfilerSlot);
+	_gpuProfiler.collect(_device.get(), presentProfilerSlot);
+	if (computeProfilerSlot != mainProfilerSlot) {
+		_gpuProfiler.collect(_device.get(), computeProfilerSlot);
+	}
+
+	_updateFrameUniforms();
+
+	// frames are waited for anyway, so lighting is never deferred
+	vk::CommandBuffer commandBuffer = _swapchainBuffers[0].commandBuffer.get();
+	{
+		vk::CommandBufferBeginInfo beginInfo;
+		commandBuffer.begin(beginInfo);
+		_gpuProfiler.beginFrame(commandBuffer, presentProfilerSlot);
+		_frameGraph.record(_getLightingSegment(), commandBuffer, static_cast<uint32_t>(_currentGBufferFrame));
+
+		transitionImageLayout(
+			commandBuffer, _offscreenImage.get(), offscreenImageFormat,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal
+		);
+
+		_lightingPass.descriptorSet = _lightingPassDescriptorSets[_currentGBufferFrame].get();
+		_lightingPass.uniformOffset =
+			_uniformRingBuffer.getDynamicOffset(_currentGBufferFrame, _lightingPassUniformOffset);
+		_gpuProfiler.beginSection(commandBuffer, presentProfilerSlot, "Lighting");
+		_lightingPass.issueCommands(commandBuffer, _swapchainBuffers[0].framebuffer.get());
+		_gpuProfiler.endSection(commandBuffer, presentProfilerSlot);
+
+		transitionImageLayout(
+			commandBuffer, _offscreenImage.get(), offscreenImageFormat,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal
+		);
+		vk::BufferImageCopy region;
+		region
+			.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+			.setImageExtent(vk::Extent3D(_swapchain.getImageExtent(), 1));
+		commandBuffer.copyImageToBuffer(
+			_offscreenImage.get(), vk::ImageLayout::eTransferSrcOptimal, _offscreenReadbackBuffer.get(), region
+		);
+
+		vk::MemoryBarrier hostReadBarrier;
+		hostReadBarrier
+			.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, hostReadBarrier, {}, {}
+		);
+
+		commandBuffer.end();
+	}
+
+	_submitMainCommandBuffers(commandBuffer, nullptr, nullptr, _offscreenFence.get());
+	_gpuProfiler.onSubmitted(mainProfilerSlot);
+	_gpuProfiler.onSubmitted(presentProfilerSlot);
+	if (computeProfilerSlot != mainProfilerSlot) {
+		_gpuProfiler.onSubmitted(computeProfilerSlot);
+	}
+
+	// wait for the frame so that it can be read back
+	while (_device->waitForFences(
+		{ _offscreenFence.get() }, true, std::numeric_limits<std::uint64_t>::max()
+	) == vk::Result::eTimeout) {
+	}
+
+	_currentGBufferFrame = (_currentGBufferFrame + 1) % numGBuffers;
+}
+
+bool App::saveOffscreenImage(const std::filesystem::path &path) {
+	vk::Extent2D extent = _swapchain.getImageExtent();
+	_offscreenReadbackBuffer.invalidate();
+	const auto *pixels = _offscreenReadbackBuffer.mapAs<uint8_t>();
+	int result = stbi_write_png(
+		path.string().c_str(), static_cast<int>(extent.width), static_cast<int>(extent.height), 4,
+		pixels, static_cast<int>(extent.width * 4)
+	);
+	_offscreenReadbackBuffer.unmap();
+	if (result == 0) {
+		std::cerr << "Failed to write " << path << "\n";
+		return false;
+	}
+	return true;
+}
+
+std::vector<std::pair<std::string, float>> App::collectOffscreenFrameTimings() {
+	_device->waitIdle();
+	// renderOffscreenFrame() has already moved on to the next G-buffer
+	auto mainProfilerSlot = static_cast<uint32_t>((_currentGBufferFrame + numGBuffers - 1) % numGBuffers);
+	auto presentProfilerSlot = static_cast<uint32_t>(numGBuffers);
+	uint32_t computeProfilerSlot = _getMainProfilerSlot(mainProfilerSlot, _getComputeQueue());
+	_gpuProfiler.collect(_device.get(), mainProfilerSlot);
+	_gpuProfiler.collect(_device.get(), presentProfilerSlot);
+
+	std::vector<std::pair<std::string, float>> result = _gpuProfiler.getLastResults(mainProfilerSlot);
+	if (computeProfilerSlot != mainProfilerSlot) {
+		_gpuProfiler.collect(_device.get(), computeProfilerSlot);
+		const std::vector<std::pair<std::string, float>> &computeResults =
+			_gpuProfiler.getLastResults(computeProfilerSlot);
+		result.insert(result.end(), computeResults.begin(), computeResults.end());
+	}
+	const std::vector<std::pair<std::string, float>> &presentResults = _gpuProfiler.getLastResults(presentProfilerSlot);
+	result.insert(result.end(), presentResults.begin(), presentResults.end());
+	return result;
+}
+
+bool App::validateGpuCulling() {
+	if (!_gpuCulling) {
+		return true;
+	}
+	_device->waitIdle();
+	std::size_t frame = (_currentGBufferFrame + numGBuffers - 1) % numGBuffers;
+
+	vk::DeviceSize size = CullingPass::getDrawCommandBufferSize(_gltfScene.m_nodes.size());
+	vma::UniqueBuffer readbackBuffer = _allocator.createBuffer(
+		static_cast<uint32_t>(size), vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU
+	);
+	{
+		TransientCommandBuffer cmdBuffer = _transientCommandBufferPool.begin(_graphicsComputeQueue);
+		cmdBuffer->copyBuffer(_drawCommandBuffers[frame].get(), readbackBuffer.get(), { vk::BufferCopy(0, 0, size) });
+		vk::MemoryBarrier hostReadBarrier;
+		hostReadBarrier
+			.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+		cmdBuffer->pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, hostReadBarrier, {}, {}
+		);
+	}
+
+	readbackBuffer.invalidate();
+	const auto *data = readbackBuffer.mapAs<uint8_t>();
+	uint32_t gpuCount = 0;
+	std::memcpy(&gpuCount, data, sizeof(uint32_t));
+	std::vector<shader::DrawIndexedIndirectCommand> gpuCommands(std::min<std::size_t>(gpuCount, _gltfScene.m_nodes.size()));
+	std::memcpy(
+		gpuCommands.data(), data + CullingPass::getDrawCommandOffset(),
+		sizeof(shader::DrawIndexedIndirectCommand) * gpuCommands.size()
+	);
+	readbackBuffer.unmap();
+	std::sort(gpuCommands.begin(), gpuCommands.end(), [](const auto &lhs, const auto &rhs) {
+		return lhs.firstInstance < rhs.firstInstance;
+	});
+
+	std::vector<shader::DrawIndexedIndirectCommand> cpuCommands = CullingPass::cullOnCpu(
+		_uniformRingBuffer.at<CullingPass::Uniforms>(frame, _cullingUniformOffset),
+		_gltfScene, _sceneBuffers.getCpuNodeBounds()
+	);
+
+	bool matches = true;
+	if (gpuCount != cpuCommands.size()) {
+		std::cerr << "GPU culling drew " << gpuCount << " nodes, but CPU culling found " << cpuCommands.size() << "\n";
+		matches = false;
+	}
+	auto equal = [](const shader::DrawIndexedIndirectCommand &lhs, const shader::DrawIndexedIndirectCommand &rhs) {
+		return
+			lhs.indexCount == rhs.indexCount && lhs.instanceCount == rhs.instanceCount &&
+			lhs.firstIndex == rhs.firstIndex && lhs.vertexOffset == rhs.vertexOffset &&
+			lhs.firstInstance == rhs.firstInstance;
+	};
+	for (std::size_t i = 0; i < std::min(gpuCommands.size(), cpuCommands.size()); ++i) {
+		if (!equal(gpuCommands[i], cpuCommands[i])) {
+			// both lists are sorted by node, so the first difference is enough to tell which node is missing
+			std::cerr <<
+				"GPU culling differs from the CPU reference at draw " << i << ": node " <<
+				gpuCommands[i].firstInstance << " on the GPU, node " << cpuCommands[i].firstInstance << " on the CPU\n";
+			matches = false;
+			break;
+		}
 	}
+	return matches;
+}
+
+void App::setFrameIndex(uint32_t frame) {
+	_restirUniforms.frame = frame;
 }
 
 void App::_onMouseButtonEvent(int button, int action, int mods) {
 	if (ImGui::GetIO().WantCaptureMouse) {
-		ImGui_ImplGlfw_MouseButtonCallback(_window.getRawHandle(), button, action, mods);
+		ImGui_ImplGlfw_MouseButtonCallback(_window->getRawHandle(), button, action, mods);
 		return;
 	}
 
@@ -963,18 +1590,16 @@ void App::_onMouseMoveEvent(double x, double y) {
 	}
 	if (cameraChanged) {
 		_camera.recomputeAttributes();
-		_cameraUpdated = true;
 	}
 	_lastMouse = newPos;
 }
 
 void App::_onScrollEvent(double x, double y) {
 	if (ImGui::GetIO().WantCaptureMouse) {
-		ImGui_ImplGlfw_ScrollCallback(_window.getRawHandle(), x, y);
+		ImGui_ImplGlfw_ScrollCallback(_window->getRawHandle(), x, y);
 		return;
 	}
 
 	_camera.position += _camera.unitForward * static_cast<float>(y) * 1.0f;
 	_camera.recomputeAttributes();
-	_cameraUpdated = true;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <filesystem>
+#include <optional>
+
 #include "misc.h"
 #include "vma.h"
 #include "glfwWindow.h"
@@ -8,7 +11,12 @@
 #include "sceneBuffers.h"
 #include "camera.h"
 #include "fpsCounter.h"
+#include "gpuProfiler.h"
+#include "frameGraph.h"
+#include "uniformRingBuffer.h"
+#include "pipelineCache.h"
 
+#include "passes/cullingPass.h"
 #include "passes/gBufferPass.h"
 #include "passes/spatialReusePass.h"
 #include "passes/lightingPass.h"
@@ -16,6 +24,12 @@
 #include "passes/unbiasedReusePass.h"
 #include "passes/imguiPass.h"
 
+enum class LightSamplingMethod {
+	aliasTable,
+	lightBvh,
+	lightTiles
+};
+
 enum class VisibilityTestMethod {
 	disabled,
 	software,
@@ -27,13 +41,49 @@ public:
 	constexpr static uint32_t vulkanApiVersion = VK_MAKE_VERSION(1, 2, 0);
 	constexpr static std::size_t maxFramesInFlight = 2;
 	constexpr static std::size_t numGBuffers = 2;
-
-	App(std::string scene, bool ignorePointLights);
+	// sRGB so that the readback buffer can be written to image files directly
+	constexpr static vk::Format offscreenImageFormat = vk::Format::eR8G8B8A8Srgb;
+
+	// if asyncCompute is set and the device has a dedicated compute queue family, the ReSTIR passes run on that queue
+	// and overlap with the rasterization passes. if headlessExtent is set, no window or swapchain is created, and
+	// frames are rendered into an offscreen image of that size with renderOffscreenFrame(). CPU implementations of
+	// Vulkan are also accepted in that case
+	App(
+		std::string scene, bool ignorePointLights, const LightGeneratorSettings &lightSettings,
+		bool compactGBuffer, bool visibilityBuffer, bool bindlessMaterials = false, bool gpuCulling = false,
+		bool asyncCompute = false,
+		std::optional<vk::Extent2D> headlessExtent = std::nullopt
+	);
 	~App();
 
 	void mainLoop();
 	void updateGui();
 
+	// renders one frame into the offscreen image and waits for it to finish. only available in headless mode
+	void renderOffscreenFrame();
+	// writes the last frame rendered by renderOffscreenFrame() as an 8-bit sRGB PNG
+	[[nodiscard]] bool saveOffscreenImage(const std::filesystem::path&);
+	// waits for all submitted work and returns the GPU time of each profiled section of the last frame rendered by
+	// renderOffscreenFrame() in milliseconds, or nothing if timestamp queries are not supported
+	[[nodiscard]] std::vector<std::pair<std::string, float>> collectOffscreenFrameTimings();
+	// waits for all submitted work, reads back the draw commands that the culling pass wrote for the last frame, and
+	// compares them with CullingPass::cullOnCpu(). prints the differences and returns whether there were none, or true
+	// if GPU culling is disabled
+	[[nodiscard]] bool validateGpuCulling();
+	// sets RestirUniforms::frame, which seeds random number generators and is incremented before each frame
+	void setFrameIndex(uint32_t);
+
+	[[nodiscard]] bool isHeadless() const {
+		return !_window.has_value();
+	}
+	// call onCameraChanged() after modifying the camera
+	[[nodiscard]] Camera &getCamera() {
+		return _camera;
+	}
+	void onCameraChanged() {
+		_camera.recomputeAttributes();
+	}
+
 	[[nodiscard]] inline static vk::SurfaceFormatKHR chooseSurfaceFormat(
 		const vk::PhysicalDevice& dev, const vk::SurfaceKHR& surface
 	) {
@@ -76,16 +126,20 @@ public:
 		return imageCount;
 	}
 protected:
-	glfw::Window _window;
+	// empty in headless mode
+	std::optional<glfw::Window> _window;
 
 	Camera _camera;
 	FpsCounter _fpsCounter;
 
 	uint32_t _graphicsComputeQueueIndex = 0;
 	uint32_t _presentQueueIndex = 0;
+	// the dedicated compute queue family that the ReSTIR passes run on, if async compute is enabled
+	std::optional<uint32_t> _asyncComputeQueueIndex;
 
 	vk::Queue _graphicsComputeQueue;
 	vk::Queue _presentQueue;
+	vk::Queue _asyncComputeQueue;
 
 	vk::UniqueInstance _instance;
 	vk::DispatchLoaderDynamic _dynamicDispatcher;
@@ -93,9 +147,16 @@ protected:
 	vk::PhysicalDevice _physicalDevice;
 	vk::UniqueSurfaceKHR _surface;
 	vk::UniqueDevice _device;
+	// false if the device does not support ray tracing pipelines or RENDERDOC_CAPTURE is defined, in which case only
+	// software visibility tests are available
+	bool _hardwareRayTracing = false;
 
 	vma::Allocator _allocator;
+	// loaded from and saved to pipelineCache.bin in the working directory. declared before all passes so that it's
+	// still valid when they're destroyed
+	PipelineCache _pipelineCache;
 	vk::UniqueCommandPool _commandPool;
+	vk::UniqueCommandPool _asyncComputeCommandPool;
 	vk::UniqueDescriptorPool _staticDescriptorPool;
 	vk::UniqueDescriptorPool _textureDescriptorPool;
 	vk::UniqueDescriptorPool _imguiDescriptorPool;
@@ -106,17 +167,50 @@ protected:
 	vk::SwapchainCreateInfoKHR _swapchainInfo;
 	Swapchain _swapchain;
 	std::vector<Swapchain::BufferSet> _swapchainBuffers;
+	// in headless mode, the swapchain consists only of this image, which is copied to the readback buffer after each
+	// frame
+	vma::UniqueImage _offscreenImage;
+	vma::UniqueBuffer _offscreenReadbackBuffer;
 
 	// passes & resources
-	std::array<vk::UniqueCommandBuffer, numGBuffers> _mainCommandBuffers;
+	// one for each segment of the frame graph, or null for external segments
+	std::array<std::vector<vk::UniqueCommandBuffer>, numGBuffers> _mainCommandBuffers;
+	// records the main command buffers, see _buildFrameGraph()
+	FrameGraph _frameGraph;
+	FrameGraph::ResourceId _gBufferResource = 0;
+	// the keys are a separate resource since only the ReSTIR pass reads them, including those of the previous frame
+	FrameGraph::ResourceId _gBufferKeyResource = 0;
+	// written by the culling pass and read by the G-buffer pass
+	FrameGraph::ResourceId _drawCommandResource = 0;
+	FrameGraph::ResourceId _reservoirResource = 0;
+	FrameGraph::ResourceId _lightTileResource = 0;
+	// the reservoirs produced by the ReSTIR pass before unbiased spatial reuse
+	FrameGraph::ResourceId _reservoirTemporaryResource = 0;
+
+	// holds the uniforms of all passes, with one region per G-buffer so that the CPU can write the uniforms of one
+	// frame while the previous one is still in flight. the CPU copies are written to the region of
+	// _currentGBufferFrame every frame
+	UniformRingBuffer _uniformRingBuffer;
+	uint32_t _gBufferUniformOffset = 0;
+	uint32_t _restirUniformOffset = 0;
+	uint32_t _lightingPassUniformOffset = 0;
+	uint32_t _cullingUniformOffset = 0;
+	shader::RestirUniforms _restirUniforms{};
+	shader::LightingPassUniforms _lightingPassUniforms{};
 
 	GBuffer _gBuffers[2];
 	GBufferPass _gBufferPass;
 	GBufferPass::Resources _gBufferResources;
+	// only allocated in visibility buffer mode
+	std::array<vk::UniqueDescriptorSet, numGBuffers> _gBufferResolveDescriptors;
 
-	vma::UniqueBuffer _restirUniformBuffer;
+	// only created if GPU culling is supported
+	CullingPass _cullingPass;
+	std::array<vk::UniqueDescriptorSet, numGBuffers> _cullingDescriptors;
+	std::array<vma::UniqueBuffer, numGBuffers> _drawCommandBuffers;
+
+	vma::UniqueBuffer _lightTileBuffer;
 	std::array<vma::UniqueBuffer, numGBuffers> _reservoirBuffers;
-	vma::UniqueBuffer _reservoirTemporaryBuffer;
 	vk::DeviceSize _reservoirBufferSize;
 
 	SpatialReusePass _spatialReusePass;
@@ -124,7 +218,6 @@ protected:
 	std::array<vk::UniqueDescriptorSet, numGBuffers> _spatialReuseSecondDescriptors;
 
 	LightingPass _lightingPass;
-	vma::UniqueBuffer _lightingPassUniformBuffer;
 	std::array<vk::UniqueDescriptorSet, numGBuffers> _lightingPassDescriptorSets;
 
 	RestirPass _restirPass;
@@ -155,33 +248,75 @@ protected:
 	std::vector<vk::UniqueSemaphore> _imageAvailableSemaphore;
 	std::vector<vk::UniqueSemaphore> _renderFinishedSemaphore;
 	std::vector<vk::UniqueFence> _inFlightFences;
-	std::vector<vk::UniqueFence> _inFlightImageFences;
-
-	vk::UniqueFence _mainFence;
+	// the in-flight fence of the last frame that used each swapchain image or G-buffer, or null
+	std::vector<vk::Fence> _inFlightImageFences;
+	std::array<vk::Fence, numGBuffers> _inFlightGBufferFences{};
+
+	// used in place of the in-flight fences in headless mode
+	vk::UniqueFence _offscreenFence;
+
+	// with async compute, the segments of the frame graph on the two queues wait for each other using one timeline
+	// semaphore per queue. empty otherwise
+	std::vector<vk::UniqueSemaphore> _queueTimelines;
+	std::vector<uint64_t> _queueTimelineValues;
+	// the timeline values signalled by each segment of the frame graph in the last few frames, indexed by
+	// _frameGraphFrames modulo the number of frames kept
+	std::vector<std::vector<uint64_t>> _segmentTimelineValues;
+	// number of frames submitted since the frame graph was last built
+	uint32_t _frameGraphFrames = 0;
+
+	// slots [0, numGBuffers) are used by the main command buffers on the graphics queue, the next maxFramesInFlight
+	// slots by the command buffers recorded for each frame in flight, and the last numGBuffers slots by the main
+	// command buffers on the async compute queue
+	GpuProfiler _gpuProfiler;
 
 	// ui
 	int _debugMode = GBUFFER_DEBUG_NONE;
 	float _gamma = 1.0f;
 	int _log2InitialLightSamples = 5;
+	bool _adaptiveLightSampling = false;
+	int _log2MinInitialLightSamples = 2;
+	LightSamplingMethod _lightSamplingMethod = LightSamplingMethod::aliasTable;
 	VisibilityTestMethod _visibilityTestMethod = VisibilityTestMethod::hardware;
 	bool _enableTemporalReuse = true;
 	int _temporalReuseSampleMultiplier = 20;
 	int _spatialReuseIterations = 1;
+	RestirShaderConfig _shaderConfig;
 
-	bool _viewParamChanged = false;
 	bool _renderPathChanged = false;
 
+	// whether the G-buffer pass draws the nodes that the culling pass finds to be visible, instead of all nodes
+	bool _gpuCulling = false;
+	bool _gpuCullingSupported = false;
+
 	bool _unbiasedSpatialReuse = true;
 
+	std::size_t _currentGBufferFrame = 0;
+	nvmath::mat4 _prevFrameProjectionView;
+
 	nvmath::vec2f _lastMouse;
 	int _pressedMouseButton = -1;
-	bool _cameraUpdated = true;
 
 
 	void _onMouseMoveEvent(double x, double y);
 	void _onMouseButtonEvent(int button, int action, int mods);
 	void _onScrollEvent(double x, double y);
 
+	// rebuilds resources if the render path has changed, and writes the uniforms of _currentGBufferFrame. the last frame
+	// that used the G-buffer must have finished
+	void _updateFrameUniforms();
+
+	void _initializeGBufferResolveDescriptors() {
+		if (!GBuffer::Formats::get().visibilityBuffer) {
+			return;
+		}
+		for (std::size_t i = 0; i < numGBuffers; ++i) {
+			_gBufferPass.initializeResolveDescriptorSetFor(
+				_gBuffers[i], _sceneBuffers, _device.get(), _gBufferResolveDescriptors[i].get()
+			);
+		}
+	}
+
 	void _createSwapchainBuffers() {
 		_swapchainBuffers.clear();
 		_swapchainBuffers = _swapchain.getBuffers(_device.get(), _lightingPass.getPass(), _commandPool.get());
@@ -198,8 +333,14 @@ protected:
 				cmdBuf.get(), _gBuffers[i].getNormalBuffer(), GBuffer::Formats::get().normal,
 				vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal
 			);
+			if (!GBuffer::Formats::get().compact) {
+				transitionImageLayout(
+					cmdBuf.get(), _gBuffers[i].getWorldPositionBuffer(), GBuffer::Formats::get().worldPosition,
+					vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal
+				);
+			}
 			transitionImageLayout(
-				cmdBuf.get(), _gBuffers[i].getWorldPositionBuffer(), GBuffer::Formats::get().worldPosition,
+				cmdBuf.get(), _gBuffers[i].getKeyBuffer(), GBuffer::Formats::get().key,
 				vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal
 			);
 			transitionImageLayout(
@@ -209,88 +350,331 @@ protected:
 		}
 	}
 
-	void _recordMainCommandBuffers() {
-		for (std::size_t i = 0; i < numGBuffers; ++i) {
-			vk::CommandBufferBeginInfo beginInfo;
-			_mainCommandBuffers[i]->begin(beginInfo);
-
-			_gBufferPass.issueCommands(_mainCommandBuffers[i].get(), _gBuffers[i].getFramebuffer());
-
-			_restirPass.staticDescriptorSet = _restirStaticDescriptor.get();
-			_restirPass.frameDescriptorSet = _restirFrameDescriptors[i].get();
-#ifdef RENDERDOC_CAPTURE
-			_restirPass.useSoftwareRayTracing = true;
-#else
-			_restirPass.useSoftwareRayTracing = _visibilityTestMethod != VisibilityTestMethod::hardware;
-#endif
-			_restirPass.raytraceDescriptorSet =
-				_restirPass.useSoftwareRayTracing ?
-				_restirSoftwareRayTraceDescriptor.get() :
-				_restirHardwareRayTraceDescriptor.get();
-
-			_restirPass.bufferExtent = _swapchain.getImageExtent();
-			_restirPass.issueCommands(_mainCommandBuffers[i].get(), nullptr);
+	// with async compute in windowed mode, the lighting pass of each frame is recorded into the command buffer of the
+	// next frame, so that it overlaps with the ReSTIR passes of that frame instead of waiting for them
+	[[nodiscard]] bool _isLightingDeferred() const {
+		return _asyncComputeQueueIndex && _window;
+	}
+	// the queue of the frame graph that the ReSTIR passes run on
+	[[nodiscard]] uint32_t _getComputeQueue() const {
+		return _asyncComputeQueueIndex ? 1 : 0;
+	}
+	[[nodiscard]] uint32_t _getMainProfilerSlot(uint32_t frame, uint32_t queue) const {
+		return static_cast<uint32_t>(queue == 0 ? frame : numGBuffers + maxFramesInFlight + frame);
+	}
+	// the index of the segment of the lighting pass in the frame graph
+	[[nodiscard]] std::size_t _getLightingSegment() const {
+		const std::vector<FrameGraph::Segment> &segments = _frameGraph.getSegments();
+		return static_cast<std::size_t>(std::find_if(
+			segments.begin(), segments.end(), [](const FrameGraph::Segment &seg) {
+				return seg.external;
+			}
+		) - segments.begin());
+	}
 
-			if (_unbiasedSpatialReuse) {
-				_unbiasedReusePass.frameDescriptorSet = _unbiasedReusePassFrameDescriptors[i].get();
-#ifdef RENDERDOC_CAPTURE
-				_unbiasedReusePass.useSoftwareRayTracing = true;
-#else
-				_unbiasedReusePass.useSoftwareRayTracing = _visibilityTestMethod != VisibilityTestMethod::hardware;
-#endif
-				_unbiasedReusePass.raytraceDescriptorSet =
-					_unbiasedReusePass.useSoftwareRayTracing ?
-					_unbiasedReusePassSwRaytraceDescriptors.get() :
-					_unbiasedReusePassHwRaytraceDescriptors.get();
-				_unbiasedReusePass.bufferExtent = _swapchain.getImageExtent();
-				_unbiasedReusePass.issueCommands(_mainCommandBuffers[i].get(), _dynamicDispatcher);
-			} else {
-				for (int j = 0; j < _spatialReuseIterations; ++j) {
-					_spatialReusePass.descriptorSet = _spatialReuseDescriptors[i].get();
-					_spatialReusePass.iter = j * 2;
-					_spatialReusePass.issueCommands(_mainCommandBuffers[i].get(), nullptr);
-					_spatialReusePass.descriptorSet = _spatialReuseSecondDescriptors[i].get();
-					_spatialReusePass.iter = j * 2 + 1;
-					_spatialReusePass.issueCommands(_mainCommandBuffers[i].get(), nullptr);
+	// adds the passes of the main command buffers to the frame graph, depending on the current render path. all
+	// previously submitted frames must have finished
+	void _buildFrameGraph() {
+		using Stage = vk::PipelineStageFlagBits;
+		using AccessType = vk::AccessFlagBits;
+		using Access = FrameGraph::Access;
+
+		bool useSoftwareRayTracing = !_hardwareRayTracing || _visibilityTestMethod != VisibilityTestMethod::hardware;
+		vk::PipelineStageFlags rayTraceStage = useSoftwareRayTracing ? Stage::eComputeShader : Stage::eRayTracingShaderKHR;
+		uint32_t computeQueue = _getComputeQueue();
+
+		// the images are transferred between queue families with async compute
+		const GBuffer::Formats &formats = GBuffer::Formats::get();
+		for (uint32_t i = 0; i < numGBuffers; ++i) {
+			const GBuffer &gBuffer = _gBuffers[i];
+			std::vector<FrameGraph::Image> images;
+			for (vk::Image image : {
+				gBuffer.getAlbedoBuffer(), gBuffer.getNormalBuffer(), gBuffer.getMaterialPropertiesBuffer(),
+				gBuffer.getWorldPositionBuffer(), gBuffer.getMotionVectorBuffer()
+			}) {
+				// the compact layout does not have all images
+				if (image) {
+					images.push_back({ image, vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eShaderReadOnlyOptimal });
 				}
 			}
+			images.push_back({ gBuffer.getDepthBuffer(), formats.depthAspect, vk::ImageLayout::eShaderReadOnlyOptimal });
+			_frameGraph.setImages(_gBufferResource, i, std::move(images));
+			_frameGraph.setImages(
+				_gBufferKeyResource, i,
+				{ { gBuffer.getKeyBuffer(), vk::ImageAspectFlagBits::eColor, vk::ImageLayout::eShaderReadOnlyOptimal } }
+			);
+		}
 
-			_mainCommandBuffers[i]->end();
+		_frameGraph.clearPasses();
+
+		vk::PipelineStageFlags gBufferStages =
+			Stage::eColorAttachmentOutput | Stage::eEarlyFragmentTests | Stage::eLateFragmentTests;
+		vk::AccessFlags gBufferAccess = AccessType::eColorAttachmentWrite | AccessType::eDepthStencilAttachmentWrite;
+		std::vector<Access> gBufferAccesses{
+			// the render pass overwrites all images, so their contents are not transferred back from the compute queue
+			Access(_gBufferResource, gBufferStages, gBufferAccess, 0, true),
+			Access(_gBufferKeyResource, gBufferStages, gBufferAccess, 0, true)
+		};
+		if (_gpuCulling) {
+			_frameGraph.addPass(
+				"Culling",
+				{
+					Access(
+						_drawCommandResource, Stage::eTransfer | Stage::eComputeShader,
+						AccessType::eTransferWrite | AccessType::eShaderRead | AccessType::eShaderWrite
+					)
+				},
+				[this](vk::CommandBuffer commandBuffer, uint32_t frame) {
+					_cullingPass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _cullingUniformOffset);
+					_cullingPass.descriptorSet = _cullingDescriptors[frame].get();
+					_cullingPass.drawBuffer = _drawCommandBuffers[frame].get();
+					_gpuProfiler.beginSection(commandBuffer, frame, "Culling");
+					_cullingPass.issueCommands(commandBuffer, nullptr);
+					_gpuProfiler.endSection(commandBuffer, frame);
+				}
+			);
+			gBufferAccesses.emplace_back(_drawCommandResource, Stage::eDrawIndirect, AccessType::eIndirectCommandRead);
+		}
+		_frameGraph.addPass(
+			"G-Buffer", std::move(gBufferAccesses),
+			[this](vk::CommandBuffer commandBuffer, uint32_t frame) {
+				_gBufferPass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _gBufferUniformOffset);
+				_gBufferPass.resolveDescriptorSet = _gBufferResolveDescriptors[frame].get();
+				_gBufferPass.drawCommandBuffer = _gpuCulling ? _drawCommandBuffers[frame].get() : vk::Buffer();
+				_gpuProfiler.beginSection(commandBuffer, frame, "G-Buffer");
+				_gBufferPass.issueCommands(commandBuffer, _gBuffers[frame].getFramebuffer());
+				_gpuProfiler.endSection(commandBuffer, frame);
+			}
+		);
 
+		// recorded into the command buffer of the swapchain image or the offscreen image
+		auto addLightingPass = [&](uint32_t framesAgo) {
+			_frameGraph.addExternalPass(
+				"Lighting",
+				{
+					Access(_gBufferResource, Stage::eFragmentShader, AccessType::eShaderRead, framesAgo),
+					Access(_reservoirResource, Stage::eFragmentShader, AccessType::eShaderRead, framesAgo)
+				}
+			);
+		};
+		if (_isLightingDeferred()) {
+			addLightingPass(1);
+		}
+
+		bool useLightTiles = _lightSamplingMethod == LightSamplingMethod::lightTiles;
+		if (useLightTiles) {
+			_frameGraph.addPass(
+				"Light Tiles",
+				{ Access(_lightTileResource, Stage::eComputeShader, AccessType::eShaderWrite) },
+				[this, computeQueue](vk::CommandBuffer commandBuffer, uint32_t frame) {
+					_restirPass.staticDescriptorSet = _restirStaticDescriptor.get();
+					_restirPass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _restirUniformOffset);
+					uint32_t slot = _getMainProfilerSlot(frame, computeQueue);
+					// summed up with the ReSTIR pass by the profiler
+					_gpuProfiler.beginSection(commandBuffer, slot, "ReSTIR");
+					_restirPass.issueLightTileCommands(commandBuffer);
+					_gpuProfiler.endSection(commandBuffer, slot);
+				},
+				computeQueue
+			);
+		}
 
+		// the initial candidates are written to the temporary buffer if they're reused by the unbiased pass
+		FrameGraph::ResourceId restirOutput = _unbiasedSpatialReuse ? _reservoirTemporaryResource : _reservoirResource;
+		std::vector<Access> restirAccesses{
+			Access(_gBufferResource, rayTraceStage, AccessType::eShaderRead),
+			Access(_gBufferKeyResource, rayTraceStage, AccessType::eShaderRead),
+			Access(_gBufferKeyResource, rayTraceStage, AccessType::eShaderRead, 1),
+			Access(_reservoirResource, rayTraceStage, AccessType::eShaderRead, 1),
+			Access(restirOutput, rayTraceStage, AccessType::eShaderWrite)
+		};
+		if (useLightTiles) {
+			restirAccesses.emplace_back(_lightTileResource, rayTraceStage, AccessType::eShaderRead);
+		}
+		_frameGraph.addPass(
+			"ReSTIR", std::move(restirAccesses),
+			[this, useSoftwareRayTracing, computeQueue](vk::CommandBuffer commandBuffer, uint32_t frame) {
+				_restirPass.staticDescriptorSet = _restirStaticDescriptor.get();
+				_restirPass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _restirUniformOffset);
+				_restirPass.frameDescriptorSet = _restirFrameDescriptors[frame].get();
+				_restirPass.useSoftwareRayTracing = useSoftwareRayTracing;
+				_restirPass.raytraceDescriptorSet =
+					useSoftwareRayTracing ?
+					_restirSoftwareRayTraceDescriptor.get() :
+					_restirHardwareRayTraceDescriptor.get();
+				_restirPass.bufferExtent = _swapchain.getImageExtent();
+				uint32_t slot = _getMainProfilerSlot(frame, computeQueue);
+				_gpuProfiler.beginSection(commandBuffer, slot, "ReSTIR");
+				_restirPass.issueCommands(commandBuffer, nullptr);
+				_gpuProfiler.endSection(commandBuffer, slot);
+			},
+			computeQueue
+		);
+		if (_asyncComputeQueueIndex) {
+			// the G-buffer pass of the next frame overwrites the keys read above, so it only waits for the passes so far
+			_frameGraph.splitSegment();
+		}
+
+		if (_unbiasedSpatialReuse) {
+			_frameGraph.addPass(
+				"Unbiased Reuse",
+				{
+					Access(_gBufferResource, rayTraceStage, AccessType::eShaderRead),
+					Access(_reservoirTemporaryResource, rayTraceStage, AccessType::eShaderRead),
+					Access(_reservoirResource, rayTraceStage, AccessType::eShaderWrite)
+				},
+				[this, useSoftwareRayTracing, computeQueue](vk::CommandBuffer commandBuffer, uint32_t frame) {
+					_unbiasedReusePass.frameDescriptorSet = _unbiasedReusePassFrameDescriptors[frame].get();
+					_unbiasedReusePass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _restirUniformOffset);
+					_unbiasedReusePass.useSoftwareRayTracing = useSoftwareRayTracing;
+					_unbiasedReusePass.raytraceDescriptorSet =
+						useSoftwareRayTracing ?
+						_unbiasedReusePassSwRaytraceDescriptors.get() :
+						_unbiasedReusePassHwRaytraceDescriptors.get();
+					_unbiasedReusePass.bufferExtent = _swapchain.getImageExtent();
+					uint32_t slot = _getMainProfilerSlot(frame, computeQueue);
+					_gpuProfiler.beginSection(commandBuffer, slot, "Unbiased Reuse");
+					_unbiasedReusePass.issueCommands(commandBuffer, _dynamicDispatcher);
+					_gpuProfiler.endSection(commandBuffer, slot);
+				},
+				computeQueue
+			);
+		} else {
+			// each iteration ping-pongs between the reservoirs of this frame and those of the previous frame, which have
+			// already been used for temporal reuse
+			for (int j = 0; j < _spatialReuseIterations; ++j) {
+				for (int k = 0; k < 2; ++k) {
+					_frameGraph.addPass(
+						"Spatial Reuse",
+						{
+							Access(_gBufferResource, Stage::eComputeShader, AccessType::eShaderRead),
+							Access(_reservoirResource, Stage::eComputeShader, AccessType::eShaderRead, k),
+							Access(_reservoirResource, Stage::eComputeShader, AccessType::eShaderWrite, 1 - k)
+						},
+						[this, computeQueue, iter = j * 2 + k](vk::CommandBuffer commandBuffer, uint32_t frame) {
+							_spatialReusePass.uniformOffset = _uniformRingBuffer.getDynamicOffset(frame, _restirUniformOffset);
+							_spatialReusePass.descriptorSet =
+								iter % 2 == 0 ?
+								_spatialReuseDescriptors[frame].get() :
+								_spatialReuseSecondDescriptors[frame].get();
+							_spatialReusePass.iter = iter;
+							uint32_t slot = _getMainProfilerSlot(frame, computeQueue);
+							// all iterations are summed up by the profiler
+							_gpuProfiler.beginSection(commandBuffer, slot, "Spatial Reuse");
+							_spatialReusePass.issueCommands(commandBuffer, nullptr);
+							_gpuProfiler.endSection(commandBuffer, slot);
+						},
+						computeQueue
+					);
+				}
+			}
+		}
+
+		if (!_isLightingDeferred()) {
+			addLightingPass(0);
+		}
+
+		_frameGraphFrames = 0;
+		_segmentTimelineValues.assign(
+			_frameGraph.getPeriod() + 1, std::vector<uint64_t>(_frameGraph.getSegments().size(), 0)
+		);
+	}
+
+	// reallocates and records the main command buffers. the previous ones must no longer be in use
+	void _recordMainCommandBuffers() {
+		const std::vector<FrameGraph::Segment> &segments = _frameGraph.getSegments();
+		for (std::size_t i = 0; i < numGBuffers; ++i) {
+			auto frame = static_cast<uint32_t>(i);
+			_mainCommandBuffers[i].clear();
+			_mainCommandBuffers[i].resize(segments.size());
+			std::array<bool, 2> profilerSlotReset{};
+			for (std::size_t j = 0; j < segments.size(); ++j) {
+				const FrameGraph::Segment &segment = segments[j];
+				if (segment.external) {
+					continue;
+				}
+				vk::CommandBufferAllocateInfo bufferInfo;
+				bufferInfo
+					.setCommandPool(segment.queue == 0 ? _commandPool.get() : _asyncComputeCommandPool.get())
+					.setCommandBufferCount(1)
+					.setLevel(vk::CommandBufferLevel::ePrimary);
+				_mainCommandBuffers[i][j] = std::move(_device->allocateCommandBuffersUnique(bufferInfo)[0]);
+				vk::CommandBuffer commandBuffer = _mainCommandBuffers[i][j].get();
+
+				vk::CommandBufferBeginInfo beginInfo;
+				commandBuffer.begin(beginInfo);
+				// the profiler slot of each queue is reset by its first segment
+				if (!profilerSlotReset[segment.queue]) {
+					_gpuProfiler.beginFrame(commandBuffer, _getMainProfilerSlot(frame, segment.queue));
+					profilerSlotReset[segment.queue] = true;
+				}
+				_frameGraph.record(j, commandBuffer, frame);
+				commandBuffer.end();
+			}
+		}
+	}
+	// submits the main command buffers of _currentGBufferFrame, with the given command buffer in place of the lighting
+	// segment. the semaphores are waited for and signalled by the lighting segment, and the fence is signalled when
+	// all work submitted to the graphics queue by this call has finished
+	void _submitMainCommandBuffers(
+		vk::CommandBuffer lightingCommandBuffer, vk::Semaphore waitSemaphore, vk::Semaphore signalSemaphore,
+		vk::Fence
+	);
+
+	// switches all passes that depend on _shaderConfig to the matching pipelines. _updateRestirBuffers() needs to be
+	// called afterwards since the size of reservoirs may have changed
+	void _updateShaderConfig() {
+		if (_shaderConfig.tiledReuse) {
+			uint32_t maxSharedMemorySize = _physicalDevice.getProperties().limits.maxComputeSharedMemorySize;
+			if (std::optional<uint32_t> apron = _shaderConfig.getMaxTileApron(maxSharedMemorySize)) {
+				_shaderConfig.tileApron = apron.value();
+			} else {
+				std::cout << "Workgroups are too large for tiled spatial reuse, disabling it\n";
+				_shaderConfig.tiledReuse = false;
+			}
+		}
+		// the passes compile the pipelines of the new configuration in parallel
+		runInParallel({
+			[&]() { _restirPass.setShaderConfig(_device.get(), _shaderConfig); },
+			[&]() { _spatialReusePass.setShaderConfig(_device.get(), _shaderConfig); },
+			[&]() { _unbiasedReusePass.setShaderConfig(_device.get(), _shaderConfig); },
+			[&]() { _lightingPass.setShaderConfig(_device.get(), _shaderConfig); }
+		});
+		if (_hardwareRayTracing) {
+			_restirPass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice);
+			_unbiasedReusePass.createShaderBindingTable(_device.get(), _allocator, _physicalDevice, _dynamicDispatcher);
 		}
 	}
 
 	void _updateRestirBuffers() {
-		uint32_t numPixels = _swapchain.getImageExtent().width * _swapchain.getImageExtent().height;
-		_reservoirBufferSize = numPixels * sizeof(shader::Reservoir);
+		_reservoirBufferSize = _shaderConfig.getReservoirBufferSize(_swapchain.getImageExtent());
 		{
 			TransientCommandBuffer cmdBuf = _transientCommandBufferPool.begin(_graphicsComputeQueue);
 			for (std::size_t i = 0; i < numGBuffers; ++i) {
-				_reservoirBuffers[i] = _allocator.createTypedBuffer<shader::Reservoir>(
-					numPixels,
+				_reservoirBuffers[i] = _allocator.createBuffer(
+					static_cast<uint32_t>(_reservoirBufferSize),
 					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
 					VMA_MEMORY_USAGE_GPU_ONLY
 					);
 				// zero-initialize reservoir buffers
 				cmdBuf->fillBuffer(_reservoirBuffers[i].get(), 0, VK_WHOLE_SIZE, 0);
 			}
-			_reservoirTemporaryBuffer = _allocator.createTypedBuffer<shader::Reservoir>(
-				numPixels,
-				vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
-				VMA_MEMORY_USAGE_GPU_ONLY
-				);
-			cmdBuf->fillBuffer(_reservoirTemporaryBuffer.get(), 0, VK_WHOLE_SIZE, 0);
 		}
+		// the temporary reservoir buffer is only allocated if the current render path uses it
+		_buildFrameGraph();
+		_frameGraph.setTransientBufferSize(_reservoirTemporaryResource, _reservoirBufferSize);
+		_frameGraph.compile(_device.get(), _allocator);
+		vk::Buffer reservoirTemporaryBuffer = _frameGraph.getTransientBuffer(_reservoirTemporaryResource);
 
 		_restirPass.initializeStaticDescriptorSetFor(
-			_sceneBuffers, _restirUniformBuffer.get(), _device.get(), _restirStaticDescriptor.get()
+			_sceneBuffers, _uniformRingBuffer.getBuffer(), _lightTileBuffer.get(),
+			_device.get(), _restirStaticDescriptor.get()
 		);
-#ifndef RENDERDOC_CAPTURE
-		_restirPass.initializeHardwareRayTracingDescriptorSet(
-			_sceneRtBuffers, _device.get(), _restirHardwareRayTraceDescriptor.get()
-		);
-#endif
+		if (_hardwareRayTracing) {
+			_restirPass.initializeHardwareRayTracingDescriptorSet(
+				_sceneRtBuffers, _device.get(), _restirHardwareRayTraceDescriptor.get()
+			);
+		}
 		_restirPass.initializeSoftwareRayTracingDescriptorSet(
 			_aabbTreeBuffers, _device.get(), _restirSoftwareRayTraceDescriptor.get()
 		);
@@ -298,7 +682,7 @@ protected:
 			_restirPass.initializeFrameDescriptorSetFor(
 				_gBuffers[i], _gBuffers[(i + numGBuffers - 1) % numGBuffers],
 				_unbiasedSpatialReuse ?
-				_reservoirTemporaryBuffer.get() :
+				reservoirTemporaryBuffer :
 				_reservoirBuffers[i].get(),
 				_reservoirBuffers[(i + numGBuffers - 1) % numGBuffers].get(),
 				_reservoirBufferSize,
@@ -308,26 +692,26 @@ protected:
 			if (_unbiasedSpatialReuse) {
 				_unbiasedReusePass.initializeFrameDescriptorSet(
 					_device.get(),
-					_gBuffers[i], _restirUniformBuffer.get(),
-					_reservoirTemporaryBuffer.get(), _reservoirBuffers[i].get(), _reservoirBufferSize,
+					_gBuffers[i], _sceneBuffers, _uniformRingBuffer.getBuffer(),
+					reservoirTemporaryBuffer, _reservoirBuffers[i].get(), _reservoirBufferSize,
 					_unbiasedReusePassFrameDescriptors[i].get()
 				);
 				_unbiasedReusePass.initializeSoftwareRaytraceDescriptorSet(
 					_device.get(), _aabbTreeBuffers, _unbiasedReusePassSwRaytraceDescriptors.get()
 				);
-#ifndef RENDERDOC_CAPTURE
-				_unbiasedReusePass.initializeHardwareRaytraceDescriptorSet(
-					_device.get(), _sceneRtBuffers, _unbiasedReusePassHwRaytraceDescriptors.get()
-				);
-#endif
+				if (_hardwareRayTracing) {
+					_unbiasedReusePass.initializeHardwareRaytraceDescriptorSet(
+						_device.get(), _sceneRtBuffers, _unbiasedReusePassHwRaytraceDescriptors.get()
+					);
+				}
 			} else {
 				_spatialReusePass.initializeDescriptorSetFor(
-					_gBuffers[i], _restirUniformBuffer.get(), _reservoirBuffers[i].get(), _reservoirBufferSize,
+					_gBuffers[i], _sceneBuffers, _uniformRingBuffer.getBuffer(), _reservoirBuffers[i].get(), _reservoirBufferSize,
 					_reservoirBuffers[(i + numGBuffers - 1) % numGBuffers].get(),
 					_device.get(), _spatialReuseDescriptors[i].get()
 				);
 				_spatialReusePass.initializeDescriptorSetFor(
-					_gBuffers[i], _restirUniformBuffer.get(), _reservoirBuffers[(i + numGBuffers - 1) % numGBuffers].get(), _reservoirBufferSize,
+					_gBuffers[i], _sceneBuffers, _uniformRingBuffer.getBuffer(), _reservoirBuffers[(i + numGBuffers - 1) % numGBuffers].get(), _reservoirBufferSize,
 					_reservoirBuffers[i].get(), _device.get(), _spatialReuseSecondDescriptors[i].get()
 				);
 			}
@@ -339,7 +723,7 @@ protected:
 		for (std::size_t i = 0; i < numGBuffers; ++i) {
 			_lightingPass.initializeDescriptorSetFor(
 				_gBuffers[i], _sceneBuffers,
-				_lightingPassUniformBuffer.get(), _reservoirBuffers[i].get(), _reservoirBufferSize,
+				_uniformRingBuffer.getBuffer(), _reservoirBuffers[i].get(), _reservoirBufferSize,
 				_device.get(), _lightingPassDescriptorSets[i].get()
 			);
 		}
@@ -0,0 +1,202 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include <json.hpp>
+
+#include "app.h"
+
+[[nodiscard]] static std::optional<nvmath::vec3f> parseJsonVec3(const nlohmann::json &value) {
+	if (!value.is_array() || value.size() != 3) {
+		return std::nullopt;
+	}
+	for (const nlohmann::json &component : value) {
+		if (!component.is_number()) {
+			return std::nullopt;
+		}
+	}
+	return nvmath::vec3f(value[0].get<float>(), value[1].get<float>(), value[2].get<float>());
+}
+
+[[nodiscard]] static std::optional<std::vector<CameraKeyframe>> loadJsonCameraPath(std::istream &in) {
+	nlohmann::json document = nlohmann::json::parse(in, nullptr, false);
+	if (document.is_discarded()) {
+		return std::nullopt;
+	}
+	const nlohmann::json &frames = document.is_object() ? document.value("frames", nlohmann::json()) : document;
+	if (!frames.is_array()) {
+		return std::nullopt;
+	}
+
+	std::vector<CameraKeyframe> result;
+	for (const nlohmann::json &frame : frames) {
+		if (!frame.is_object() || !frame.contains("position") || !frame.contains("lookAt")) {
+			return std::nullopt;
+		}
+		std::optional<nvmath::vec3f> position = parseJsonVec3(frame["position"]);
+		std::optional<nvmath::vec3f> lookAt = parseJsonVec3(frame["lookAt"]);
+		if (!position || !lookAt) {
+			return std::nullopt;
+		}
+		CameraKeyframe &keyframe = result.emplace_back();
+		keyframe.position = position.value();
+		keyframe.lookAt = lookAt.value();
+		if (frame.contains("fov")) {
+			if (!frame["fov"].is_number()) {
+				return std::nullopt;
+			}
+			keyframe.fovYDegrees = frame["fov"].get<float>();
+		}
+	}
+	return result;
+}
+
+[[nodiscard]] static std::optional<std::vector<CameraKeyframe>> loadCsvCameraPath(std::istream &in) {
+	std::vector<CameraKeyframe> result;
+	std::string line;
+	bool firstLine = true;
+	while (std::getline(in, line)) {
+		bool isHeader = firstLine && std::any_of(line.begin(), line.end(), [](char c) {
+			return std::isalpha(static_cast<unsigned char>(c));
+		});
+		firstLine = false;
+		if (line.empty() || line[0] == '#' || isHeader) {
+			continue;
+		}
+
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::istringstream ss(line);
+		CameraKeyframe keyframe;
+		ss >>
+			keyframe.position.x >> keyframe.position.y >> keyframe.position.z >>
+			keyframe.lookAt.x >> keyframe.lookAt.y >> keyframe.lookAt.z;
+		if (!ss) {
+			return std::nullopt;
+		}
+		if (!(ss >> keyframe.fovYDegrees)) {
+			keyframe.fovYDegrees = 0.0f;
+		}
+		result.emplace_back(keyframe);
+	}
+	return result;
+}
+
+std::optional<std::vector<CameraKeyframe>> loadCameraPath(const std::filesystem::path &path) {
+	std::ifstream fin(path);
+	if (!fin) {
+		std::cerr << "Failed to open camera path " << path << "\n";
+		return std::nullopt;
+	}
+	std::optional<std::vector<CameraKeyframe>> result =
+		path.extension() == ".json" ? loadJsonCameraPath(fin) : loadCsvCameraPath(fin);
+	if (!result || result->empty()) {
+		std::cerr << "Invalid camera path " << path << "\n";
+		return std::nullopt;
+	}
+	return result;
+}
+
+
+// statistics of a series of timings in milliseconds
+[[nodiscard]] static nlohmann::json summarizeTimings(std::vector<float> times) {
+	nlohmann::json result = nlohmann::json::object();
+	if (times.empty()) {
+		return result;
+	}
+	std::sort(times.begin(), times.end());
+	auto percentile = [&times](std::size_t p) {
+		return times[std::min(times.size() * p / 100, times.size() - 1)];
+	};
+	float sum = 0.0f;
+	for (float time : times) {
+		sum += time;
+	}
+	result["min"] = times.front();
+	result["p50"] = percentile(50);
+	result["p90"] = percentile(90);
+	result["p95"] = percentile(95);
+	result["p99"] = percentile(99);
+	result["max"] = times.back();
+	result["average"] = sum / static_cast<float>(times.size());
+	return result;
+}
+
+static void applyKeyframe(App &app, const CameraKeyframe &keyframe) {
+	Camera &camera = app.getCamera();
+	camera.position = keyframe.position;
+	camera.lookAt = keyframe.lookAt;
+	if (keyframe.fovYDegrees > 0.0f) {
+		camera.fovYRadians = keyframe.fovYDegrees * nv_pi / 180.0f;
+	}
+	app.onCameraChanged();
+}
+
+bool runBenchmark(App &app, const std::vector<CameraKeyframe> &path, const BenchmarkSettings &settings) {
+	assert(app.isHeadless() && !path.empty());
+
+	app.setFrameIndex(settings.seed);
+	applyKeyframe(app, path.front());
+	for (uint32_t i = 0; i < settings.warmupFrames; ++i) {
+		app.renderOffscreenFrame();
+	}
+
+	uint32_t numFrames = settings.measuredFrames > 0 ? settings.measuredFrames : static_cast<uint32_t>(path.size());
+	std::vector<float> cpuTimes;
+	// GPU times of each section, in the order the sections are first seen
+	std::vector<std::pair<std::string, std::vector<float>>> gpuTimes;
+	nlohmann::json frames = nlohmann::json::array();
+	for (uint32_t i = 0; i < numFrames; ++i) {
+		applyKeyframe(app, path[i % path.size()]);
+
+		auto begin = std::chrono::steady_clock::now();
+		app.renderOffscreenFrame();
+		auto end = std::chrono::steady_clock::now();
+		float cpuTime = std::chrono::duration<float, std::milli>(end - begin).count();
+		cpuTimes.emplace_back(cpuTime);
+
+		nlohmann::json frame;
+		frame["frame"] = i;
+		frame["cpu_ms"] = cpuTime;
+		nlohmann::json &gpuFrame = frame["gpu_ms"] = nlohmann::json::object();
+		for (const auto &[name, time] : app.collectOffscreenFrameTimings()) {
+			gpuFrame[name] = time;
+			auto it = std::find_if(gpuTimes.begin(), gpuTimes.end(), [&name](const auto &section) {
+				return section.first == name;
+			});
+			if (it == gpuTimes.end()) {
+				it = gpuTimes.emplace(gpuTimes.end(), name, std::vector<float>());
+			}
+			it->second.emplace_back(time);
+		}
+		frames.emplace_back(std::move(frame));
+	}
+
+	nlohmann::json report;
+	report["warmup_frames"] = settings.warmupFrames;
+	report["measured_frames"] = numFrames;
+	report["seed"] = settings.seed;
+	report["frames"] = std::move(frames);
+	nlohmann::json &summary = report["summary"];
+	summary["cpu_ms"] = summarizeTimings(cpuTimes);
+	nlohmann::json &gpuSummary = summary["gpu_ms"] = nlohmann::json::object();
+	for (auto &[name, times] : gpuTimes) {
+		gpuSummary[name] = summarizeTimings(std::move(times));
+	}
+
+	std::cout << "Benchmark summary (ms):\n" << summary.dump(4) << "\n";
+
+	std::ofstream fout(settings.reportPath);
+	if (!fout) {
+		std::cerr << "Failed to write benchmark report " << settings.reportPath << "\n";
+		return false;
+	}
+	fout << report.dump(1, '\t') << "\n";
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nvmath.h>
+
+class App;
+
+// A camera path that is replayed frame by frame when benchmarking, so that runs can be compared across code changes
+// and drivers. Paths are read from either
+//  - JSON files: an array of objects (or an object with such an array named "frames") with "position" and "lookAt"
+//    arrays and an optional "fov" in degrees, or
+//  - CSV files: lines of "px,py,pz,lx,ly,lz[,fov]". Empty lines, lines starting with '#', and a header line are
+//    skipped.
+struct CameraKeyframe {
+	nvmath::vec3f position;
+	nvmath::vec3f lookAt;
+	// vertical field of view in degrees, or 0 to keep the current one
+	float fovYDegrees = 0.0f;
+};
+
+[[nodiscard]] std::optional<std::vector<CameraKeyframe>> loadCameraPath(const std::filesystem::path&);
+
+struct BenchmarkSettings {
+	// frames rendered at the first keyframe before measuring, to let temporal reuse and caches settle
+	uint32_t warmupFrames = 60;
+	// number of measured frames; the camera path is looped if it's shorter. 0 means one frame per keyframe
+	uint32_t measuredFrames = 0;
+	// value of RestirUniforms::frame before the first warm-up frame, which seeds all random number generators
+	uint32_t seed = 0;
+	// a JSON file containing the timings of each measured frame and their percentiles
+	std::filesystem::path reportPath = "benchmark.json";
+};
+
+// Renders the camera path offscreen and writes the report. The app must be in headless mode. Frames are rendered one
+// at a time, i.e. CPU times include waiting for the GPU. Returns false if the report cannot be written.
+[[nodiscard]] bool runBenchmark(App&, const std::vector<CameraKeyframe>&, const BenchmarkSettings&);
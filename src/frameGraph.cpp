@@ -0,0 +1,411 @@
+#include "frameGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+#include "misc.h"
+
+[[nodiscard]] bool isWriteAccess(vk::AccessFlags access) {
+	constexpr vk::AccessFlags writeAccess =
+		vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+		vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite |
+		vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite |
+		vk::AccessFlagBits::eAccelerationStructureWriteKHR;
+	return static_cast<bool>(access & writeAccess);
+}
+
+FrameGraph::ResourceId FrameGraph::addResource(std::string name, uint32_t numInstances) {
+	assert(numInstances > 0);
+	ResourceId result = _resources.size();
+	Resource &res = _resources.emplace_back();
+	res.name = std::move(name);
+	res.numInstances = numInstances;
+	res.firstState = _numResourceStates;
+	_numResourceStates += numInstances;
+	_period = std::lcm(_period, numInstances);
+	return result;
+}
+
+FrameGraph::ResourceId FrameGraph::addTransientBuffer(std::string name, vk::BufferUsageFlags usage) {
+	ResourceId result = _resources.size();
+	Resource &res = _resources.emplace_back();
+	res.name = std::move(name);
+	res.transient = true;
+	res.transientUsage = usage;
+	return result;
+}
+
+void FrameGraph::setTransientBufferSize(ResourceId id, vk::DeviceSize size) {
+	assert(_resources[id].transient);
+	_resources[id].transientSize = size;
+}
+
+void FrameGraph::setImages(ResourceId id, uint32_t instance, std::vector<Image> images) {
+	Resource &res = _resources[id];
+	assert(!res.transient && instance < res.numInstances);
+	res.images.resize(res.numInstances);
+	res.images[instance] = std::move(images);
+}
+
+void FrameGraph::addPass(std::string name, std::vector<Access> accesses, RecordFunction record, uint32_t queue) {
+	Pass &pass = _passes.emplace_back();
+	pass.name = std::move(name);
+	pass.accesses = std::move(accesses);
+	pass.record = std::move(record);
+	pass.queue = queue;
+	_addToSegment(pass, false);
+}
+
+void FrameGraph::addExternalPass(std::string name, std::vector<Access> accesses, uint32_t queue) {
+	Pass &pass = _passes.emplace_back();
+	pass.name = std::move(name);
+	pass.accesses = std::move(accesses);
+	pass.queue = queue;
+	_addToSegment(pass, true);
+}
+
+void FrameGraph::compile(vk::Device device, vma::Allocator &allocator) {
+	_allocateTransientBuffers(device, allocator);
+
+	_stateInstances.clear();
+	for (ResourceId i = 0; i < _resources.size(); ++i) {
+		if (!_resources[i].transient) {
+			for (uint32_t j = 0; j < _resources[i].numInstances; ++j) {
+				_stateInstances.emplace_back(i, j);
+			}
+		}
+	}
+	_stateInstances.resize(_numResourceStates + _numTransientSlots, { std::nullopt, 0 });
+
+	// frames are submitted in order, so the synchronization of a frame depends on the accesses of the frames before
+	// it. all states are known after one period, since every instance is accessed at least once per period, and the
+	// releases of a frame are known after another period when all transfers out of it have happened
+	std::size_t numQueues = std::max<std::size_t>(_queueFamilies.size(), 1);
+	State initialState;
+	initialState.queues.resize(numQueues);
+	initialState.lastAccesses.resize(numQueues);
+	std::vector<State> states(_numResourceStates + _numTransientSlots, initialState);
+	_barriers.assign(_period, std::vector<Barrier>(_passes.size()));
+	_segmentSyncs.assign(_period, std::vector<SegmentSync>(_segments.size()));
+	for (uint32_t frame = 0; frame < 3 * _period; ++frame) {
+		bool compiling = frame >= _period && frame < 2 * _period;
+		for (std::size_t i = 0; i < _passes.size(); ++i) {
+			const Pass &pass = _passes[i];
+			assert(pass.queue < numQueues);
+			Barrier barrier;
+			SegmentSync *sync = compiling ? &_segmentSyncs[frame - _period][pass.segment] : nullptr;
+			for (const Access &access : pass.accesses) {
+				_simulateAccess(access, pass.queue, { frame, pass.segment }, states, barrier, sync);
+			}
+			if (compiling) {
+				_barriers[frame - _period][i] = std::move(barrier);
+			}
+		}
+	}
+}
+
+void FrameGraph::record(std::size_t segment, vk::CommandBuffer commandBuffer, uint32_t frame) const {
+	const Segment &seg = _segments[segment];
+	uint32_t periodFrame = frame % _period;
+	for (std::size_t i = seg.beginPass; i < seg.endPass; ++i) {
+		const Barrier &barrier = _barriers[periodFrame][i];
+		if (barrier.srcStages) {
+			vk::MemoryBarrier memoryBarrier;
+			memoryBarrier
+				.setSrcAccessMask(barrier.srcAccess)
+				.setDstAccessMask(barrier.dstAccess);
+			std::vector<vk::ImageMemoryBarrier> imageBarriers;
+			for (const Transfer &transfer : barrier.acquires) {
+				_appendTransferBarriers(imageBarriers, transfer, false);
+			}
+			commandBuffer.pipelineBarrier(
+				barrier.srcStages, barrier.dstStages, {}, memoryBarrier, {}, imageBarriers
+			);
+		}
+		if (_passes[i].record) {
+			_passes[i].record(commandBuffer, frame);
+		}
+	}
+
+	// external passes are recorded after this, so they cannot release anything
+	const std::vector<Transfer> &releases = _segmentSyncs[periodFrame][segment].releases;
+	assert(!seg.external || releases.empty());
+	if (!releases.empty()) {
+		vk::PipelineStageFlags srcStages;
+		std::vector<vk::ImageMemoryBarrier> imageBarriers;
+		for (const Transfer &transfer : releases) {
+			srcStages |= transfer.stages;
+			_appendTransferBarriers(imageBarriers, transfer, true);
+		}
+		commandBuffer.pipelineBarrier(
+			srcStages ? srcStages : vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eBottomOfPipe,
+			{}, {}, {}, imageBarriers
+		);
+	}
+}
+
+void FrameGraph::_addToSegment(Pass &pass, bool external) {
+	if (
+		_segments.empty() || _splitSegment ||
+		_segments.back().queue != pass.queue || _segments.back().external != external
+	) {
+		Segment &seg = _segments.emplace_back();
+		seg.queue = pass.queue;
+		seg.beginPass = _passes.size() - 1;
+		seg.external = external;
+		_splitSegment = false;
+	}
+	_segments.back().endPass = _passes.size();
+	pass.segment = _segments.size() - 1;
+}
+
+void FrameGraph::_allocateTransientBuffers(vk::Device device, vma::Allocator &allocator) {
+	_freeTransientBuffers();
+
+	// lifetimes of the transient buffers, in passes
+	constexpr std::size_t unused = std::numeric_limits<std::size_t>::max();
+	std::vector<std::pair<std::size_t, std::size_t>> lifetimes(_resources.size(), { unused, 0 });
+	for (std::size_t i = 0; i < _passes.size(); ++i) {
+		for (const Access &access : _passes[i].accesses) {
+			auto &[first, last] = lifetimes[access.resource];
+			if (first == unused) {
+				first = i;
+				assert(!_resources[access.resource].transient || isWriteAccess(access.access));
+			}
+			last = i;
+		}
+	}
+	std::vector<ResourceId> used;
+	for (ResourceId i = 0; i < _resources.size(); ++i) {
+		if (_resources[i].transient && lifetimes[i].first != unused) {
+			used.emplace_back(i);
+		}
+	}
+	if (used.empty()) {
+		return;
+	}
+
+	// place buffers greedily in order of their first use into the first slot that's no longer in use by then
+	std::sort(used.begin(), used.end(), [&lifetimes](ResourceId lhs, ResourceId rhs) {
+		return lifetimes[lhs].first < lifetimes[rhs].first;
+	});
+	struct Slot {
+		std::size_t lastPass = 0;
+		vk::DeviceSize size = 0;
+		vk::DeviceSize offset = 0;
+	};
+	std::vector<Slot> slots;
+	vk::MemoryRequirements memoryRequirements;
+	memoryRequirements.memoryTypeBits = ~0u;
+	memoryRequirements.alignment = 1;
+	for (ResourceId id : used) {
+		Resource &res = _resources[id];
+		auto slot = std::find_if(slots.begin(), slots.end(), [&](const Slot &s) {
+			return s.lastPass < lifetimes[id].first;
+		});
+		if (slot == slots.end()) {
+			slot = slots.emplace(slots.end());
+		}
+		slot->lastPass = lifetimes[id].second;
+		res.transientSlot = static_cast<std::size_t>(slot - slots.begin());
+
+		vk::BufferCreateInfo bufferInfo;
+		bufferInfo
+			.setSize(res.transientSize)
+			.setUsage(res.transientUsage);
+		// ownership transfers are only made for images, so buffers are shared between all queues like the ones created
+		// by vma::Allocator::setBufferQueueFamilies()
+		if (_queueFamilies.size() > 1) {
+			bufferInfo
+				.setSharingMode(vk::SharingMode::eConcurrent)
+				.setQueueFamilyIndices(_queueFamilies);
+		} else {
+			bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+		}
+		res.transientBuffer = device.createBufferUnique(bufferInfo);
+		vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(res.transientBuffer.get());
+		slot->size = std::max(slot->size, requirements.size);
+		memoryRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+		memoryRequirements.alignment = std::max(memoryRequirements.alignment, requirements.alignment);
+	}
+	assert(memoryRequirements.memoryTypeBits != 0);
+	memoryRequirements.size = 0;
+	for (Slot &slot : slots) {
+		slot.offset = memoryRequirements.size;
+		memoryRequirements.size += ceilDiv(slot.size, memoryRequirements.alignment) * memoryRequirements.alignment;
+	}
+	_numTransientSlots = slots.size();
+
+	VmaAllocationCreateInfo allocationInfo{};
+	allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VmaAllocationInfo allocationDetails;
+	vkCheck(allocator.allocateMemory(memoryRequirements, _transientMemory, allocationDetails, allocationInfo));
+	_allocator = &allocator;
+	for (ResourceId id : used) {
+		Resource &res = _resources[id];
+		allocator.bindBufferMemory(_transientMemory, slots[res.transientSlot].offset, res.transientBuffer.get());
+	}
+}
+
+std::size_t FrameGraph::_getStateIndex(const Access &access, uint32_t frame) const {
+	const Resource &res = _resources[access.resource];
+	if (res.transient) {
+		assert(res.transientBuffer);
+		return _numResourceStates + res.transientSlot;
+	}
+	uint32_t framesAgo = access.framesAgo % res.numInstances;
+	return res.firstState + (frame + res.numInstances - framesAgo) % res.numInstances;
+}
+
+void FrameGraph::_simulateAccess(
+	const Access &access, uint32_t queue, Position position, std::vector<State> &states,
+	Barrier &barrier, SegmentSync *sync
+) {
+	std::size_t stateIndex = _getStateIndex(access, position.frame);
+	State &state = states[stateIndex];
+	bool write = isWriteAccess(access.access);
+	auto addDependency = [&](Position from) {
+		if (sync) {
+			Dependency dependency;
+			dependency.segment = from.segment;
+			dependency.framesAgo = position.frame - from.frame;
+			auto it = std::find_if(
+				sync->dependencies.begin(), sync->dependencies.end(), [&](const Dependency &dep) {
+					return dep.segment == dependency.segment && dep.framesAgo == dependency.framesAgo;
+				}
+			);
+			if (it == sync->dependencies.end()) {
+				sync->dependencies.emplace_back(dependency);
+			}
+		}
+	};
+	auto resetState = [&]() {
+		std::fill(state.queues.begin(), state.queues.end(), QueueState());
+		std::fill(state.lastAccesses.begin(), state.lastAccesses.end(), std::nullopt);
+	};
+
+	const std::optional<ResourceId> &resource = _stateInstances[stateIndex].first;
+	bool hasImages = resource && !_resources[*resource].images.empty();
+	if (hasImages && state.owner != queue) {
+		std::optional<Position> from = state.lastAccesses[state.owner];
+		if (from && !access.discard) {
+			// release the images at the end of the segment that last accessed them, and acquire them before this pass.
+			// the semaphore wait between the two makes all previous accesses available
+			const QueueState &ownerState = state.queues[state.owner];
+			Transfer transfer;
+			transfer.state = stateIndex;
+			transfer.srcQueue = state.owner;
+			transfer.dstQueue = queue;
+			transfer.stages = ownerState.writeStages | ownerState.readStages;
+			transfer.access = ownerState.writeAccess;
+			if (from->frame >= _period && from->frame < 2 * _period) {
+				_segmentSyncs[from->frame - _period][from->segment].releases.emplace_back(transfer);
+			}
+			addDependency(*from);
+			if (sync) {
+				transfer.stages = access.stages;
+				transfer.access = access.access;
+				barrier.srcStages |= vk::PipelineStageFlagBits::eTopOfPipe;
+				barrier.dstStages |= access.stages;
+				barrier.acquires.emplace_back(transfer);
+			}
+
+			// later accesses on this queue synchronize with the acquire like they would with a write
+			resetState();
+			QueueState &qs = state.queues[queue];
+			qs.writeStages = access.stages;
+			qs.visibleStages = access.stages;
+			qs.visibleAccess = access.access;
+			if (write) {
+				qs.writeAccess = access.access;
+			} else {
+				qs.readStages = access.stages;
+			}
+			state.lastAccesses[queue] = position;
+			state.lastWrite = position;
+			state.lastWriteQueue = queue;
+			state.owner = queue;
+			return;
+		}
+		state.owner = queue;
+	}
+
+	QueueState &qs = state.queues[queue];
+	if (write) {
+		// wait for all previous accesses, and make sure that the previous write does not land afterwards
+		barrier.srcStages |= qs.writeStages | qs.readStages;
+		barrier.srcAccess |= qs.writeAccess;
+		if (qs.writeStages | qs.readStages) {
+			barrier.dstStages |= access.stages;
+		}
+		if (qs.writeStages) {
+			barrier.dstAccess |= access.access;
+		}
+		// accesses on other queues are waited for using semaphores
+		for (std::size_t i = 0; i < state.lastAccesses.size(); ++i) {
+			if (i != queue && state.lastAccesses[i]) {
+				addDependency(*state.lastAccesses[i]);
+			}
+		}
+		resetState();
+		qs.writeStages = access.stages;
+		qs.writeAccess = access.access;
+		state.lastWrite = position;
+		state.lastWriteQueue = queue;
+	} else {
+		if (state.lastWrite && state.lastWriteQueue != queue) {
+			// only the first read on this queue after the write needs to wait for it
+			if (!state.lastAccesses[queue]) {
+				addDependency(*state.lastWrite);
+			}
+		} else {
+			bool visible =
+				(access.stages & qs.visibleStages) == access.stages &&
+				(access.access & qs.visibleAccess) == access.access;
+			if (qs.writeStages && !visible) {
+				barrier.srcStages |= qs.writeStages;
+				barrier.srcAccess |= qs.writeAccess;
+				barrier.dstStages |= access.stages;
+				barrier.dstAccess |= access.access;
+				qs.visibleStages |= access.stages;
+				qs.visibleAccess |= access.access;
+			}
+		}
+		qs.readStages |= access.stages;
+	}
+	state.lastAccesses[queue] = position;
+}
+
+void FrameGraph::_appendTransferBarriers(
+	std::vector<vk::ImageMemoryBarrier> &barriers, const Transfer &transfer, bool release
+) const {
+	auto [resource, instance] = _stateInstances[transfer.state];
+	for (const Image &image : _resources[*resource].images[instance]) {
+		vk::ImageMemoryBarrier barrier;
+		barrier
+			.setSrcAccessMask(release ? transfer.access : vk::AccessFlags())
+			.setDstAccessMask(release ? vk::AccessFlags() : transfer.access)
+			.setOldLayout(image.layout)
+			.setNewLayout(image.layout)
+			.setSrcQueueFamilyIndex(_queueFamilies[transfer.srcQueue])
+			.setDstQueueFamilyIndex(_queueFamilies[transfer.dstQueue])
+			.setImage(image.image)
+			.setSubresourceRange(vk::ImageSubresourceRange(
+				image.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+			));
+		barriers.emplace_back(barrier);
+	}
+}
+
+void FrameGraph::_freeTransientBuffers() {
+	for (Resource &res : _resources) {
+		res.transientBuffer.reset();
+	}
+	if (_transientMemory) {
+		_allocator->freeMemory(_transientMemory);
+		_transientMemory = nullptr;
+	}
+	_numTransientSlots = 0;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vma.h"
+
+// Records the passes of the command buffers that are prerecorded for each G-buffer, and inserts the pipeline barriers
+// between them that follow from the resources each pass declares to access. This includes barriers against the
+// accesses of previous frames, which may still be in flight. Image layouts are still managed by render passes, so apart
+// from queue family ownership transfers, all barriers are global memory barriers with the exact stages and accesses
+// involved.
+//
+// A resource can have multiple instances that consecutive frames use in turn, like the G-buffers and reservoir
+// buffers, and passes access either the instance of the frame being recorded or that of a previous frame. Transient
+// buffers are owned by the graph, are only allocated if a pass uses them, and share memory with other transient
+// buffers whose lifetimes do not overlap. Their contents do not persist between frames, so their first access in a
+// frame must be a write.
+//
+// Passes can run on different queues. Consecutive passes on the same queue form a segment that is recorded into one
+// command buffer, and segments wait for the segments on other queues that they depend on, e.g. through timeline
+// semaphores. Resources with images registered through setImages() are exclusively owned by one queue family and are
+// transferred between queue families with release and acquire barriers; all other resources that are used on
+// multiple queues must be created with concurrent sharing.
+class FrameGraph {
+public:
+	using ResourceId = std::size_t;
+	// records the commands of a pass for the given frame
+	using RecordFunction = std::function<void(vk::CommandBuffer, uint32_t frame)>;
+
+	struct Access {
+		Access() = default;
+		Access(ResourceId res, vk::PipelineStageFlags stg, vk::AccessFlags acc, uint32_t ago = 0, bool disc = false) :
+			resource(res), stages(stg), access(acc), framesAgo(ago), discard(disc) {
+		}
+
+		ResourceId resource = 0;
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+		// 0 for the instance of the frame being recorded, 1 for that of the previous frame, and so on
+		uint32_t framesAgo = 0;
+		// whether the pass overwrites the whole resource without reading it, in which case its previous contents are
+		// not transferred from other queue families
+		bool discard = false;
+	};
+	// an image of a resource that is transferred between queue families
+	struct Image {
+		vk::Image image;
+		vk::ImageAspectFlags aspect;
+		// the layout that the image is in between passes
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+	// consecutive passes on the same queue that are recorded into the same command buffer
+	struct Segment {
+		uint32_t queue = 0;
+		std::size_t beginPass = 0;
+		std::size_t endPass = 0;
+		// whether this segment consists of external passes
+		bool external = false;
+	};
+	// a segment on another queue that a segment needs to wait for before it starts
+	struct Dependency {
+		std::size_t segment = 0;
+		// the frame of that segment relative to the frame of the waiting segment
+		uint32_t framesAgo = 0;
+	};
+
+	FrameGraph() = default;
+	FrameGraph(const FrameGraph&) = delete;
+	FrameGraph &operator=(const FrameGraph&) = delete;
+	~FrameGraph() {
+		_freeTransientBuffers();
+	}
+
+	// the queue family index of each queue that passes can run on. only used for ownership transfers
+	void setQueueFamilies(std::vector<uint32_t> families) {
+		_queueFamilies = std::move(families);
+	}
+
+	// registers a resource that is owned elsewhere. frame i uses instance i % numInstances
+	[[nodiscard]] ResourceId addResource(std::string name, uint32_t numInstances = 1);
+	// registers a buffer that is owned by the graph. its size can be changed before each compile()
+	[[nodiscard]] ResourceId addTransientBuffer(std::string name, vk::BufferUsageFlags);
+	void setTransientBufferSize(ResourceId, vk::DeviceSize);
+	// the images that make up an instance of the resource, which are transferred to other queue families when they're
+	// accessed on other queues
+	void setImages(ResourceId, uint32_t instance, std::vector<Image>);
+
+	// removes all passes, but keeps the resources
+	void clearPasses() {
+		_passes.clear();
+		_segments.clear();
+		_splitSegment = false;
+	}
+	// passes are executed in the order they're added
+	void addPass(std::string name, std::vector<Access>, RecordFunction, uint32_t queue = 0);
+	// a pass that is recorded into another command buffer, e.g. the lighting pass. external passes form their own
+	// segments, and their barriers are recorded by record() before the commands of the passes
+	void addExternalPass(std::string name, std::vector<Access>, uint32_t queue = 0);
+	// starts a new segment with the next pass even if it's on the same queue, so that other queues can wait for the
+	// passes added so far without waiting for the ones after
+	void splitSegment() {
+		_splitSegment = true;
+	}
+
+	// computes the barriers and dependencies of the current passes, and (re)creates the transient buffers that they use.
+	// previously allocated buffers must no longer be in use
+	void compile(vk::Device, vma::Allocator&);
+	// null if no pass uses the buffer
+	[[nodiscard]] vk::Buffer getTransientBuffer(ResourceId id) const {
+		return _resources[id].transientBuffer.get();
+	}
+
+	[[nodiscard]] const std::vector<Segment> &getSegments() const {
+		return _segments;
+	}
+	// the segments that the segment needs to wait for in the given frame
+	[[nodiscard]] const std::vector<Dependency> &getDependencies(std::size_t segment, uint32_t frame) const {
+		return _segmentSyncs[frame % _period][segment].dependencies;
+	}
+	// number of frames after which the instances of all resources repeat. dependencies are at most this many frames
+	// ago
+	[[nodiscard]] uint32_t getPeriod() const {
+		return _period;
+	}
+
+	// records the passes of the segment for the given frame. for external segments, only the barriers before the
+	// external passes are recorded
+	void record(std::size_t segment, vk::CommandBuffer, uint32_t frame) const;
+private:
+	struct Resource {
+		std::string name;
+		uint32_t numInstances = 1;
+		// index of the synchronization state of the first instance, only for resources that are not transient
+		std::size_t firstState = 0;
+		// images of each instance, empty if the resource is not transferred between queue families
+		std::vector<std::vector<Image>> images;
+
+		bool transient = false;
+		vk::BufferUsageFlags transientUsage;
+		vk::DeviceSize transientSize = 0;
+		vk::UniqueBuffer transientBuffer;
+		// transient buffers that are placed in the same slot share memory and synchronization state
+		std::size_t transientSlot = 0;
+	};
+	struct Pass {
+		std::string name;
+		std::vector<Access> accesses;
+		// empty for external passes
+		RecordFunction record;
+		uint32_t queue = 0;
+		std::size_t segment = 0;
+	};
+	// an ownership transfer of the images of a resource instance
+	struct Transfer {
+		std::size_t state = 0;
+		uint32_t srcQueue = 0;
+		uint32_t dstQueue = 0;
+		// the stages and accesses on the source queue for releases, and on the destination queue for acquires
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+	};
+	// the barrier before a pass
+	struct Barrier {
+		vk::PipelineStageFlags srcStages;
+		vk::PipelineStageFlags dstStages;
+		vk::AccessFlags srcAccess;
+		vk::AccessFlags dstAccess;
+		std::vector<Transfer> acquires;
+	};
+	struct SegmentSync {
+		// recorded at the end of the segment
+		std::vector<Transfer> releases;
+		std::vector<Dependency> dependencies;
+	};
+	// the accesses on one queue since the last write that later accesses on that queue need to be synchronized with
+	struct QueueState {
+		vk::PipelineStageFlags writeStages;
+		vk::AccessFlags writeAccess;
+		vk::PipelineStageFlags readStages;
+		// reads since the last write that the write has already been made visible to
+		vk::PipelineStageFlags visibleStages;
+		vk::AccessFlags visibleAccess;
+	};
+	// where an access happened during compilation
+	struct Position {
+		uint32_t frame = 0;
+		std::size_t segment = 0;
+	};
+	struct State {
+		std::vector<QueueState> queues;
+		// the last access on each queue since the last write, including the write itself
+		std::vector<std::optional<Position>> lastAccesses;
+		std::optional<Position> lastWrite;
+		uint32_t lastWriteQueue = 0;
+		// the queue that owns the images of the resource, if there are any
+		uint32_t owner = 0;
+	};
+
+	std::vector<Resource> _resources;
+	std::vector<Pass> _passes;
+	std::vector<Segment> _segments;
+	std::vector<uint32_t> _queueFamilies;
+	bool _splitSegment = false;
+	std::size_t _numResourceStates = 0;
+	std::size_t _numTransientSlots = 0;
+	uint32_t _period = 1; // frames after which the instances of all resources repeat
+
+	// results of compile(), indexed by the frame within the period and the pass or segment
+	std::vector<std::vector<Barrier>> _barriers;
+	std::vector<std::vector<SegmentSync>> _segmentSyncs;
+	// the resource and the instance of each state, or no resource for transient slots
+	std::vector<std::pair<std::optional<ResourceId>, uint32_t>> _stateInstances;
+
+	VmaAllocation _transientMemory = nullptr;
+	vma::Allocator *_allocator = nullptr;
+
+	void _addToSegment(Pass&, bool external);
+	[[nodiscard]] std::size_t _getStateIndex(const Access&, uint32_t frame) const;
+	// updates the state of the resource for an access at the given position during compilation, and adds the
+	// synchronization it needs to the barrier. dependencies and acquires are only recorded if the segment is not null,
+	// but releases are always added to the segment they belong to
+	void _simulateAccess(const Access&, uint32_t queue, Position, std::vector<State>&, Barrier&, SegmentSync*);
+	void _allocateTransientBuffers(vk::Device, vma::Allocator&);
+	void _freeTransientBuffers();
+	void _appendTransferBarriers(std::vector<vk::ImageMemoryBarrier>&, const Transfer&, bool release) const;
+};
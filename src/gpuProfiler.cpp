@@ -0,0 +1,211 @@
+#include "gpuProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <map>
+
+#include <imgui.h>
+
+#include "misc.h"
+
+GpuProfiler GpuProfiler::create(
+	vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t numSlots
+) {
+	GpuProfiler result;
+	uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+	if (validBits == 0) {
+		std::cout << "Timestamp queries are not supported, GPU profiling is disabled\n";
+		return result;
+	}
+	result._enabled = true;
+	result._timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	result._timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+	vk::QueryPoolCreateInfo poolInfo;
+	poolInfo
+		.setQueryType(vk::QueryType::eTimestamp)
+		.setQueryCount(2 * maxSectionsPerSlot);
+	result._slots.resize(numSlots);
+	for (Slot &slot : result._slots) {
+		slot.queryPool = device.createQueryPoolUnique(poolInfo);
+	}
+	return result;
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer commandBuffer, uint32_t slotIndex) {
+	if (!_enabled) {
+		return;
+	}
+	Slot &slot = _slots[slotIndex];
+	slot.sections.clear();
+	slot.pending = false;
+	slot.ignoringSection = false;
+	commandBuffer.resetQueryPool(slot.queryPool.get(), 0, 2 * maxSectionsPerSlot);
+}
+
+void GpuProfiler::beginSection(vk::CommandBuffer commandBuffer, uint32_t slotIndex, std::string_view name) {
+	if (!_enabled) {
+		return;
+	}
+	Slot &slot = _slots[slotIndex];
+	if (slot.sections.size() >= maxSectionsPerSlot) {
+		if (!_reportedTooManySections) {
+			std::cout << "Too many profiler sections, ignoring " << name << " and all further sections\n";
+			_reportedTooManySections = true;
+		}
+		slot.ignoringSection = true;
+		return;
+	}
+	slot.sections.emplace_back(name);
+	commandBuffer.writeTimestamp(
+		vk::PipelineStageFlagBits::eTopOfPipe, slot.queryPool.get(),
+		static_cast<uint32_t>(2 * (slot.sections.size() - 1))
+	);
+}
+
+void GpuProfiler::endSection(vk::CommandBuffer commandBuffer, uint32_t slotIndex) {
+	if (!_enabled) {
+		return;
+	}
+	Slot &slot = _slots[slotIndex];
+	if (slot.ignoringSection) {
+		slot.ignoringSection = false;
+		return;
+	}
+	if (slot.sections.empty()) {
+		return;
+	}
+	commandBuffer.writeTimestamp(
+		vk::PipelineStageFlagBits::eBottomOfPipe, slot.queryPool.get(),
+		static_cast<uint32_t>(2 * slot.sections.size() - 1)
+	);
+}
+
+void GpuProfiler::collect(vk::Device device, uint32_t slotIndex) {
+	if (!_enabled) {
+		return;
+	}
+	Slot &slot = _slots[slotIndex];
+	if (!slot.pending || slot.sections.empty()) {
+		return;
+	}
+
+	// each query is followed by its availability
+	std::array<uint64_t, 4 * maxSectionsPerSlot> results;
+	auto numQueries = static_cast<uint32_t>(2 * slot.sections.size());
+	vk::Result res = device.getQueryPoolResults(
+		slot.queryPool.get(), 0, numQueries, sizeof(uint64_t) * 2 * numQueries, results.data(),
+		2 * sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability
+	);
+	if (res == vk::Result::eNotReady) {
+		return;
+	}
+	vkCheck(res);
+	for (uint32_t i = 0; i < numQueries; ++i) {
+		if (results[2 * i + 1] == 0) {
+			return;
+		}
+	}
+	slot.pending = false;
+	slot.lastResults.clear();
+
+	std::map<std::string_view, float> frameTimes;
+	for (std::size_t i = 0; i < slot.sections.size(); ++i) {
+		uint64_t ticks = (results[4 * i + 2] - results[4 * i]) & _timestampMask;
+		frameTimes[slot.sections[i]] += static_cast<float>(ticks) * _timestampPeriod * 1e-6f;
+	}
+	for (const std::string &name : slot.sections) {
+		auto it = frameTimes.find(name);
+		if (it == frameTimes.end()) {
+			continue; // already added
+		}
+		slot.lastResults.emplace_back(name, it->second);
+		Section &section = _getSection(name);
+		section.history.emplace_back(it->second);
+		while (section.history.size() > historySize) {
+			section.history.pop_front();
+		}
+		frameTimes.erase(it);
+	}
+}
+
+std::vector<GpuProfiler::Statistics> GpuProfiler::getStatistics() const {
+	std::vector<Statistics> result;
+	for (const Section &section : _sections) {
+		Statistics &stats = result.emplace_back();
+		stats.name = section.name;
+		stats.numSamples = section.history.size();
+		if (section.history.empty()) {
+			continue;
+		}
+		std::vector<float> sorted(section.history.begin(), section.history.end());
+		std::sort(sorted.begin(), sorted.end());
+		stats.min = sorted.front();
+		float sum = 0.0f;
+		for (float time : sorted) {
+			sum += time;
+		}
+		stats.average = sum / static_cast<float>(sorted.size());
+		stats.p95 = sorted[std::min(sorted.size() * 95 / 100, sorted.size() - 1)];
+	}
+	return result;
+}
+
+void GpuProfiler::exportCsv(const std::filesystem::path &path) const {
+	std::ofstream fout(path);
+	fout << "pass,min_ms,avg_ms,p95_ms,samples\n";
+	for (const Statistics &stats : getStatistics()) {
+		fout <<
+			stats.name << "," << stats.min << "," << stats.average << "," << stats.p95 << "," <<
+			stats.numSamples << "\n";
+	}
+}
+
+void GpuProfiler::drawGui() const {
+	if (!_enabled) {
+		ImGui::Text("Timestamp queries are not supported");
+		return;
+	}
+	if (ImGui::BeginTable("GPU Timings", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Pass");
+		ImGui::TableSetupColumn("Min (ms)");
+		ImGui::TableSetupColumn("Avg (ms)");
+		ImGui::TableSetupColumn("P95 (ms)");
+		ImGui::TableHeadersRow();
+
+		float totalAverage = 0.0f;
+		for (const Statistics &stats : getStatistics()) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(stats.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.min);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.average);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.p95);
+			totalAverage += stats.average;
+		}
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted("Total");
+		ImGui::TableNextColumn();
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", totalAverage);
+
+		ImGui::EndTable();
+	}
+}
+
+GpuProfiler::Section &GpuProfiler::_getSection(std::string_view name) {
+	for (Section &section : _sections) {
+		if (section.name == name) {
+			return section;
+		}
+	}
+	Section &result = _sections.emplace_back();
+	result.name = name;
+	return result;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Measures GPU time of sections of command buffers with timestamp queries. Each slot owns a query pool and corresponds
+// to a command buffer that is submitted repeatedly, e.g. one per frame in flight. The results of a slot are read back
+// right before the slot is reused, i.e. with a latency of as many frames as there are slots of that kind. Sections
+// with the same name are summed per frame, so passes that run multiple times per frame show up as one entry.
+class GpuProfiler {
+public:
+	// timings of a section over the last historySize frames, in milliseconds
+	struct Statistics {
+		std::string name;
+		float min = 0.0f;
+		float average = 0.0f;
+		float p95 = 0.0f;
+		std::size_t numSamples = 0;
+	};
+
+	constexpr static uint32_t maxSectionsPerSlot = 32;
+
+	GpuProfiler() = default;
+	GpuProfiler(GpuProfiler&&) = default;
+	GpuProfiler &operator=(GpuProfiler&&) = default;
+
+	// resets the query pool of the slot and discards results that have not been collected. must be recorded outside of
+	// render passes, before any section of the slot
+	void beginFrame(vk::CommandBuffer, uint32_t slot);
+	// sections can be recorded inside render passes, but cannot be nested
+	void beginSection(vk::CommandBuffer, uint32_t slot, std::string_view name);
+	void endSection(vk::CommandBuffer, uint32_t slot);
+	// marks that the command buffer containing the sections of this slot has been submitted
+	void onSubmitted(uint32_t slot) {
+		if (_enabled) {
+			_slots[slot].pending = true;
+		}
+	}
+	// reads back the results of the last submission of the slot if they are available
+	void collect(vk::Device, uint32_t slot);
+	// times of the sections of the last collected submission of the slot in milliseconds, in the order they were
+	// first recorded
+	[[nodiscard]] const std::vector<std::pair<std::string, float>> &getLastResults(uint32_t slot) const {
+		return _slots[slot].lastResults;
+	}
+
+	[[nodiscard]] std::vector<Statistics> getStatistics() const;
+	// writes the statistics of all sections as a table to the given file
+	void exportCsv(const std::filesystem::path&) const;
+	// draws a table of all statistics
+	void drawGui() const;
+
+	[[nodiscard]] bool isEnabled() const {
+		return _enabled;
+	}
+
+	std::size_t historySize = 240;
+
+	// timestamps are only supported if timestampValidBits of the queue family is non-zero; the profiler does nothing
+	// otherwise
+	[[nodiscard]] static GpuProfiler create(
+		vk::Device, vk::PhysicalDevice, uint32_t queueFamilyIndex, uint32_t numSlots
+	);
+private:
+	struct Slot {
+		vk::UniqueQueryPool queryPool;
+		// names of the sections recorded into the command buffer, in order
+		std::vector<std::string> sections;
+		std::vector<std::pair<std::string, float>> lastResults;
+		bool pending = false;
+		// whether the open section was ignored by beginSection(), in which case endSection() does nothing
+		bool ignoringSection = false;
+	};
+	struct Section {
+		std::string name;
+		std::deque<float> history;
+	};
+
+	std::vector<Slot> _slots;
+	// in the order that the sections are first seen
+	std::vector<Section> _sections;
+	float _timestampPeriod = 1.0f; // nanoseconds per tick
+	uint64_t _timestampMask = 0;
+	bool _enabled = false;
+	bool _reportedTooManySections = false;
+
+	[[nodiscard]] Section &_getSection(std::string_view);
+};
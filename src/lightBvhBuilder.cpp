@@ -0,0 +1,247 @@
+#include "lightBvhBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+#include <nvmath.h>
+
+// orientation cone of a set of lights. since all lights are two-sided, any cone with a normal bound of at least pi / 2
+// covers all directions and is stored with a normal bound of pi
+struct LightCone {
+	nvmath::vec3f axis{ 0.0f, 0.0f, 1.0f };
+	float theta = nv_pi;
+
+	// orientation measure from "Importance Sampling of Many Lights with Adaptive Tree Splitting", with the emission
+	// bound fixed to pi / 2
+	float measure() const {
+		float w = std::min(theta + 0.5f * nv_pi, nv_pi);
+		float sinTheta = std::sin(theta), cosTheta = std::cos(theta);
+		return
+			2.0f * nv_pi * (1.0f - cosTheta) +
+			0.5f * nv_pi * (2.0f * w * sinTheta - std::cos(theta - 2.0f * w) - 2.0f * theta * sinTheta + cosTheta);
+	}
+
+	static LightCone merge(LightCone lhs, LightCone rhs) {
+		if (rhs.theta > lhs.theta) {
+			std::swap(lhs, rhs);
+		}
+		if (lhs.theta >= nv_pi) {
+			return lhs;
+		}
+		// the lights are two-sided, so the axes can be flipped freely
+		if (nvmath::dot(lhs.axis, rhs.axis) < 0.0f) {
+			rhs.axis = -rhs.axis;
+		}
+		float thetaD = std::acos(std::clamp(nvmath::dot(lhs.axis, rhs.axis), -1.0f, 1.0f));
+		if (thetaD + rhs.theta <= lhs.theta) {
+			return lhs;
+		}
+		LightCone result;
+		result.theta = 0.5f * (lhs.theta + thetaD + rhs.theta);
+		if (result.theta >= 0.5f * nv_pi) {
+			result.theta = nv_pi;
+			return result;
+		}
+		// rotate lhs.axis towards rhs.axis
+		float thetaR = result.theta - lhs.theta;
+		result.axis = nvmath::normalize(
+			std::sin(thetaD - thetaR) * lhs.axis + std::sin(thetaR) * rhs.axis
+		);
+		return result;
+	}
+};
+
+struct LightBuildStep {
+	LightBuildStep() = default;
+	LightBuildStep(int32_t *parent, std::size_t beg, std::size_t end) : parentPtr(parent), rangeBeg(beg), rangeEnd(end) {
+	}
+
+	int32_t *parentPtr;
+	std::size_t rangeBeg, rangeEnd;
+};
+struct LightLeaf {
+	nvmath::vec3f centroid, aabbMin, aabbMax;
+	LightCone cone;
+	float power;
+	int32_t lightIndex;
+	std::size_t bucket;
+};
+struct LightBucket {
+	nvmath::vec3f
+		aabbMin{ std::numeric_limits<float>::max() },
+		aabbMax{ -std::numeric_limits<float>::max() };
+	LightCone cone;
+	float power = 0.0f;
+	std::size_t count = 0;
+
+	void add(const LightLeaf &leaf) {
+		aabbMin = nvmath::nv_min(aabbMin, leaf.aabbMin);
+		aabbMax = nvmath::nv_max(aabbMax, leaf.aabbMax);
+		cone = count == 0 ? leaf.cone : LightCone::merge(cone, leaf.cone);
+		power += leaf.power;
+		++count;
+	}
+
+	// surface area orientation heuristic
+	float heuristic() const {
+		if (count == 0) {
+			return 0.0f;
+		}
+		nvmath::vec3f size = aabbMax - aabbMin;
+		float surfaceArea = size.x * size.y + size.x * size.z + size.y * size.z;
+		// prevents degenerate boxes (e.g. a single point light) from having zero cost
+		float diagonal = nvmath::length(size);
+		return power * (surfaceArea + diagonal * diagonal + 1e-6f) * cone.measure();
+	}
+
+	static LightBucket merge(LightBucket lhs, const LightBucket &rhs) {
+		if (rhs.count == 0) {
+			return lhs;
+		}
+		if (lhs.count == 0) {
+			return rhs;
+		}
+		lhs.aabbMin = nvmath::nv_min(lhs.aabbMin, rhs.aabbMin);
+		lhs.aabbMax = nvmath::nv_max(lhs.aabbMax, rhs.aabbMax);
+		lhs.cone = LightCone::merge(lhs.cone, rhs.cone);
+		lhs.power += rhs.power;
+		lhs.count += rhs.count;
+		return lhs;
+	}
+};
+
+LightBvh LightBvh::build(
+	const std::vector<shader::pointLight> &pointLights, const std::vector<shader::triLight> &triangleLights
+) {
+	constexpr std::size_t numBuckets = 12;
+
+	LightBvh result;
+
+	// collect leaves
+	std::vector<LightLeaf> leaves;
+	leaves.reserve(pointLights.size() + triangleLights.size());
+	for (const shader::pointLight &light : pointLights) {
+		LightLeaf &cur = leaves.emplace_back();
+		cur.centroid = cur.aabbMin = cur.aabbMax = nvmath::vec3f(light.pos);
+		cur.power = light.color_luminance.w;
+		cur.lightIndex = static_cast<int32_t>(leaves.size() - 1);
+	}
+	for (const shader::triLight &light : triangleLights) {
+		LightLeaf &cur = leaves.emplace_back();
+		cur.aabbMin = cur.aabbMax = nvmath::vec3f(light.p1);
+		cur.aabbMin = nvmath::nv_min(cur.aabbMin, nvmath::vec3f(light.p2));
+		cur.aabbMax = nvmath::nv_max(cur.aabbMax, nvmath::vec3f(light.p2));
+		cur.aabbMin = nvmath::nv_min(cur.aabbMin, nvmath::vec3f(light.p3));
+		cur.aabbMax = nvmath::nv_max(cur.aabbMax, nvmath::vec3f(light.p3));
+		cur.centroid = 0.5f * (cur.aabbMin + cur.aabbMax);
+		cur.cone.axis = nvmath::vec3f(light.normalArea);
+		cur.cone.theta = 0.0f;
+		cur.power = light.emission_luminance.w * light.normalArea.w;
+		cur.lightIndex = static_cast<int32_t>(leaves.size() - 1);
+	}
+	if (leaves.empty()) {
+		// a single leaf without power, so that the root that the shaders start traversal from is always valid
+		shader::LightBvhNode &root = result.nodes.emplace_back();
+		root.aabbMin_power = nvmath::vec4f(0.0f);
+		root.aabbMax_cosTheta = nvmath::vec4f(0.0f, 0.0f, 0.0f, -1.0f);
+		root.axis = nvmath::vec4f(0.0f, 0.0f, 1.0f, 0.0f);
+		root.leftChild = ~0;
+		root.rightChild = -1;
+		return result;
+	}
+
+	// leaves are stored as nodes as well, so the node pointers below are never invalidated
+	result.nodes.resize(2 * leaves.size() - 1);
+	int32_t alloc = 0;
+	std::deque<LightBuildStep> q;
+	int32_t dummyRoot = -1;
+	q.emplace_back(&dummyRoot, 0, leaves.size());
+	while (!q.empty()) {
+		LightBuildStep step = q.front();
+		q.pop_front();
+
+		// compute node bounds
+		LightBucket total;
+		nvmath::vec3f centroidMin = leaves[step.rangeBeg].centroid;
+		nvmath::vec3f centroidMax = centroidMin;
+		for (std::size_t i = step.rangeBeg; i < step.rangeEnd; ++i) {
+			total.add(leaves[i]);
+			centroidMin = nvmath::nv_min(centroidMin, leaves[i].centroid);
+			centroidMax = nvmath::nv_max(centroidMax, leaves[i].centroid);
+		}
+
+		int32_t nodeIndex = alloc++;
+		*step.parentPtr = nodeIndex;
+		shader::LightBvhNode &node = result.nodes[nodeIndex];
+		node.aabbMin_power = nvmath::vec4(total.aabbMin, total.power);
+		node.aabbMax_cosTheta = nvmath::vec4(total.aabbMax, std::cos(total.cone.theta));
+		node.axis = nvmath::vec4(total.cone.axis, 0.0f);
+
+		if (step.rangeEnd - step.rangeBeg == 1) {
+			node.leftChild = ~leaves[step.rangeBeg].lightIndex;
+			node.rightChild = -1;
+			continue;
+		}
+
+		// find split direction
+		nvmath::vec3f centroidSpan = centroidMax - centroidMin;
+		int splitDim = centroidSpan.x > centroidSpan.y ? 0 : 1;
+		if (centroidSpan.z > centroidSpan[splitDim]) {
+			splitDim = 2;
+		}
+
+		std::size_t pivot = step.rangeBeg;
+		if (centroidSpan[splitDim] > 0.0f) {
+			// bucket lights
+			LightBucket buckets[numBuckets];
+			float bucketRange = centroidSpan[splitDim] / numBuckets;
+			for (std::size_t i = step.rangeBeg; i < step.rangeEnd; ++i) {
+				leaves[i].bucket = static_cast<std::size_t>(nvmath::nv_clamp(
+					(leaves[i].centroid[splitDim] - centroidMin[splitDim]) / bucketRange, 0.5f, numBuckets - 0.5f
+				));
+				buckets[leaves[i].bucket].add(leaves[i]);
+			}
+			// find optimal split point
+			LightBucket boundCache[numBuckets - 1];
+			{
+				LightBucket current = buckets[numBuckets - 1];
+				for (std::size_t i = numBuckets - 1; i > 0; ) {
+					boundCache[--i] = current;
+					current = LightBucket::merge(current, buckets[i]);
+				}
+			}
+			std::size_t optSplitPoint = 0;
+			{
+				float minHeuristic = std::numeric_limits<float>::max();
+				LightBucket sumLeft;
+				for (std::size_t splitPoint = 0; splitPoint < numBuckets - 1; ++splitPoint) {
+					sumLeft = LightBucket::merge(sumLeft, buckets[splitPoint]);
+					float heuristic = sumLeft.heuristic() + boundCache[splitPoint].heuristic();
+					if (heuristic < minHeuristic) {
+						minHeuristic = heuristic;
+						optSplitPoint = splitPoint;
+					}
+				}
+			}
+			// split
+			for (std::size_t i = step.rangeBeg; i < step.rangeEnd; ++i) {
+				if (leaves[i].bucket <= optSplitPoint) {
+					std::swap(leaves[i], leaves[pivot++]);
+				}
+			}
+		}
+		// handle lights with overlapping centroids
+		if (pivot == step.rangeBeg || pivot == step.rangeEnd) {
+			pivot = (step.rangeBeg + step.rangeEnd) / 2;
+		}
+
+		q.emplace_back(&node.leftChild, step.rangeBeg, pivot);
+		q.emplace_back(&node.rightChild, pivot, step.rangeEnd);
+	}
+
+	assert(dummyRoot == 0);
+	return result;
+}
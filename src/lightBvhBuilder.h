@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "shaderIncludes.h"
+#include "vma.h"
+
+struct LightBvh {
+	std::vector<shader::LightBvhNode> nodes;
+
+	// lights are indexed in the same way as in createAliasTable(): all point lights followed by all triangle lights.
+	// the result always contains at least the root, which has zero power if there are no lights
+	[[nodiscard]] static LightBvh build(
+		const std::vector<shader::pointLight>&, const std::vector<shader::triLight>&
+	);
+};
+
+struct LightBvhBuffers {
+	vma::UniqueBuffer nodeBuffer;
+	vk::DeviceSize nodeBufferSize;
+
+	[[nodiscard]] static LightBvhBuffers create(const LightBvh &bvh, vma::Allocator &allocator) {
+		assert(!bvh.nodes.empty());
+		LightBvhBuffers result;
+		result.nodeBufferSize = sizeof(shader::LightBvhNode) * bvh.nodes.size();
+		result.nodeBuffer = allocator.createBuffer(
+			static_cast<uint32_t>(result.nodeBufferSize),
+			vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+		);
+
+		auto *ptr = result.nodeBuffer.mapAs<shader::LightBvhNode>();
+		std::memcpy(ptr, bvh.nodes.data(), sizeof(shader::LightBvhNode) * bvh.nodes.size());
+		result.nodeBuffer.unmap();
+		result.nodeBuffer.flush();
+
+		return result;
+	}
+};
@@ -0,0 +1,229 @@
+#include "lightGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include <nvmath.h>
+
+#include "misc.h"
+
+constexpr std::size_t lightsPerChunk = 1 << 16;
+
+using LightRandomEngine = std::mt19937;
+
+std::optional<LightDistribution> parseLightDistribution(std::string_view name) {
+	if (name == "uniform") {
+		return LightDistribution::uniform;
+	}
+	if (name == "clustered") {
+		return LightDistribution::clustered;
+	}
+	if (name == "surface") {
+		return LightDistribution::surface;
+	}
+	return std::nullopt;
+}
+
+[[nodiscard]] LightRandomEngine createRandomEngine(uint64_t seed, uint64_t stream, uint64_t chunk) {
+	std::seed_seq seq{
+		static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+		static_cast<uint32_t>(stream),
+		static_cast<uint32_t>(chunk), static_cast<uint32_t>(chunk >> 32)
+	};
+	return LightRandomEngine(seq);
+}
+
+// calls func(begin, end, rand) for every chunk of [0, count) on all hardware threads
+template <typename Func> void generateInChunks(std::size_t count, uint64_t seed, uint64_t stream, Func &&func) {
+	std::size_t numChunks = ceilDiv(count, lightsPerChunk);
+	std::atomic<std::size_t> nextChunk = 0;
+	auto worker = [&]() {
+		for (std::size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+			LightRandomEngine rand = createRandomEngine(seed, stream, chunk);
+			func(chunk * lightsPerChunk, std::min(count, (chunk + 1) * lightsPerChunk), rand);
+		}
+	};
+
+	std::size_t numThreads = std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), numChunks);
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < numThreads; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread &t : threads) {
+		t.join();
+	}
+}
+
+class LightPositionSampler {
+public:
+	LightPositionSampler(const LightGeneratorSettings &settings, const nvh::GltfScene &scene) :
+		_distribution(settings.distribution), _min(scene.m_dimensions.min), _max(scene.m_dimensions.max) {
+
+		_scale = nvmath::length(_max - _min);
+		_clusterRadius = settings.clusterRadius * _scale;
+
+		if (_distribution == LightDistribution::clustered) {
+			LightRandomEngine rand = createRandomEngine(settings.seed, 0, 0);
+			_clusterCenters.resize(std::max<std::size_t>(settings.numClusters, 1));
+			for (nvmath::vec3f &center : _clusterCenters) {
+				center = _uniform(rand);
+			}
+		} else if (_distribution == LightDistribution::surface) {
+			double totalArea = 0.0;
+			for (const nvh::GltfNode &node : scene.m_nodes) {
+				const nvh::GltfPrimMesh &mesh = scene.m_primMeshes[node.primMesh];
+				const uint32_t *indices = scene.m_indices.data() + mesh.firstIndex;
+				const nvmath::vec3 *pos = scene.m_positions.data() + mesh.vertexOffset;
+				for (uint32_t i = 0; i < mesh.indexCount; i += 3, indices += 3) {
+					shader::Triangle &tri = _triangles.emplace_back();
+					tri.p1 = node.worldMatrix * nvmath::vec4(pos[indices[0]], 1.0f);
+					tri.p2 = node.worldMatrix * nvmath::vec4(pos[indices[1]], 1.0f);
+					tri.p3 = node.worldMatrix * nvmath::vec4(pos[indices[2]], 1.0f);
+					nvmath::vec3f p1(tri.p1), p2(tri.p2), p3(tri.p3);
+					totalArea += 0.5 * nvmath::length(nvmath::cross(p2 - p1, p3 - p1));
+					_cumulativeArea.emplace_back(totalArea);
+				}
+			}
+			if (_triangles.empty() || totalArea <= 0.0) {
+				std::cout << "Scene has no surfaces, placing lights uniformly\n";
+				_distribution = LightDistribution::uniform;
+			}
+		}
+	}
+
+	// normal is zero when the position is not on a surface
+	void sample(LightRandomEngine &rand, nvmath::vec3f &position, nvmath::vec3f &normal) const {
+		normal = nvmath::vec3f(0.0f);
+		switch (_distribution) {
+		case LightDistribution::uniform:
+			position = _uniform(rand);
+			break;
+		case LightDistribution::clustered:
+			{
+				std::uniform_int_distribution<std::size_t> clusterDist(0, _clusterCenters.size() - 1);
+				std::normal_distribution<float> offsetDist(0.0f, _clusterRadius);
+				position = _clusterCenters[clusterDist(rand)];
+				position.x += offsetDist(rand);
+				position.y += offsetDist(rand);
+				position.z += offsetDist(rand);
+			}
+			break;
+		case LightDistribution::surface:
+			{
+				std::uniform_real_distribution<double> areaDist(0.0, _cumulativeArea.back());
+				auto it = std::upper_bound(_cumulativeArea.begin(), _cumulativeArea.end(), areaDist(rand));
+				const shader::Triangle &tri = _triangles[std::min<std::size_t>(
+					it - _cumulativeArea.begin(), _triangles.size() - 1
+				)];
+				nvmath::vec3f p1(tri.p1), p2(tri.p2), p3(tri.p3);
+
+				std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+				float sqrtR1 = std::sqrt(dist(rand)), r2 = dist(rand);
+				normal = nvmath::cross(p2 - p1, p3 - p1);
+				float normalLength = nvmath::length(normal);
+				normal = normalLength > 0.0f ? normal / normalLength : nvmath::vec3f(0.0f, 0.0f, 1.0f);
+				// lift the light off the surface slightly
+				position =
+					(1.0f - sqrtR1) * p1 + (sqrtR1 * (1.0f - r2)) * p2 + (sqrtR1 * r2) * p3 +
+					(1e-3f * _scale) * normal;
+			}
+			break;
+		}
+	}
+
+	[[nodiscard]] float getScale() const {
+		return _scale;
+	}
+private:
+	std::vector<shader::Triangle> _triangles;
+	std::vector<double> _cumulativeArea;
+	std::vector<nvmath::vec3f> _clusterCenters;
+	LightDistribution _distribution;
+	nvmath::vec3f _min, _max;
+	float _scale;
+	float _clusterRadius;
+
+	[[nodiscard]] nvmath::vec3f _uniform(LightRandomEngine &rand) const {
+		std::uniform_real_distribution<float> distX(_min.x, _max.x);
+		std::uniform_real_distribution<float> distY(_min.y, _max.y);
+		std::uniform_real_distribution<float> distZ(_min.z, _max.z);
+		float x = distX(rand), y = distY(rand);
+		return nvmath::vec3f(x, y, distZ(rand));
+	}
+};
+
+[[nodiscard]] nvmath::vec3f randomColor(LightRandomEngine &rand, float intensity) {
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	float r = dist(rand), g = dist(rand);
+	return intensity * nvmath::vec3f(r, g, dist(rand));
+}
+
+std::vector<shader::pointLight> generatePointLights(const LightGeneratorSettings &settings, const nvh::GltfScene &scene) {
+	// building the sampler is not free for surface distributions
+	if (settings.numPointLights == 0) {
+		return {};
+	}
+	LightPositionSampler sampler(settings, scene);
+	std::vector<shader::pointLight> result(settings.numPointLights);
+	generateInChunks(settings.numPointLights, settings.seed, 1, [&](std::size_t beg, std::size_t end, LightRandomEngine &rand) {
+		for (std::size_t i = beg; i < end; ++i) {
+			nvmath::vec3f position, normal;
+			sampler.sample(rand, position, normal);
+			nvmath::vec3f color = randomColor(rand, settings.intensity);
+			result[i].pos = nvmath::vec4(position, 1.0f);
+			result[i].color_luminance = nvmath::vec4(color, shader::luminance(color.x, color.y, color.z));
+		}
+	});
+	return result;
+}
+
+std::vector<shader::triLight> generateTriangleLights(const LightGeneratorSettings &settings, const nvh::GltfScene &scene) {
+	if (settings.numTriangleLights == 0) {
+		return {};
+	}
+	LightPositionSampler sampler(settings, scene);
+	float size = settings.triangleSize * sampler.getScale();
+	std::vector<shader::triLight> result(settings.numTriangleLights);
+	generateInChunks(settings.numTriangleLights, settings.seed, 2, [&](std::size_t beg, std::size_t end, LightRandomEngine &rand) {
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		std::normal_distribution<float> normalDist;
+		for (std::size_t i = beg; i < end; ++i) {
+			nvmath::vec3f center, normal;
+			sampler.sample(rand, center, normal);
+			if (normal == nvmath::vec3f(0.0f)) {
+				do {
+					float x = normalDist(rand), y = normalDist(rand);
+					normal = nvmath::vec3f(x, y, normalDist(rand));
+				} while (nvmath::dot(normal, normal) < 1e-6f);
+				normal = nvmath::normalize(normal);
+			}
+			nvmath::vec3f tangent = nvmath::normalize(nvmath::cross(
+				normal, std::abs(normal.x) > 0.9f ? nvmath::vec3f(0.0f, 1.0f, 0.0f) : nvmath::vec3f(1.0f, 0.0f, 0.0f)
+			));
+			nvmath::vec3f bitangent = nvmath::cross(normal, tangent);
+
+			// three vertices roughly evenly spread around the center
+			nvmath::vec3f vertices[3];
+			float phase = dist(rand) * 2.0f * nv_pi;
+			for (int j = 0; j < 3; ++j) {
+				float angle = phase + j * (2.0f / 3.0f) * nv_pi;
+				float radius = size * (0.5f + 0.5f * dist(rand));
+				vertices[j] = center + radius * (std::cos(angle) * tangent + std::sin(angle) * bitangent);
+			}
+			nvmath::vec3f emission = randomColor(rand, settings.intensity);
+			float area = 0.5f * nvmath::length(nvmath::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]));
+
+			result[i] = shader::triLight{
+				.p1 = nvmath::vec4(vertices[0], 1.0f),
+				.p2 = nvmath::vec4(vertices[1], 1.0f),
+				.p3 = nvmath::vec4(vertices[2], 1.0f),
+				.emission_luminance = nvmath::vec4(emission, shader::luminance(emission.x, emission.y, emission.z)),
+				.normalArea = nvmath::vec4(normal, area)
+			};
+		}
+	});
+	return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <gltfscene.h>
+
+#include "shaderIncludes.h"
+
+enum class LightDistribution {
+	uniform, // uniformly inside the scene's bounding box
+	clustered, // gaussian clusters around random centers inside the scene's bounding box
+	surface // on the surfaces of the scene, proportional to area
+};
+
+[[nodiscard]] std::optional<LightDistribution> parseLightDistribution(std::string_view);
+
+// Settings for procedurally generated lights. All lengths are relative to the diagonal of the scene's bounding box.
+// Lights are generated in fixed-size chunks, each with its own random number stream, so the result only depends on
+// the settings and not on the number of threads.
+struct LightGeneratorSettings {
+	std::size_t numPointLights = 0;
+	std::size_t numTriangleLights = 0;
+	uint64_t seed = 0;
+	LightDistribution distribution = LightDistribution::uniform;
+
+	std::size_t numClusters = 16;
+	float clusterRadius = 0.05f;
+	float triangleSize = 0.01f;
+	float intensity = 1.0f;
+};
+
+[[nodiscard]] std::vector<shader::pointLight> generatePointLights(const LightGeneratorSettings&, const nvh::GltfScene&);
+// Generates a soup of emissive triangles. These triangles are not part of the scene geometry, so they do not cast
+// shadows and are not visible in the G-buffer.
+[[nodiscard]] std::vector<shader::triLight> generateTriangleLights(const LightGeneratorSettings&, const nvh::GltfScene&);
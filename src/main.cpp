@@ -13,16 +13,143 @@
 #include <stb_image_write.h>
 #undef STB_IMAGE_WRITE_IMPLEMENTATION
 
+#include <sstream>
+
 #include <gflags/gflags.h>
 
 #include "app.h"
+#include "benchmark.h"
 
 DEFINE_string(scene, "", "Path to the scene file.");
 DEFINE_bool(ignore_point_lights, false, "Ignore point lights in the scene.");
 
+DEFINE_uint64(generated_point_lights, 0, "Number of point lights to generate in addition to the ones in the scene.");
+DEFINE_uint64(generated_triangle_lights, 0, "Number of emissive triangles to generate in addition to the ones in the scene.");
+DEFINE_uint64(light_seed, 0, "Seed used when generating lights.");
+DEFINE_string(light_distribution, "uniform", "Distribution of generated lights: uniform, clustered, or surface.");
+DEFINE_uint64(light_clusters, 16, "Number of clusters when using the clustered light distribution.");
+DEFINE_double(light_cluster_radius, 0.05, "Standard deviation of light clusters, relative to the scene size.");
+DEFINE_double(light_triangle_size, 0.01, "Size of generated triangle lights, relative to the scene size.");
+DEFINE_double(light_intensity, 1.0, "Maximum intensity of each channel of generated lights.");
+
+DEFINE_bool(compact_gbuffer, false, "Use the compact G-buffer layout that reconstructs positions from depth.");
+DEFINE_bool(visibility_buffer, false, "Rasterize a visibility buffer and evaluate materials once per pixel.");
+DEFINE_bool(bindless_materials, false, "Bind all materials and textures once instead of for each node.");
+DEFINE_bool(gpu_culling, false, "Cull nodes against the view frustum in a compute pass. Requires bindless materials.");
+DEFINE_bool(validate_gpu_culling, false, "In headless mode, compare the draws made by GPU culling in the last frame with the CPU reference.");
+DEFINE_bool(async_compute, false, "Run the ReSTIR passes on a dedicated compute queue if the device has one.");
+
+DEFINE_bool(headless, false, "Render offscreen without a window. Accepts CPU implementations of Vulkan.");
+DEFINE_uint32(width, 1280, "Width of the offscreen image in headless mode.");
+DEFINE_uint32(height, 720, "Height of the offscreen image in headless mode.");
+DEFINE_uint32(frames, 1, "Number of frames to render in headless mode. The last frame is written to --output.");
+DEFINE_string(output, "output.png", "Path of the PNG file written in headless mode.");
+DEFINE_string(camera_position, "", "Initial camera position, formatted as x,y,z.");
+DEFINE_string(camera_look_at, "", "Initial point that the camera looks at, formatted as x,y,z.");
+DEFINE_double(camera_fov, 0.0, "Initial vertical field of view of the camera in degrees. 0 keeps the default.");
+
+DEFINE_string(benchmark_camera_path, "", "Replay this JSON or CSV camera path headlessly and report frame timings.");
+DEFINE_uint32(benchmark_warmup_frames, 60, "Number of frames rendered before measuring.");
+DEFINE_uint32(benchmark_frames, 0, "Number of measured frames. 0 renders each keyframe of the camera path once.");
+DEFINE_uint32(benchmark_seed, 0, "Initial frame index, which seeds all random number generators.");
+DEFINE_string(benchmark_report, "benchmark.json", "Path of the JSON benchmark report.");
+
+[[nodiscard]] std::optional<nvmath::vec3f> parseVec3(const std::string &str) {
+	std::istringstream ss(str);
+	nvmath::vec3f result;
+	char comma1 = 0, comma2 = 0;
+	ss >> result.x >> comma1 >> result.y >> comma2 >> result.z;
+	if (!ss || comma1 != ',' || comma2 != ',') {
+		return std::nullopt;
+	}
+	return result;
+}
+
 int main(int argc, char **argv) {
 	gflags::ParseCommandLineFlags(&argc, &argv, true);
-	App app(FLAGS_scene, FLAGS_ignore_point_lights);
-	app.mainLoop();
+
+	LightGeneratorSettings lightSettings;
+	if (auto distribution = parseLightDistribution(FLAGS_light_distribution)) {
+		lightSettings.distribution = distribution.value();
+	} else {
+		std::cerr << "Invalid light distribution: " << FLAGS_light_distribution << "\n";
+		return 1;
+	}
+	lightSettings.numPointLights = FLAGS_generated_point_lights;
+	lightSettings.numTriangleLights = FLAGS_generated_triangle_lights;
+	lightSettings.seed = FLAGS_light_seed;
+	lightSettings.numClusters = FLAGS_light_clusters;
+	lightSettings.clusterRadius = static_cast<float>(FLAGS_light_cluster_radius);
+	lightSettings.triangleSize = static_cast<float>(FLAGS_light_triangle_size);
+	lightSettings.intensity = static_cast<float>(FLAGS_light_intensity);
+
+	std::optional<std::vector<CameraKeyframe>> cameraPath;
+	if (!FLAGS_benchmark_camera_path.empty()) {
+		cameraPath = loadCameraPath(FLAGS_benchmark_camera_path);
+		if (!cameraPath) {
+			return 1;
+		}
+		// benchmarks are not affected by presentation
+		FLAGS_headless = true;
+	}
+
+	std::optional<vk::Extent2D> headlessExtent;
+	if (FLAGS_headless) {
+		if (FLAGS_width == 0 || FLAGS_height == 0) {
+			std::cerr << "Invalid resolution: " << FLAGS_width << " x " << FLAGS_height << "\n";
+			return 1;
+		}
+		headlessExtent = vk::Extent2D(FLAGS_width, FLAGS_height);
+	}
+
+	App app(
+		FLAGS_scene, FLAGS_ignore_point_lights, lightSettings, FLAGS_compact_gbuffer, FLAGS_visibility_buffer,
+		FLAGS_bindless_materials, FLAGS_gpu_culling, FLAGS_async_compute, headlessExtent
+	);
+
+	Camera &camera = app.getCamera();
+	if (!FLAGS_camera_position.empty()) {
+		if (auto position = parseVec3(FLAGS_camera_position)) {
+			camera.position = position.value();
+		} else {
+			std::cerr << "Invalid camera position: " << FLAGS_camera_position << "\n";
+			return 1;
+		}
+	}
+	if (!FLAGS_camera_look_at.empty()) {
+		if (auto lookAt = parseVec3(FLAGS_camera_look_at)) {
+			camera.lookAt = lookAt.value();
+		} else {
+			std::cerr << "Invalid camera target: " << FLAGS_camera_look_at << "\n";
+			return 1;
+		}
+	}
+	if (FLAGS_camera_fov > 0.0) {
+		camera.fovYRadians = static_cast<float>(FLAGS_camera_fov) * nv_pi / 180.0f;
+	}
+	app.onCameraChanged();
+
+	if (cameraPath) {
+		BenchmarkSettings settings;
+		settings.warmupFrames = FLAGS_benchmark_warmup_frames;
+		settings.measuredFrames = FLAGS_benchmark_frames;
+		settings.seed = FLAGS_benchmark_seed;
+		settings.reportPath = FLAGS_benchmark_report;
+		if (!runBenchmark(app, cameraPath.value(), settings)) {
+			return 1;
+		}
+	} else if (FLAGS_headless) {
+		for (uint32_t i = 0; i < FLAGS_frames; ++i) {
+			app.renderOffscreenFrame();
+		}
+		if (FLAGS_frames > 0 && !app.saveOffscreenImage(FLAGS_output)) {
+			return 1;
+		}
+		if (FLAGS_frames > 0 && FLAGS_validate_gpu_culling && !app.validateGpuCulling()) {
+			return 1;
+		}
+	} else {
+		app.mainLoop();
+	}
 	return 0;
 }
@@ -1,10 +1,12 @@
 #include "misc.h"
 
+#include <atomic>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <random>
 #include <queue>
+#include <thread>
 
 #include "vma.h"
 
@@ -18,6 +20,36 @@ std::vector<char> readFile(const std::filesystem::path &path) {
 	return result;
 }
 
+// threads started by runInParallel() that have not finished yet, shared by nested calls
+static std::atomic<std::size_t> numRunningWorkers = 0;
+
+void runInParallel(const std::vector<std::function<void()>> &tasks) {
+	std::atomic<std::size_t> nextTask = 0;
+	auto worker = [&]() {
+		for (std::size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+			tasks[i]();
+		}
+	};
+	// the calling thread always takes part, so nested calls make progress even if no more threads can be started
+	std::size_t maxWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+	std::size_t wantedWorkers = tasks.empty() ? 0 : tasks.size() - 1;
+	std::size_t numWorkers = 0;
+	std::size_t running = numRunningWorkers.load();
+	do {
+		numWorkers = std::min(wantedWorkers, running < maxWorkers ? maxWorkers - running : 0);
+	} while (!numRunningWorkers.compare_exchange_weak(running, running + numWorkers));
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < numWorkers; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread &t : threads) {
+		t.join();
+	}
+	numRunningWorkers -= numWorkers;
+}
+
 void vkCheck(vk::Result res) {
 	if (static_cast<int>(res) < 0) {
 		std::cout << "Vulkan error: " << vk::to_string(res) << "\n";
@@ -355,28 +387,6 @@ std::vector<shader::pointLight> collectPointLightsFromScene(const nvh::GltfScene
 	return result;
 }
 
-std::vector<shader::pointLight> generateRandomPointLights(
-	std::size_t count, nvmath::vec3 min, nvmath::vec3 max,
-	std::uniform_real_distribution<float> distR,
-	std::uniform_real_distribution<float> distG,
-	std::uniform_real_distribution<float> distB
-) {
-	std::uniform_real_distribution<float> distX(min.x, max.x);
-	std::uniform_real_distribution<float> distY(min.y, max.y);
-	std::uniform_real_distribution<float> distZ(min.z, max.z);
-	std::default_random_engine rand;
-
-	std::vector<shader::pointLight> result(count);
-	for (shader::pointLight &light : result) {
-		light.pos = nvmath::vec4(distX(rand), distY(rand), distZ(rand), 1.0f);
-		light.color_luminance = nvmath::vec4(distR(rand), distG(rand), distB(rand), 0.0f);
-		light.color_luminance.w = shader::luminance(
-			light.color_luminance.x, light.color_luminance.y, light.color_luminance.z
-		);
-	}
-	return result;
-}
-
 std::vector<shader::triLight> collectTriangleLightsFromScene(const nvh::GltfScene &scene) {
 	std::vector<shader::triLight> result;
 	for (const nvh::GltfNode &node : scene.m_nodes) {
@@ -420,25 +430,21 @@ std::vector<shader::triLight> collectTriangleLightsFromScene(const nvh::GltfScen
 	std::queue<int> smallerThanOneQueue;
 	std::vector<float> lightProbVec;
 	float powerSum = 0.f;
-	std::size_t lightNum = 0;
 
 	// Init samplers' probability
-	if (!ptLights.empty()) {
-		lightNum = ptLights.size();
-
-		for (auto& itr_ptLight : ptLights) {
-			powerSum += itr_ptLight.color_luminance.w;
-			lightProbVec.push_back(itr_ptLight.color_luminance.w);
-		}	
+	// point lights and triangle lights share a single distribution: columns [0, ptLights.size()) refer to point
+	// lights, and the rest refer to triangle lights
+	std::size_t lightNum = ptLights.size() + triLights.size();
+	lightProbVec.reserve(lightNum);
+
+	for (auto& itr_ptLight : ptLights) {
+		powerSum += itr_ptLight.color_luminance.w;
+		lightProbVec.push_back(itr_ptLight.color_luminance.w);
 	}
-	else {
-		lightNum = triLights.size();
-
-		for (auto& itr_triLight : triLights) {
-			float triLightPower = itr_triLight.emission_luminance.w * itr_triLight.normalArea.w;
-			powerSum += triLightPower;
-			lightProbVec.push_back(triLightPower);
-		}
+	for (auto& itr_triLight : triLights) {
+		float triLightPower = itr_triLight.emission_luminance.w * itr_triLight.normalArea.w;
+		powerSum += triLightPower;
+		lightProbVec.push_back(triLightPower);
 	}
 
 	std::vector<shader::aliasTableColumn> result(lightNum, shader::aliasTableColumn{ .prob = 0.f, .alias = -1, .oriProb = 0.f });
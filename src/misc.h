@@ -3,6 +3,7 @@
 #include <unordered_set>
 #include <vector>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <random>
@@ -31,6 +32,10 @@ template <typename Struct, typename PreArray> [[nodiscard]] constexpr std::size_
 
 [[nodiscard]] std::vector<char> readFile(const std::filesystem::path&);
 
+// runs the tasks on all hardware threads including the calling thread, and returns after all of them have finished.
+// tasks may call this again; the threads of all nested calls together never exceed the number of hardware threads
+void runInParallel(const std::vector<std::function<void()>>&);
+
 
 // vulkan helpers
 void vkCheck(vk::Result);
@@ -130,12 +135,6 @@ vma::UniqueImage loadTexture(
 void loadScene(const std::string& filename, nvh::GltfScene& m_gltfScene);
 
 [[nodiscard]] std::vector<shader::pointLight> collectPointLightsFromScene(const nvh::GltfScene&);
-[[nodiscard]] std::vector<shader::pointLight> generateRandomPointLights(
-	std::size_t count, nvmath::vec3 min, nvmath::vec3 max,
-	std::uniform_real_distribution<float> distR = std::uniform_real_distribution<float>(0.0f, 1.0f),
-	std::uniform_real_distribution<float> distG = std::uniform_real_distribution<float>(0.0f, 1.0f),
-	std::uniform_real_distribution<float> distB = std::uniform_real_distribution<float>(0.0f, 1.0f)
-);
 
 [[nodiscard]] std::vector<shader::triLight> collectTriangleLightsFromScene(const nvh::GltfScene&);
 
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "pass.h"
+#include "../shader.h"
+#include "../sceneBuffers.h"
+
+// Culls nodes against the view frustum using the world space bounds of their meshes, and writes a draw command for
+// each visible node into a buffer that GBufferPass draws with drawIndexedIndirectCount(). The buffer starts with the
+// number of commands, followed by the commands themselves. Commands are written in no particular order, and their
+// first instance is the index of the node.
+class CullingPass : public Pass {
+public:
+	using Uniforms = shader::CullingUniforms;
+
+	[[nodiscard]] vk::DescriptorSetLayout getDescriptorSetLayout() const {
+		return _descriptorLayout.get();
+	}
+
+	void issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer) const override {
+		commandBuffer.fillBuffer(drawBuffer, 0, sizeof(uint32_t), 0);
+		vk::MemoryBarrier barrier;
+		barrier
+			.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, { barrier }, {}, {}
+		);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, getPipelines()[0].get());
+		commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eCompute, _layout.get(), 0, { descriptorSet }, { uniformOffset }
+		);
+		commandBuffer.dispatch(ceilDiv<uint32_t>(nodeCount, CULLING_GROUP_SIZE), 1, 1);
+	}
+
+	void initializeDescriptorSetFor(
+		const SceneBuffers &scene, vk::Buffer uniformBuffer, vk::Buffer drawCommandBuffer,
+		vk::Device device, vk::DescriptorSet set
+	) {
+		std::array<vk::WriteDescriptorSet, 4> writes;
+
+		vk::DescriptorBufferInfo uniformInfo(uniformBuffer, 0, sizeof(Uniforms));
+		vk::DescriptorBufferInfo nodesInfo(scene.getNodes(), 0, VK_WHOLE_SIZE);
+		vk::DescriptorBufferInfo boundsInfo(scene.getNodeBounds(), 0, VK_WHOLE_SIZE);
+		vk::DescriptorBufferInfo drawCommandsInfo(drawCommandBuffer, 0, VK_WHOLE_SIZE);
+
+		writes[0]
+			.setDstSet(set)
+			.setDstBinding(0)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+			.setBufferInfo(uniformInfo);
+		writes[1]
+			.setDstSet(set)
+			.setDstBinding(1)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(nodesInfo);
+		writes[2]
+			.setDstSet(set)
+			.setDstBinding(2)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(boundsInfo);
+		writes[3]
+			.setDstSet(set)
+			.setDstBinding(3)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(drawCommandsInfo);
+
+		device.updateDescriptorSets(writes, {});
+	}
+
+	// offset of the first command in the draw command buffer
+	[[nodiscard]] constexpr static vk::DeviceSize getDrawCommandOffset() {
+		return alignPreArrayBlock<shader::DrawIndexedIndirectCommand, uint32_t>();
+	}
+	[[nodiscard]] static vk::DeviceSize getDrawCommandBufferSize(std::size_t numNodes) {
+		return getDrawCommandOffset() + sizeof(shader::DrawIndexedIndirectCommand) * numNodes;
+	}
+
+	// culls against the view frustum of the matrix, whose projection must map depth to [0, 1]. the planes are not
+	// normalized, which the culling test does not need
+	[[nodiscard]] static Uniforms getUniforms(const nvmath::mat4f &projectionView, uint32_t nodeCount) {
+		Uniforms result;
+		nvmath::vec4f x = projectionView.row(0), y = projectionView.row(1);
+		nvmath::vec4f z = projectionView.row(2), w = projectionView.row(3);
+		result.frustumPlanes[0] = w + x;
+		result.frustumPlanes[1] = w - x;
+		result.frustumPlanes[2] = w + y;
+		result.frustumPlanes[3] = w - y;
+		result.frustumPlanes[4] = z;
+		result.frustumPlanes[5] = w - z;
+		result.nodeCount = nodeCount;
+		return result;
+	}
+	// the CPU version of culling.comp, used to check its results. commands are returned in the order of nodes, which
+	// the commands written by the GPU can be sorted into by their first instance
+	[[nodiscard]] static std::vector<shader::DrawIndexedIndirectCommand> cullOnCpu(
+		const Uniforms &uniforms, const nvh::GltfScene &scene, const std::vector<shader::NodeBounds> &bounds
+	) {
+		std::vector<shader::DrawIndexedIndirectCommand> result;
+		for (uint32_t i = 0; i < uniforms.nodeCount; ++i) {
+			if (!shader::isNodeInFrustum(uniforms, bounds[i])) {
+				continue;
+			}
+			const nvh::GltfPrimMesh &mesh = scene.m_primMeshes[scene.m_nodes[i].primMesh];
+			shader::DrawIndexedIndirectCommand &command = result.emplace_back();
+			command.indexCount = mesh.indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = mesh.firstIndex;
+			command.vertexOffset = static_cast<int32_t>(mesh.vertexOffset);
+			command.firstInstance = i;
+		}
+		return result;
+	}
+
+	vk::DescriptorSet descriptorSet;
+	// dynamic offset of the uniforms
+	uint32_t uniformOffset = 0;
+	// the buffer that the descriptor set writes the draw commands to. the count is cleared before culling
+	vk::Buffer drawBuffer;
+	uint32_t nodeCount = 0;
+protected:
+	Shader _shader;
+	vk::UniqueDescriptorSetLayout _descriptorLayout;
+	vk::UniquePipelineLayout _layout;
+
+	vk::UniqueRenderPass _createPass(vk::Device) override {
+		return {};
+	}
+
+	std::vector<PipelineCreationInfo> _getPipelineCreationInfo() override {
+		std::vector<PipelineCreationInfo> result;
+		vk::ComputePipelineCreateInfo pipelineInfo;
+		pipelineInfo
+			.setStage(_shader.getStageInfo())
+			.setLayout(_layout.get());
+		result.emplace_back(pipelineInfo);
+		return result;
+	}
+
+	void _initialize(vk::Device dev) override {
+		_shader = Shader::load(dev, "shaders/culling.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+		std::array<vk::DescriptorSetLayoutBinding, 4> bindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+		};
+		vk::DescriptorSetLayoutCreateInfo descriptorInfo;
+		descriptorInfo.setBindings(bindings);
+		_descriptorLayout = dev.createDescriptorSetLayoutUnique(descriptorInfo);
+
+		std::array<vk::DescriptorSetLayout, 1> descriptorLayouts{ _descriptorLayout.get() };
+		vk::PipelineLayoutCreateInfo layoutInfo;
+		layoutInfo.setSetLayouts(descriptorLayouts);
+		_layout = dev.createPipelineLayoutUnique(layoutInfo);
+
+		Pass::_initialize(dev);
+	}
+};
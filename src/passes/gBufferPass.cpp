@@ -12,13 +12,21 @@ void GBuffer::resize(vma::Allocator &allocator, vk::Device device, vk::Extent2D
 	_normalView.reset();
 	_materialPropertiesView.reset();
 	_worldPosView.reset();
+	_motionVectorView.reset();
+	_keyView.reset();
 	_depthView.reset();
+	_visibilityView.reset();
+	_materialDepthView.reset();
 
 	_albedoBuffer.reset();
 	_normalBuffer.reset();
 	_materialPropertiesBuffer.reset();
 	_worldPosBuffer.reset();
+	_motionVectorBuffer.reset();
+	_keyBuffer.reset();
 	_depthBuffer.reset();
+	_visibilityBuffer.reset();
+	_materialDepthBuffer.reset();
 
 	const Formats &formats = Formats::get();
 
@@ -30,18 +38,38 @@ void GBuffer::resize(vma::Allocator &allocator, vk::Device device, vk::Extent2D
 		extent, formats.normal,
 		vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
 	);
-	_materialPropertiesBuffer = allocator.createImage2D(
-		extent, formats.materialProperties,
+	if (!formats.compact) {
+		_materialPropertiesBuffer = allocator.createImage2D(
+			extent, formats.materialProperties,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
+		);
+		_worldPosBuffer = allocator.createImage2D(
+			extent, formats.worldPosition,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
+		);
+	}
+	_motionVectorBuffer = allocator.createImage2D(
+		extent, formats.motionVector,
 		vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
 	);
-	_worldPosBuffer = allocator.createImage2D(
-		extent, formats.worldPosition,
+	_keyBuffer = allocator.createImage2D(
+		extent, formats.key,
 		vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled
 	);
 	_depthBuffer = allocator.createImage2D(
 		extent, formats.depth,
 		vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled
 	);
+	if (formats.visibilityBuffer) {
+		// neither is needed outside of GBufferPass
+		_visibilityBuffer = allocator.createImage2D(
+			extent, formats.visibility,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment
+		);
+		_materialDepthBuffer = allocator.createImage2D(
+			extent, formats.materialDepth, vk::ImageUsageFlagBits::eDepthStencilAttachment
+		);
+	}
 
 	_albedoView = createImageView2D(
 		device, _albedoBuffer.get(), formats.albedo, vk::ImageAspectFlagBits::eColor
@@ -49,19 +77,45 @@ void GBuffer::resize(vma::Allocator &allocator, vk::Device device, vk::Extent2D
 	_normalView = createImageView2D(
 		device, _normalBuffer.get(), formats.normal, vk::ImageAspectFlagBits::eColor
 	);
-	_materialPropertiesView = createImageView2D(
-		device, _materialPropertiesBuffer.get(), formats.materialProperties, vk::ImageAspectFlagBits::eColor
+	if (!formats.compact) {
+		_materialPropertiesView = createImageView2D(
+			device, _materialPropertiesBuffer.get(), formats.materialProperties, vk::ImageAspectFlagBits::eColor
+		);
+		_worldPosView = createImageView2D(
+			device, _worldPosBuffer.get(), formats.worldPosition, vk::ImageAspectFlagBits::eColor
+		);
+	}
+	_motionVectorView = createImageView2D(
+		device, _motionVectorBuffer.get(), formats.motionVector, vk::ImageAspectFlagBits::eColor
 	);
-	_worldPosView = createImageView2D(
-		device, _worldPosBuffer.get(), formats.worldPosition, vk::ImageAspectFlagBits::eColor
+	_keyView = createImageView2D(
+		device, _keyBuffer.get(), formats.key, vk::ImageAspectFlagBits::eColor
 	);
 	_depthView = createImageView2D(
 		device, _depthBuffer.get(), formats.depth, formats.depthAspect
 	);
+	if (formats.visibilityBuffer) {
+		_visibilityView = createImageView2D(
+			device, _visibilityBuffer.get(), formats.visibility, vk::ImageAspectFlagBits::eColor
+		);
+		_materialDepthView = createImageView2D(
+			device, _materialDepthBuffer.get(), formats.materialDepth, vk::ImageAspectFlagBits::eDepth
+		);
+	}
 
-	std::array<vk::ImageView, 5> attachments{
-		_albedoView.get(), _normalView.get(), _materialPropertiesView.get(), _worldPosView.get(), _depthView.get()
-	};
+	// must match the attachments in GBufferPass::_createPass()
+	std::vector<vk::ImageView> attachments{ _albedoView.get(), _normalView.get() };
+	if (!formats.compact) {
+		attachments.emplace_back(_materialPropertiesView.get());
+		attachments.emplace_back(_worldPosView.get());
+	}
+	attachments.emplace_back(_motionVectorView.get());
+	attachments.emplace_back(_keyView.get());
+	attachments.emplace_back(_depthView.get());
+	if (formats.visibilityBuffer) {
+		attachments.emplace_back(_visibilityView.get());
+		attachments.emplace_back(_materialDepthView.get());
+	}
 	vk::FramebufferCreateInfo framebufferInfo;
 	framebufferInfo
 		.setRenderPass(pass.getPass())
@@ -72,22 +126,36 @@ void GBuffer::resize(vma::Allocator &allocator, vk::Device device, vk::Extent2D
 	_framebuffer = device.createFramebufferUnique(framebufferInfo);
 }
 
-void GBuffer::Formats::initialize(vk::PhysicalDevice physicalDevice) {
+void GBuffer::Formats::initialize(vk::PhysicalDevice physicalDevice, bool compact, bool visibilityBuffer) {
 	assert(!_formatsInitialized);
-	_gBufferFormats.albedo = findSupportedFormat(
-		{ vk::Format::eR8G8B8A8Srgb },
-		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
-	);
-	_gBufferFormats.normal = findSupportedFormat(
-		{
-			vk::Format::eR16G16B16Snorm,
-			vk::Format::eR16G16B16Sfloat,
-			vk::Format::eR16G16B16A16Snorm,
-			vk::Format::eR16G16B16A16Sfloat,
-			vk::Format::eR32G32B32Sfloat
-		},
-		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
-	);
+	_gBufferFormats.compact = compact;
+	_gBufferFormats.visibilityBuffer = visibilityBuffer;
+	if (compact) {
+		// see gBufferPacking.glsl
+		_gBufferFormats.albedo = findSupportedFormat(
+			{ vk::Format::eR16G16B16A16Unorm },
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+		);
+		_gBufferFormats.normal = findSupportedFormat(
+			{ vk::Format::eR16G16Snorm, vk::Format::eR16G16Sfloat },
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+		);
+	} else {
+		_gBufferFormats.albedo = findSupportedFormat(
+			{ vk::Format::eR8G8B8A8Srgb },
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+		);
+		_gBufferFormats.normal = findSupportedFormat(
+			{
+				vk::Format::eR16G16B16Snorm,
+				vk::Format::eR16G16B16Sfloat,
+				vk::Format::eR16G16B16A16Snorm,
+				vk::Format::eR16G16B16A16Sfloat,
+				vk::Format::eR32G32B32Sfloat
+			},
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+		);
+	}
 	_gBufferFormats.depth = findSupportedFormat(
 		{ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
 		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment
@@ -100,6 +168,26 @@ void GBuffer::Formats::initialize(vk::PhysicalDevice physicalDevice) {
 		{ vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat },
 		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
 	);
+	_gBufferFormats.motionVector = findSupportedFormat(
+		{ vk::Format::eR16G16Sfloat, vk::Format::eR32G32Sfloat },
+		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+	);
+	_gBufferFormats.key = findSupportedFormat(
+		{ vk::Format::eR32Uint },
+		physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+	);
+	if (visibilityBuffer) {
+		// node and primitive index
+		_gBufferFormats.visibility = findSupportedFormat(
+			{ vk::Format::eR32G32Uint },
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eColorAttachment
+		);
+		// must be able to represent getMaterialDepth() exactly
+		_gBufferFormats.materialDepth = findSupportedFormat(
+			{ vk::Format::eD16Unorm },
+			physicalDevice, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment
+		);
+	}
 	_gBufferFormats.depthAspect = vk::ImageAspectFlagBits::eDepth;
 	if (_gBufferFormats.depth != vk::Format::eD32Sfloat) {
 		_gBufferFormats.depthAspect |= vk::ImageAspectFlagBits::eStencil;
@@ -114,13 +202,29 @@ const GBuffer::Formats &GBuffer::Formats::get() {
 
 
 void GBufferPass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer framebuffer) const {
-	std::array<vk::ClearValue, 5> clearValues{
-		vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }),
-		vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }),
-		vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }),
-		vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }),
-		vk::ClearDepthStencilValue(1.0f)
-	};
+	const GBuffer::Formats &formats = GBuffer::Formats::get();
+
+	std::vector<vk::ClearValue> clearValues;
+	clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }));
+	if (formats.compact) {
+		// (-1, -1) marks pixels without geometry, see encodeGBufferNormal()
+		clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ -1.0f, -1.0f, 0.0f, 0.0f }));
+	} else {
+		clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }));
+		clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }));
+		clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }));
+	}
+	clearValues.emplace_back(vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 0.0f }));
+	// a key of zero marks pixels without geometry
+	clearValues.emplace_back(vk::ClearColorValue(std::array<uint32_t, 4>{ 0, 0, 0, 0 }));
+	clearValues.emplace_back(vk::ClearDepthStencilValue(1.0f));
+	if (formats.visibilityBuffer) {
+		clearValues.emplace_back(vk::ClearColorValue(std::array<uint32_t, 4>{
+			VISIBILITY_BUFFER_EMPTY, VISIBILITY_BUFFER_EMPTY, 0, 0
+		}));
+		// does not correspond to any material, see getMaterialDepth()
+		clearValues.emplace_back(vk::ClearDepthStencilValue(1.0f));
+	}
 	vk::RenderPassBeginInfo passBeginInfo;
 	passBeginInfo
 		.setRenderPass(getPass())
@@ -128,29 +232,93 @@ void GBufferPass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer
 		.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), _bufferExtent))
 		.setClearValues(clearValues);
 	commandBuffer.beginRenderPass(passBeginInfo, vk::SubpassContents::eInline);
+	// shared by all subpasses
+	commandBuffer.setViewport(0, { vk::Viewport(
+		0.0f, 0.0f, static_cast<float>(_bufferExtent.width), static_cast<float>(_bufferExtent.height), 0.0f, 1.0f
+	) });
+	commandBuffer.setScissor(0, { vk::Rect2D(vk::Offset2D(0, 0), _bufferExtent) });
 
+	// in visibility buffer mode, this pipeline only writes the visibility buffer and depth
 	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getPipelines()[0].get());
 	commandBuffer.bindVertexBuffers(0, { sceneBuffers->getVertices() }, { 0 });
 	commandBuffer.bindIndexBuffer(sceneBuffers->getIndices(), 0, vk::IndexType::eUint32);
 
-	for (std::size_t i = 0; i < scene->m_nodes.size(); ++i) {
-		const nvh::GltfNode &node = scene->m_nodes[i];
-		const nvh::GltfPrimMesh &mesh = scene->m_primMeshes[node.primMesh];
-
+	if (hasBindlessMaterials()) {
+		// shaders find the matrices and the material of each node through its index, so nothing is bound per draw
 		commandBuffer.bindDescriptorSets(
 			vk::PipelineBindPoint::eGraphics, _pipelineLayout.get(), 0,
-			{
-				descriptorSets->uniformDescriptor.get(),
-				descriptorSets->matrixDescriptor.get(),
-				descriptorSets->materialDescriptor.get(),
-				descriptorSets->materialTexturesDescriptors[mesh.materialIndex].get()
-			},
-				{
-					static_cast<uint32_t>(i * sizeof(shader::ModelMatrices)),
-					static_cast<uint32_t>(mesh.materialIndex * sizeof(shader::MaterialUniforms))
-				}
+			{ descriptorSets->uniformDescriptor.get(), descriptorSets->bindlessDescriptor.get() },
+			{ uniformOffset }
+		);
+	}
+	if (drawCommandBuffer) {
+		assert(hasBindlessMaterials());
+		commandBuffer.drawIndexedIndirectCount(
+			drawCommandBuffer, CullingPass::getDrawCommandOffset(), drawCommandBuffer, 0,
+			static_cast<uint32_t>(scene->m_nodes.size()), sizeof(shader::DrawIndexedIndirectCommand)
+		);
+	} else {
+		for (std::size_t i = 0; i < scene->m_nodes.size(); ++i) {
+			const nvh::GltfNode &node = scene->m_nodes[i];
+			const nvh::GltfPrimMesh &mesh = scene->m_primMeshes[node.primMesh];
+
+			if (!hasBindlessMaterials()) {
+				commandBuffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eGraphics, _pipelineLayout.get(), 0,
+					{
+						descriptorSets->uniformDescriptor.get(),
+						descriptorSets->matrixDescriptor.get(),
+						descriptorSets->materialDescriptor.get(),
+						descriptorSets->materialTexturesDescriptors[mesh.materialIndex].get()
+					},
+					{
+						uniformOffset,
+						static_cast<uint32_t>(i * sizeof(shader::ModelMatrices)),
+						static_cast<uint32_t>(mesh.materialIndex * sizeof(shader::MaterialUniforms))
+					}
 				);
-		commandBuffer.drawIndexed(mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, 0);
+			}
+			// the instance index is the index of the node, which is written to the visibility buffer
+			commandBuffer.drawIndexed(mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, static_cast<uint32_t>(i));
+		}
+	}
+
+	if (formats.visibilityBuffer) {
+		// classify pixels by material
+		commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getPipelines()[1].get());
+		commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics, _resolvePipelineLayout.get(), 0,
+			{ descriptorSets->uniformDescriptor.get(), resolveDescriptorSet }, { uniformOffset }
+		);
+		commandBuffer.draw(4, 1, 0, 0);
+
+		// resolve the G-buffer one material at a time
+		commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getPipelines()[2].get());
+		if (hasBindlessMaterials()) {
+			commandBuffer.bindDescriptorSets(
+				vk::PipelineBindPoint::eGraphics, _resolvePipelineLayout.get(), 2,
+				{ descriptorSets->bindlessDescriptor.get() }, {}
+			);
+		}
+		for (std::size_t i = 0; i < scene->m_materials.size(); ++i) {
+			uint32_t materialIndex = static_cast<uint32_t>(i);
+			if (!hasBindlessMaterials()) {
+				commandBuffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eGraphics, _resolvePipelineLayout.get(), 2,
+					{
+						descriptorSets->materialDescriptor.get(),
+						descriptorSets->materialTexturesDescriptors[i].get()
+					},
+					{ static_cast<uint32_t>(i * sizeof(shader::MaterialUniforms)) }
+				);
+			}
+			commandBuffer.pushConstants(
+				_resolvePipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32_t), &materialIndex
+			);
+			commandBuffer.draw(4, 1, 0, 0);
+		}
 	}
 
 	commandBuffer.endRenderPass();
@@ -163,14 +331,39 @@ void GBufferPass::initializeResourcesFor(
 	bufferWrite.reserve(2 + 4 * targetScene.m_materials.size());
 
 	std::array<vk::DescriptorBufferInfo, 1> uniformBufferInfo{
-		vk::DescriptorBufferInfo(sets.uniformBuffer.get(), 0, sizeof(Uniforms))
+		vk::DescriptorBufferInfo(sets.uniformBuffer, 0, sizeof(Uniforms))
 	};
 	bufferWrite.emplace_back()
 		.setDstSet(sets.uniformDescriptor.get())
 		.setDstBinding(0)
-		.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+		.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 		.setBufferInfo(uniformBufferInfo);
 
+	if (hasBindlessMaterials()) {
+		std::array<vk::DescriptorBufferInfo, 4> bindlessBufferInfo{
+			vk::DescriptorBufferInfo(buffers.getMatrices(), 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(buffers.getNodes(), 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(buffers.getMaterials(), 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(buffers.getMaterialTextures(), 0, VK_WHOLE_SIZE)
+		};
+		for (uint32_t i = 0; i < bindlessBufferInfo.size(); ++i) {
+			bufferWrite.emplace_back()
+				.setDstSet(sets.bindlessDescriptor.get())
+				.setDstBinding(i)
+				.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				.setBufferInfo(bindlessBufferInfo[i]);
+		}
+		std::vector<vk::DescriptorImageInfo> bindlessTextureInfo = buffers.getBindlessTextureInfo();
+		bufferWrite.emplace_back()
+			.setDstSet(sets.bindlessDescriptor.get())
+			.setDstBinding(4)
+			.setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+			.setImageInfo(bindlessTextureInfo);
+
+		device.get().updateDescriptorSets(bufferWrite, {});
+		return;
+	}
+
 	std::array<vk::DescriptorBufferInfo, 1> matricesBufferInfo{
 		vk::DescriptorBufferInfo(buffers.getMatrices(), 0, sizeof(shader::ModelMatrices))
 	};
@@ -248,46 +441,58 @@ void GBufferPass::initializeResourcesFor(
 	device.get().updateDescriptorSets(bufferWrite, {});
 }
 
+void GBufferPass::initializeResolveDescriptorSetFor(
+	const GBuffer &gBuffer, const SceneBuffers &buffers, vk::Device device, vk::DescriptorSet set
+) {
+	std::array<vk::WriteDescriptorSet, 5> writes;
+
+	vk::DescriptorImageInfo visibilityInfo(nullptr, gBuffer.getVisibilityView(), vk::ImageLayout::eShaderReadOnlyOptimal);
+	writes[0]
+		.setDstSet(set)
+		.setDstBinding(0)
+		.setDescriptorType(vk::DescriptorType::eInputAttachment)
+		.setImageInfo(visibilityInfo);
+
+	std::array<vk::DescriptorBufferInfo, 4> bufferInfo{
+		vk::DescriptorBufferInfo(buffers.getNodes(), 0, VK_WHOLE_SIZE),
+		vk::DescriptorBufferInfo(buffers.getIndices(), 0, VK_WHOLE_SIZE),
+		vk::DescriptorBufferInfo(buffers.getVertices(), 0, VK_WHOLE_SIZE),
+		vk::DescriptorBufferInfo(buffers.getMatrices(), 0, VK_WHOLE_SIZE)
+	};
+	for (uint32_t i = 0; i < bufferInfo.size(); ++i) {
+		writes[i + 1]
+			.setDstSet(set)
+			.setDstBinding(i + 1)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(bufferInfo[i]);
+	}
+
+	device.updateDescriptorSets(writes, {});
+}
+
 vk::UniqueRenderPass GBufferPass::_createPass(vk::Device device) {
 	const GBuffer::Formats &formats = GBuffer::Formats::get();
 
+	std::vector<vk::Format> colorFormats{ formats.albedo, formats.normal };
+	if (!formats.compact) {
+		colorFormats.emplace_back(formats.materialProperties);
+		colorFormats.emplace_back(formats.worldPosition);
+	}
+	colorFormats.emplace_back(formats.motionVector);
+	colorFormats.emplace_back(formats.key);
+
 	std::vector<vk::AttachmentDescription> attachments;
-	attachments.emplace_back()
-		.setFormat(formats.albedo)
-		.setSamples(vk::SampleCountFlagBits::e1)
-		.setLoadOp(vk::AttachmentLoadOp::eClear)
-		.setStoreOp(vk::AttachmentStoreOp::eStore)
-		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-		.setInitialLayout(vk::ImageLayout::eUndefined)
-		.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	attachments.emplace_back()
-		.setFormat(formats.normal)
-		.setSamples(vk::SampleCountFlagBits::e1)
-		.setLoadOp(vk::AttachmentLoadOp::eClear)
-		.setStoreOp(vk::AttachmentStoreOp::eStore)
-		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-		.setInitialLayout(vk::ImageLayout::eUndefined)
-		.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	attachments.emplace_back()
-		.setFormat(formats.materialProperties)
-		.setSamples(vk::SampleCountFlagBits::e1)
-		.setLoadOp(vk::AttachmentLoadOp::eClear)
-		.setStoreOp(vk::AttachmentStoreOp::eStore)
-		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-		.setInitialLayout(vk::ImageLayout::eUndefined)
-		.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-	attachments.emplace_back()
-		.setFormat(formats.worldPosition)
-		.setSamples(vk::SampleCountFlagBits::e1)
-		.setLoadOp(vk::AttachmentLoadOp::eClear)
-		.setStoreOp(vk::AttachmentStoreOp::eStore)
-		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-		.setInitialLayout(vk::ImageLayout::eUndefined)
-		.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	for (vk::Format format : colorFormats) {
+		attachments.emplace_back()
+			.setFormat(format)
+			.setSamples(vk::SampleCountFlagBits::e1)
+			.setLoadOp(vk::AttachmentLoadOp::eClear)
+			.setStoreOp(vk::AttachmentStoreOp::eStore)
+			.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+			.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+			.setInitialLayout(vk::ImageLayout::eUndefined)
+			.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	}
 	attachments.emplace_back()
 		.setFormat(formats.depth)
 		.setSamples(vk::SampleCountFlagBits::e1)
@@ -297,25 +502,57 @@ vk::UniqueRenderPass GBufferPass::_createPass(vk::Device device) {
 		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
 		.setInitialLayout(vk::ImageLayout::eUndefined)
 		.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+	uint32_t depthAttachment = static_cast<uint32_t>(colorFormats.size());
+	uint32_t visibilityAttachment = depthAttachment + 1;
+	uint32_t materialDepthAttachment = depthAttachment + 2;
+	if (formats.visibilityBuffer) {
+		// the visibility buffer and material depth are discarded at the end of the pass
+		attachments.emplace_back()
+			.setFormat(formats.visibility)
+			.setSamples(vk::SampleCountFlagBits::e1)
+			.setLoadOp(vk::AttachmentLoadOp::eClear)
+			.setStoreOp(vk::AttachmentStoreOp::eDontCare)
+			.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+			.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+			.setInitialLayout(vk::ImageLayout::eUndefined)
+			.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+		attachments.emplace_back()
+			.setFormat(formats.materialDepth)
+			.setSamples(vk::SampleCountFlagBits::e1)
+			.setLoadOp(vk::AttachmentLoadOp::eClear)
+			.setStoreOp(vk::AttachmentStoreOp::eDontCare)
+			.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+			.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+			.setInitialLayout(vk::ImageLayout::eUndefined)
+			.setFinalLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+	}
 
-	std::array<vk::AttachmentReference, 4> colorAttachmentReferences{
-		vk::AttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal),
-		vk::AttachmentReference(1, vk::ImageLayout::eColorAttachmentOptimal),
-		vk::AttachmentReference(2, vk::ImageLayout::eColorAttachmentOptimal),
-		vk::AttachmentReference(3, vk::ImageLayout::eColorAttachmentOptimal)
-	};
+	// indexed by the output locations of gBufferMaterial.glsl. the material properties and world position outputs
+	// are discarded with the compact layout
+	std::array<vk::AttachmentReference, 6> colorAttachmentReferences;
+	for (uint32_t i = 0, attachment = 0; i < colorAttachmentReferences.size(); ++i) {
+		if (formats.compact && (i == 2 || i == 3)) {
+			colorAttachmentReferences[i] = vk::AttachmentReference(VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined);
+		} else {
+			colorAttachmentReferences[i] = vk::AttachmentReference(attachment++, vk::ImageLayout::eColorAttachmentOptimal);
+		}
+	}
 
 	vk::AttachmentReference depthAttachmentReference;
 	depthAttachmentReference
-		.setAttachment(4)
+		.setAttachment(depthAttachment)
 		.setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
-	std::vector<vk::SubpassDescription> subpasses;
-	subpasses.emplace_back()
-		.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
-		.setColorAttachments(colorAttachmentReferences)
-		.setPDepthStencilAttachment(&depthAttachmentReference);
+	vk::AttachmentReference visibilityOutputReference(visibilityAttachment, vk::ImageLayout::eColorAttachmentOptimal);
+	vk::AttachmentReference visibilityInputReference(visibilityAttachment, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::AttachmentReference materialDepthOutputReference(
+		materialDepthAttachment, vk::ImageLayout::eDepthStencilAttachmentOptimal
+	);
+	vk::AttachmentReference materialDepthTestReference(
+		materialDepthAttachment, vk::ImageLayout::eDepthStencilReadOnlyOptimal
+	);
 
+	std::vector<vk::SubpassDescription> subpasses;
 	std::vector<vk::SubpassDependency> dependencies;
 	dependencies.emplace_back()
 		.setSrcSubpass(VK_SUBPASS_EXTERNAL)
@@ -324,6 +561,66 @@ vk::UniqueRenderPass GBufferPass::_createPass(vk::Device device) {
 		.setSrcAccessMask(vk::AccessFlags())
 		.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
 		.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+	if (formats.visibilityBuffer) {
+		// rasterize the visibility buffer, then classify pixels by material, then resolve the G-buffer
+		subpasses.emplace_back()
+			.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+			.setColorAttachments(visibilityOutputReference)
+			.setPDepthStencilAttachment(&depthAttachmentReference);
+		subpasses.emplace_back()
+			.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+			.setInputAttachments(visibilityInputReference)
+			.setPDepthStencilAttachment(&materialDepthOutputReference);
+		subpasses.emplace_back()
+			.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+			.setInputAttachments(visibilityInputReference)
+			.setColorAttachments(colorAttachmentReferences)
+			.setPDepthStencilAttachment(&materialDepthTestReference);
+
+		dependencies.emplace_back()
+			.setSrcSubpass(VK_SUBPASS_EXTERNAL)
+			.setDstSubpass(2)
+			.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+			.setSrcAccessMask(vk::AccessFlags())
+			.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+			.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+		for (uint32_t dst : { 1u, 2u }) {
+			dependencies.emplace_back()
+				.setSrcSubpass(0)
+				.setDstSubpass(dst)
+				.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+				.setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
+				.setDstAccessMask(vk::AccessFlagBits::eInputAttachmentRead)
+				.setDependencyFlags(vk::DependencyFlagBits::eByRegion);
+		}
+		dependencies.emplace_back()
+			.setSrcSubpass(1)
+			.setDstSubpass(2)
+			.setSrcStageMask(vk::PipelineStageFlagBits::eLateFragmentTests)
+			.setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+			.setDstStageMask(vk::PipelineStageFlagBits::eEarlyFragmentTests)
+			.setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead)
+			.setDependencyFlags(vk::DependencyFlagBits::eByRegion);
+	} else {
+		subpasses.emplace_back()
+			.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+			.setColorAttachments(colorAttachmentReferences)
+			.setPDepthStencilAttachment(&depthAttachmentReference);
+	}
+	// makes the final layout transitions happen before the attachment stages, so that the barriers recorded after this
+	// pass by the frame graph also cover them
+	dependencies.emplace_back()
+		.setSrcSubpass(static_cast<uint32_t>(subpasses.size() - 1))
+		.setDstSubpass(VK_SUBPASS_EXTERNAL)
+		.setSrcStageMask(
+			vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests
+		)
+		.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+		.setDstStageMask(
+			vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests
+		)
+		.setDstAccessMask(vk::AccessFlags());
 
 	vk::RenderPassCreateInfo renderPassInfo;
 	renderPassInfo
@@ -335,98 +632,243 @@ vk::UniqueRenderPass GBufferPass::_createPass(vk::Device device) {
 }
 
 std::vector<Pass::PipelineCreationInfo> GBufferPass::_getPipelineCreationInfo() {
+	const GBuffer::Formats &formats = GBuffer::Formats::get();
+
 	std::vector<PipelineCreationInfo> result;
 
-	GraphicsPipelineCreationInfo info;
+	_compact = formats.compact ? VK_TRUE : VK_FALSE;
+	_specializationEntry = vk::SpecializationMapEntry(COMPACT_GBUFFER_CONSTANT_ID, 0, sizeof(vk::Bool32));
+	_specializationInfo
+		.setMapEntries(_specializationEntry)
+		.setDataSize(sizeof(vk::Bool32))
+		.setPData(&_compact);
 
-	info.vertexInputBindingStorage.emplace_back(0, static_cast<uint32_t>(sizeof(Vertex)), vk::VertexInputRate::eVertex);
-	info.vertexInputAttributeStorage.emplace_back(0, 0, vk::Format::eR32G32B32Sfloat, static_cast<uint32_t>(offsetof(Vertex, position)));
-	info.vertexInputAttributeStorage.emplace_back(1, 0, vk::Format::eR32G32B32Sfloat, static_cast<uint32_t>(offsetof(Vertex, normal)));
-	info.vertexInputAttributeStorage.emplace_back(2, 0, vk::Format::eR32G32B32A32Sfloat, static_cast<uint32_t>(offsetof(Vertex, tangent)));
-	info.vertexInputAttributeStorage.emplace_back(3, 0, vk::Format::eR32G32B32A32Sfloat, static_cast<uint32_t>(offsetof(Vertex, color)));
-	info.vertexInputAttributeStorage.emplace_back(4, 0, vk::Format::eR32G32Sfloat, static_cast<uint32_t>(offsetof(Vertex, uv)));
-	info.vertexInputState
-		.setVertexBindingDescriptions(info.vertexInputBindingStorage)
-		.setVertexAttributeDescriptions(info.vertexInputAttributeStorage);
+	{
+		GraphicsPipelineCreationInfo info;
 
-	info.inputAssemblyState = GraphicsPipelineCreationInfo::getTriangleListWithoutPrimitiveRestartInputAssembly();
+		info.vertexInputBindingStorage.emplace_back(0, static_cast<uint32_t>(sizeof(Vertex)), vk::VertexInputRate::eVertex);
+		info.vertexInputAttributeStorage.emplace_back(0, 0, vk::Format::eR32G32B32Sfloat, static_cast<uint32_t>(offsetof(Vertex, position)));
+		info.vertexInputAttributeStorage.emplace_back(1, 0, vk::Format::eR32G32B32Sfloat, static_cast<uint32_t>(offsetof(Vertex, normal)));
+		info.vertexInputAttributeStorage.emplace_back(2, 0, vk::Format::eR32G32B32A32Sfloat, static_cast<uint32_t>(offsetof(Vertex, tangent)));
+		info.vertexInputAttributeStorage.emplace_back(3, 0, vk::Format::eR32G32B32A32Sfloat, static_cast<uint32_t>(offsetof(Vertex, color)));
+		info.vertexInputAttributeStorage.emplace_back(4, 0, vk::Format::eR32G32Sfloat, static_cast<uint32_t>(offsetof(Vertex, uv)));
+		info.vertexInputState
+			.setVertexBindingDescriptions(info.vertexInputBindingStorage)
+			.setVertexAttributeDescriptions(info.vertexInputAttributeStorage);
 
-	info.viewportStorage.emplace_back(
-		0.0f, 0.0f, static_cast<float>(_bufferExtent.width), static_cast<float>(_bufferExtent.height), 0.0f, 1.0f
-	);
-	info.scissorStorage.emplace_back(vk::Offset2D(0, 0), _bufferExtent);
-	info.viewportState
-		.setViewports(info.viewportStorage)
-		.setScissors(info.scissorStorage);
+		info.inputAssemblyState = GraphicsPipelineCreationInfo::getTriangleListWithoutPrimitiveRestartInputAssembly();
 
-	info.rasterizationState = GraphicsPipelineCreationInfo::getDefaultRasterizationState();
+		_setViewportState(info);
 
-	info.depthStencilState = GraphicsPipelineCreationInfo::getDefaultDepthTestState();
+		info.rasterizationState = GraphicsPipelineCreationInfo::getDefaultRasterizationState();
 
-	info.multisampleState = GraphicsPipelineCreationInfo::getNoMultisampleState();
+		info.depthStencilState = GraphicsPipelineCreationInfo::getDefaultDepthTestState();
 
-	info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
-	info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
-	info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
-	info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
-	info.colorBlendState.setAttachments(info.attachmentColorBlendStorage);
+		info.multisampleState = GraphicsPipelineCreationInfo::getNoMultisampleState();
+
+		if (formats.visibilityBuffer) {
+			info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
+			info.colorBlendState.setAttachments(info.attachmentColorBlendStorage);
+			info.shaderStages.emplace_back(_visibilityFrag.getStageInfo());
+		} else {
+			_addGBufferBlendAttachments(info);
+			info.shaderStages.emplace_back(_frag.getStageInfo()).setPSpecializationInfo(&_specializationInfo);
+		}
+		info.shaderStages.emplace_back(_vert.getStageInfo());
+
+		info.pipelineLayout = _pipelineLayout.get();
+
+		result.emplace_back(std::move(info));
+	}
+
+	if (formats.visibilityBuffer) {
+		// material classification, which writes getMaterialDepth() of every covered pixel
+		{
+			GraphicsPipelineCreationInfo info;
+
+			info.vertexInputState
+				.setVertexBindingDescriptions(info.vertexInputBindingStorage)
+				.setVertexAttributeDescriptions(info.vertexInputAttributeStorage);
 
-	info.shaderStages.emplace_back(_frag.getStageInfo());
-	info.shaderStages.emplace_back(_vert.getStageInfo());
+			info.inputAssemblyState.setTopology(vk::PrimitiveTopology::eTriangleStrip);
 
-	info.pipelineLayout = _pipelineLayout.get();
+			_setViewportState(info);
 
-	result.emplace_back(std::move(info));
+			info.rasterizationState = GraphicsPipelineCreationInfo::getDefaultRasterizationState();
+			info.rasterizationState.setCullMode(vk::CullModeFlagBits::eNone);
+
+			info.depthStencilState = GraphicsPipelineCreationInfo::getDefaultDepthTestState();
+			info.depthStencilState.setDepthCompareOp(vk::CompareOp::eAlways);
+
+			info.multisampleState = GraphicsPipelineCreationInfo::getNoMultisampleState();
+
+			info.colorBlendState.setAttachments(info.attachmentColorBlendStorage);
+
+			info.shaderStages.emplace_back(_classifyVert.getStageInfo());
+			info.shaderStages.emplace_back(_classifyFrag.getStageInfo());
+
+			info.pipelineLayout = _resolvePipelineLayout.get();
+
+			result.emplace_back(std::move(info));
+		}
+
+		// G-buffer resolve, drawn once for every material at its material depth
+		{
+			GraphicsPipelineCreationInfo info;
+
+			info.vertexInputState
+				.setVertexBindingDescriptions(info.vertexInputBindingStorage)
+				.setVertexAttributeDescriptions(info.vertexInputAttributeStorage);
+
+			info.inputAssemblyState.setTopology(vk::PrimitiveTopology::eTriangleStrip);
+
+			_setViewportState(info);
+
+			info.rasterizationState = GraphicsPipelineCreationInfo::getDefaultRasterizationState();
+			info.rasterizationState.setCullMode(vk::CullModeFlagBits::eNone);
+
+			info.depthStencilState
+				.setDepthTestEnable(true)
+				.setDepthWriteEnable(false)
+				.setDepthCompareOp(vk::CompareOp::eEqual);
+
+			info.multisampleState = GraphicsPipelineCreationInfo::getNoMultisampleState();
+
+			_addGBufferBlendAttachments(info);
+
+			info.shaderStages.emplace_back(_resolveVert.getStageInfo());
+			info.shaderStages.emplace_back(_resolveFrag.getStageInfo()).setPSpecializationInfo(&_specializationInfo);
+
+			info.pipelineLayout = _resolvePipelineLayout.get();
+
+			result.emplace_back(std::move(info));
+		}
+	}
 
 	return result;
 }
 
+void GBufferPass::_addGBufferBlendAttachments(GraphicsPipelineCreationInfo &info) const {
+	for (int i = 0; i < 6; ++i) {
+		info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
+	}
+	info.colorBlendState.setAttachments(info.attachmentColorBlendStorage);
+}
+
+void GBufferPass::_setViewportState(GraphicsPipelineCreationInfo &info) const {
+	info.viewportState
+		.setViewportCount(1)
+		.setScissorCount(1);
+	info.dynamicStates.emplace_back(vk::DynamicState::eViewport);
+	info.dynamicStates.emplace_back(vk::DynamicState::eScissor);
+}
+
 void GBufferPass::_initialize(vk::Device dev) {
-	_vert = Shader::load(dev, "shaders/gBuffer.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
-	_frag = Shader::load(dev, "shaders/gBuffer.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+	// shaders that access materials are compiled separately for bindless materials
+	std::string materialVariant = hasBindlessMaterials() ? ".bindless.spv" : ".spv";
+	_vert = Shader::load(dev, "shaders/gBuffer.vert" + materialVariant, "main", vk::ShaderStageFlagBits::eVertex);
+	_frag = Shader::load(dev, "shaders/gBuffer.frag" + materialVariant, "main", vk::ShaderStageFlagBits::eFragment);
+	if (GBuffer::Formats::get().visibilityBuffer) {
+		_visibilityFrag = Shader::load(dev, "shaders/visibilityBuffer.frag" + materialVariant, "main", vk::ShaderStageFlagBits::eFragment);
+		_classifyVert = Shader::load(dev, "shaders/quad.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
+		_classifyFrag = Shader::load(dev, "shaders/materialClassify.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+		_resolveVert = Shader::load(dev, "shaders/visibilityResolve.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
+		_resolveFrag = Shader::load(dev, "shaders/visibilityResolve.frag" + materialVariant, "main", vk::ShaderStageFlagBits::eFragment);
+	}
 
 	std::array<vk::DescriptorSetLayoutBinding, 1> uniformsDescriptorBindings{
-		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex)
+		vk::DescriptorSetLayoutBinding(
+			0, vk::DescriptorType::eUniformBufferDynamic, 1,
+			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
+		)
 	};
 	vk::DescriptorSetLayoutCreateInfo uniformsDescriptorSetInfo;
 	uniformsDescriptorSetInfo.setBindings(uniformsDescriptorBindings);
 	_uniformsDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(uniformsDescriptorSetInfo);
 
-	std::array<vk::DescriptorSetLayoutBinding, 1> matricesDescriptorBindings{
-		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex)
-	};
-	vk::DescriptorSetLayoutCreateInfo matricesDescriptorSetInfo;
-	matricesDescriptorSetInfo.setBindings(matricesDescriptorBindings);
-	_matricesDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(matricesDescriptorSetInfo);
-
-	std::array<vk::DescriptorSetLayoutBinding, 1> materialDescriptorBindings{
-		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eFragment)
-	};
-	vk::DescriptorSetLayoutCreateInfo materialDescriptorSetInfo;
-	materialDescriptorSetInfo.setBindings(materialDescriptorBindings);
-	_materialDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(materialDescriptorSetInfo);
-
-	std::array<vk::DescriptorSetLayoutBinding, 4> textureDescriptorBindings{
-		vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
-		vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
-		vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
-		vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment)
-	};
-	vk::DescriptorSetLayoutCreateInfo textureDescriptorSetInfo;
-	textureDescriptorSetInfo.setBindings(textureDescriptorBindings);
-	_textureDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(textureDescriptorSetInfo);
-
-	std::array<vk::DescriptorSetLayout, 4> descriptorSetLayouts{
-		_uniformsDescriptorSetLayout.get(),
-		_matricesDescriptorSetLayout.get(),
-		_materialDescriptorSetLayout.get(),
-		_textureDescriptorSetLayout.get()
-	};
+	// with bindless materials, a single set replaces the sets of the matrices, the material, and its textures
+	std::vector<vk::DescriptorSetLayout> descriptorSetLayouts{ _uniformsDescriptorSetLayout.get() };
+	if (hasBindlessMaterials()) {
+		// matrices, node draw info, materials, material textures, and all textures
+		std::array<vk::DescriptorSetLayoutBinding, 5> bindlessDescriptorBindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(
+				4, vk::DescriptorType::eCombinedImageSampler, _bindlessTextureCount, vk::ShaderStageFlagBits::eFragment
+			)
+		};
+		vk::DescriptorSetLayoutCreateInfo bindlessDescriptorSetInfo;
+		bindlessDescriptorSetInfo.setBindings(bindlessDescriptorBindings);
+		_bindlessDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(bindlessDescriptorSetInfo);
+
+		descriptorSetLayouts.emplace_back(_bindlessDescriptorSetLayout.get());
+	} else {
+		std::array<vk::DescriptorSetLayoutBinding, 1> matricesDescriptorBindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex)
+		};
+		vk::DescriptorSetLayoutCreateInfo matricesDescriptorSetInfo;
+		matricesDescriptorSetInfo.setBindings(matricesDescriptorBindings);
+		_matricesDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(matricesDescriptorSetInfo);
+
+		std::array<vk::DescriptorSetLayoutBinding, 1> materialDescriptorBindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eFragment)
+		};
+		vk::DescriptorSetLayoutCreateInfo materialDescriptorSetInfo;
+		materialDescriptorSetInfo.setBindings(materialDescriptorBindings);
+		_materialDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(materialDescriptorSetInfo);
+
+		std::array<vk::DescriptorSetLayoutBinding, 4> textureDescriptorBindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment)
+		};
+		vk::DescriptorSetLayoutCreateInfo textureDescriptorSetInfo;
+		textureDescriptorSetInfo.setBindings(textureDescriptorBindings);
+		_textureDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(textureDescriptorSetInfo);
+
+		descriptorSetLayouts.emplace_back(_matricesDescriptorSetLayout.get());
+		descriptorSetLayouts.emplace_back(_materialDescriptorSetLayout.get());
+		descriptorSetLayouts.emplace_back(_textureDescriptorSetLayout.get());
+	}
 
 	vk::PipelineLayoutCreateInfo pipelineInfo;
 	pipelineInfo
 		.setSetLayouts(descriptorSetLayouts);
 	_pipelineLayout = dev.createPipelineLayoutUnique(pipelineInfo);
 
+	if (GBuffer::Formats::get().visibilityBuffer) {
+		std::array<vk::DescriptorSetLayoutBinding, 5> resolveDescriptorBindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eInputAttachment, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment)
+		};
+		vk::DescriptorSetLayoutCreateInfo resolveDescriptorSetInfo;
+		resolveDescriptorSetInfo.setBindings(resolveDescriptorBindings);
+		_resolveDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(resolveDescriptorSetInfo);
+
+		std::vector<vk::DescriptorSetLayout> resolveSetLayouts{
+			_uniformsDescriptorSetLayout.get(), _resolveDescriptorSetLayout.get()
+		};
+		if (hasBindlessMaterials()) {
+			resolveSetLayouts.emplace_back(_bindlessDescriptorSetLayout.get());
+		} else {
+			resolveSetLayouts.emplace_back(_materialDescriptorSetLayout.get());
+			resolveSetLayouts.emplace_back(_textureDescriptorSetLayout.get());
+		}
+		// the index of the material being resolved
+		vk::PushConstantRange materialIndexRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(uint32_t));
+
+		vk::PipelineLayoutCreateInfo resolvePipelineInfo;
+		resolvePipelineInfo
+			.setSetLayouts(resolveSetLayouts)
+			.setPushConstantRanges(materialIndexRange);
+		_resolvePipelineLayout = dev.createPipelineLayoutUnique(resolvePipelineInfo);
+	}
+
 	Pass::_initialize(dev);
 }
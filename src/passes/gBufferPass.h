@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include "pass.h"
+#include "cullingPass.h"
 #include "../vma.h"
 #include "../misc.h"
 #include "../shader.h"
@@ -25,9 +26,22 @@ public:
 	[[nodiscard]] vk::Image getWorldPositionBuffer() const {
 		return _worldPosBuffer.get();
 	}
+	[[nodiscard]] vk::Image getMotionVectorBuffer() const {
+		return _motionVectorBuffer.get();
+	}
+	[[nodiscard]] vk::Image getKeyBuffer() const {
+		return _keyBuffer.get();
+	}
 	[[nodiscard]] vk::Image getDepthBuffer() const {
 		return _depthBuffer.get();
 	}
+	// only exist in visibility buffer mode, and are only valid during GBufferPass
+	[[nodiscard]] vk::Image getVisibilityBuffer() const {
+		return _visibilityBuffer.get();
+	}
+	[[nodiscard]] vk::Image getMaterialDepthBuffer() const {
+		return _materialDepthBuffer.get();
+	}
 
 	[[nodiscard]] vk::ImageView getAlbedoView() const {
 		return _albedoView.get();
@@ -35,15 +49,29 @@ public:
 	[[nodiscard]] vk::ImageView getNormalView() const {
 		return _normalView.get();
 	}
+	// with the compact layout, material properties are stored with albedo and world positions are reconstructed from
+	// depth, so these two return the albedo and depth views. see gBuffer.glsl
 	[[nodiscard]] vk::ImageView getMaterialPropertiesView() const {
-		return _materialPropertiesView.get();
+		return Formats::get().compact ? _albedoView.get() : _materialPropertiesView.get();
 	}
 	[[nodiscard]] vk::ImageView getWorldPositionView() const {
-		return _worldPosView.get();
+		return Formats::get().compact ? _depthView.get() : _worldPosView.get();
+	}
+	[[nodiscard]] vk::ImageView getMotionVectorView() const {
+		return _motionVectorView.get();
+	}
+	[[nodiscard]] vk::ImageView getKeyView() const {
+		return _keyView.get();
 	}
 	[[nodiscard]] vk::ImageView getDepthView() const {
 		return _depthView.get();
 	}
+	[[nodiscard]] vk::ImageView getVisibilityView() const {
+		return _visibilityView.get();
+	}
+	[[nodiscard]] vk::ImageView getMaterialDepthView() const {
+		return _materialDepthView.get();
+	}
 
 	[[nodiscard]] vk::Framebuffer getFramebuffer() const {
 		return _framebuffer.get();
@@ -60,14 +88,25 @@ public:
 	}
 
 	struct Formats {
+		// whether to use the compact layout, see gBuffer.glsl
+		bool compact;
+		// albedo and material properties with the compact layout
 		vk::Format albedo;
 		vk::Format normal;
 		vk::Format depth;
+		// these are not used with the compact layout
 		vk::Format materialProperties;
 		vk::Format worldPosition;
+		vk::Format motionVector;
+		vk::Format key; // see packGBufferKey() in gBufferPacking.glsl
 		vk::ImageAspectFlags depthAspect;
+		// whether to rasterize a visibility buffer and resolve the G-buffer from it, see visibilityBuffer.glsl
+		bool visibilityBuffer;
+		// these are only used in visibility buffer mode
+		vk::Format visibility;
+		vk::Format materialDepth;
 
-		[[nodiscard]] static void initialize(vk::PhysicalDevice);
+		[[nodiscard]] static void initialize(vk::PhysicalDevice, bool compact, bool visibilityBuffer);
 		[[nodiscard]] static const Formats &get();
 	};
 private:
@@ -75,13 +114,21 @@ private:
 	vma::UniqueImage _normalBuffer;
 	vma::UniqueImage _materialPropertiesBuffer;
 	vma::UniqueImage _worldPosBuffer;
+	vma::UniqueImage _motionVectorBuffer;
+	vma::UniqueImage _keyBuffer;
 	vma::UniqueImage _depthBuffer;
+	vma::UniqueImage _visibilityBuffer;
+	vma::UniqueImage _materialDepthBuffer;
 
 	vk::UniqueImageView _albedoView;
 	vk::UniqueImageView _normalView;
 	vk::UniqueImageView _materialPropertiesView;
 	vk::UniqueImageView _worldPosView;
+	vk::UniqueImageView _motionVectorView;
+	vk::UniqueImageView _keyView;
 	vk::UniqueImageView _depthView;
+	vk::UniqueImageView _visibilityView;
+	vk::UniqueImageView _materialDepthView;
 
 	vk::UniqueFramebuffer _framebuffer;
 };
@@ -89,60 +136,102 @@ private:
 class GBufferPass : public Pass {
 	friend Pass;
 public:
-	struct Uniforms {
-		nvmath::mat4 projectionViewMatrix;
-	};
+	using Uniforms = shader::GBufferUniforms;
 
 	struct Resources {
-		vma::UniqueBuffer uniformBuffer;
+		// the uniforms are bound at a dynamic offset into this buffer, which is not owned by the pass
+		vk::Buffer uniformBuffer;
 		vk::UniqueDescriptorSet uniformDescriptor;
+		// these are only used when materials are bound for each draw
 		vk::UniqueDescriptorSet matrixDescriptor;
 		vk::UniqueDescriptorSet materialDescriptor;
 		std::vector<vk::UniqueDescriptorSet> materialTexturesDescriptors;
+		// only used with bindless materials
+		vk::UniqueDescriptorSet bindlessDescriptor;
 	};
 
 	GBufferPass() = default;
 
 	void issueCommands(vk::CommandBuffer, vk::Framebuffer) const override;
 
-	void onResized(vk::Device dev, vk::Extent2D extent) {
+	// the viewport and scissor are dynamic, so the pipelines don't need to be recreated
+	void onResized(vk::Extent2D extent) {
 		_bufferExtent = extent;
-		_recreatePipelines(dev);
 	}
 
-	[[nodiscard]] vk::DescriptorSetLayout getMatricesDescriptorSetLayout() const {
-		return _matricesDescriptorSetLayout.get();
+	// with bindless materials, the matrices and materials of all nodes and all textures are bound once, and shaders
+	// index them with the node index instead of the pass binding them for each draw
+	[[nodiscard]] bool hasBindlessMaterials() const {
+		return _bindlessTextureCount > 0;
 	}
+
 	[[nodiscard]] vk::DescriptorSetLayout getUniformsDescriptorSetLayout() const {
 		return _uniformsDescriptorSetLayout.get();
 	}
+	// the following three layouts are only created when materials are bound for each draw
+	[[nodiscard]] vk::DescriptorSetLayout getMatricesDescriptorSetLayout() const {
+		return _matricesDescriptorSetLayout.get();
+	}
 	[[nodiscard]] vk::DescriptorSetLayout getTexturesDescriptorSetLayout() const {
 		return _textureDescriptorSetLayout.get();
 	}
 	[[nodiscard]] vk::DescriptorSetLayout getMaterialDescriptorSetLayout() const {
 		return _materialDescriptorSetLayout.get();
 	}
+	// only created with bindless materials, see bindlessMaterials.glsl
+	[[nodiscard]] vk::DescriptorSetLayout getBindlessDescriptorSetLayout() const {
+		return _bindlessDescriptorSetLayout.get();
+	}
+	// the set that visibilityResolve.frag reads the visibility buffer and the scene from, only used in visibility
+	// buffer mode
+	[[nodiscard]] vk::DescriptorSetLayout getResolveDescriptorSetLayout() const {
+		return _resolveDescriptorSetLayout.get();
+	}
 
 	void initializeResourcesFor(const nvh::GltfScene&, const SceneBuffers&, vk::UniqueDevice&, Resources&);
+	void initializeResolveDescriptorSetFor(const GBuffer&, const SceneBuffers&, vk::Device, vk::DescriptorSet);
 
 	const nvh::GltfScene *scene = nullptr;
 	const SceneBuffers *sceneBuffers = nullptr;
 	const Resources *descriptorSets;
+	// the resolve descriptor set of the G-buffer being rendered to
+	vk::DescriptorSet resolveDescriptorSet;
+	// dynamic offset of the uniforms in Resources::uniformBuffer
+	uint32_t uniformOffset = 0;
+	// if not null, the draw commands written by CullingPass are drawn from this buffer instead of drawing every node,
+	// which requires bindless materials
+	vk::Buffer drawCommandBuffer;
 protected:
-	explicit GBufferPass(vk::Extent2D extent) : _bufferExtent(extent) {
+	// bindlessTextureCount is the size of the texture array of bindless materials, see
+	// SceneBuffers::getBindlessTextureInfo(), or 0 to bind materials for each draw
+	GBufferPass(vk::Extent2D extent, uint32_t bindlessTextureCount) :
+		_bufferExtent(extent), _bindlessTextureCount(bindlessTextureCount) {
 	}
 
 	vk::Extent2D _bufferExtent;
+	uint32_t _bindlessTextureCount = 0;
 	Shader _vert, _frag;
+	Shader _visibilityFrag, _classifyVert, _classifyFrag, _resolveVert, _resolveFrag;
+	vk::Bool32 _compact = VK_FALSE;
+	vk::SpecializationMapEntry _specializationEntry;
+	vk::SpecializationInfo _specializationInfo;
 	vk::UniqueDescriptorSetLayout _uniformsDescriptorSetLayout;
 	vk::UniqueDescriptorSetLayout _matricesDescriptorSetLayout;
 	vk::UniqueDescriptorSetLayout _materialDescriptorSetLayout;
 	vk::UniqueDescriptorSetLayout _textureDescriptorSetLayout;
+	vk::UniqueDescriptorSetLayout _bindlessDescriptorSetLayout;
+	vk::UniqueDescriptorSetLayout _resolveDescriptorSetLayout;
 	vk::UniquePipelineLayout _pipelineLayout;
+	// used by the material classification and resolve subpasses
+	vk::UniquePipelineLayout _resolvePipelineLayout;
 
 	vk::UniqueRenderPass _createPass(vk::Device) override;
 	std::vector<PipelineCreationInfo> _getPipelineCreationInfo() override;
 
+	// adds blend states for all outputs of gBufferMaterial.glsl
+	void _addGBufferBlendAttachments(GraphicsPipelineCreationInfo&) const;
+	// makes the viewport and scissor dynamic, they're set to the buffer extent in issueCommands()
+	void _setViewportState(GraphicsPipelineCreationInfo&) const;
 
 	void _initialize(vk::Device dev) override;
 };
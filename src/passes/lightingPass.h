@@ -4,6 +4,7 @@
 #include "gBufferPass.h"
 #include "shaderIncludes.h"
 #include "../aabbTreeBuilder.h"
+#include "../restirShaderConfig.h"
 #include "../shaders/include/gBufferDebugConstants.glsl"
 
 class LightingPass : public Pass {
@@ -33,7 +34,7 @@ public:
 		commandBuffer.setScissor(0, { vk::Rect2D(vk::Offset2D(0, 0), imageExtent) });
 
 		commandBuffer.bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics, _pipelineLayout.get(), 0, descriptorSet, {}
+			vk::PipelineBindPoint::eGraphics, _pipelineLayout.get(), 0, descriptorSet, uniformOffset
 		);
 		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getPipelines()[0].get());
 		commandBuffer.draw(4, 1, 0, 0);
@@ -74,7 +75,7 @@ public:
 		descriptorWrite.emplace_back()
 			.setDstSet(set)
 			.setDstBinding(4)
-			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 			.setBufferInfo(uniformInfo);
 		descriptorWrite.emplace_back()
 			.setDstSet(set)
@@ -95,13 +96,28 @@ public:
 		device.updateDescriptorSets(descriptorWrite, {});
 	}
 
+	// only the reservoir and G-buffer layouts affect this pass
+	void setShaderConfig(vk::Device dev, const RestirShaderConfig &config) {
+		_config = config;
+		std::string variant = _getVariantName();
+		if (!_hasPipelineVariant(variant)) {
+			_loadShaders(dev);
+		}
+		_switchPipelineVariant(dev, variant);
+	}
+
 	vk::Extent2D imageExtent;
 	vk::DescriptorSet descriptorSet;
+	// dynamic offset of the uniforms
+	uint32_t uniformOffset = 0;
 protected:
 	explicit LightingPass(vk::Format format) : Pass(), _swapchainFormat(format) {
 	}
 
 	Shader _vert, _frag;
+	RestirShaderConfig _config;
+	RestirShaderConfig::Specialization _specialization;
+	vk::SpecializationInfo _specializationInfo;
 	vk::Format _swapchainFormat;
 	vk::UniqueSampler _sampler;
 	vk::UniquePipelineLayout _pipelineLayout;
@@ -158,7 +174,9 @@ protected:
 		info.multisampleState = GraphicsPipelineCreationInfo::getNoMultisampleState();
 		info.attachmentColorBlendStorage.emplace_back(GraphicsPipelineCreationInfo::getNoBlendAttachment());
 		info.colorBlendState.setAttachments(info.attachmentColorBlendStorage);
-		info.shaderStages.emplace_back(_frag.getStageInfo());
+		_specialization = _config.getSpecialization();
+		_specializationInfo = _specialization.getInfo();
+		info.shaderStages.emplace_back(_frag.getStageInfo()).setPSpecializationInfo(&_specializationInfo);
 		info.shaderStages.emplace_back(_vert.getStageInfo());
 		info.dynamicStates.emplace_back(vk::DynamicState::eViewport);
 		info.dynamicStates.emplace_back(vk::DynamicState::eScissor);
@@ -167,9 +185,17 @@ protected:
 
 		return result;
 	}
+	[[nodiscard]] std::string _getVariantName() const {
+		return _config.getReservoirLayoutName() + (_config.compactGBuffer ? ".cg" : "");
+	}
+	void _loadShaders(vk::Device dev) {
+		_frag = Shader::load(dev, _config.getShaderPath("lighting.frag"), "main", vk::ShaderStageFlagBits::eFragment);
+	}
+
 	void _initialize(vk::Device dev) override {
 		_vert = Shader::load(dev, "shaders/quad.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
-		_frag = Shader::load(dev, "shaders/lighting.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+		_loadShaders(dev);
+		_pipelineVariant = _getVariantName();
 
 		_sampler = createSampler(dev, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
 
@@ -178,7 +204,7 @@ protected:
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
 			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
 			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
-			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eFragment),
 			vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
 			vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
 			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment)
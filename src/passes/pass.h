@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <string>
 #include <variant>
 
 #include <vulkan/vulkan.hpp>
@@ -117,6 +119,10 @@ public:
 		static_cast<Pass*>(&pass)->_initialize(dev);
 		return std::move(pass);
 	}
+
+	// the cache that all pipelines are created with, which may be null. passes create their pipelines on multiple
+	// threads, which is fine since pipeline caches are internally synchronized
+	inline static vk::PipelineCache pipelineCache;
 protected:
 	Pass() = default;
 
@@ -149,36 +155,66 @@ protected:
 			.setPDynamicState(&dynamicStateInfo)
 			.setRenderPass(_pass.get())
 			.setSubpass(subpass);
-		auto [result, pipe] = dev.createGraphicsPipelineUnique(nullptr, thisPipelineInfo).asTuple();
+		auto [result, pipe] = dev.createGraphicsPipelineUnique(pipelineCache, thisPipelineInfo).asTuple();
 		vkCheck(result);
 		return std::move(pipe);
 	}
 	[[nodiscard]] virtual std::vector<vk::UniquePipeline> _createPipelines(vk::Device dev) {
 		std::vector<PipelineCreationInfo> pipelineInfo = _getPipelineCreationInfo();
 		std::vector<vk::UniquePipeline> pipelines(pipelineInfo.size());
+		std::vector<std::function<void()>> tasks;
 		for (std::size_t i = 0; i < pipelineInfo.size(); ++i) {
-			if (std::holds_alternative<GraphicsPipelineCreationInfo>(pipelineInfo[i])) {
-				pipelines[i] = _createGraphicsPipeline(
-					std::get<GraphicsPipelineCreationInfo>(pipelineInfo[i]), static_cast<uint32_t>(i), dev
-				);
-			} else if (std::holds_alternative<vk::ComputePipelineCreateInfo>(pipelineInfo[i])) {
-				const auto &info = std::get<vk::ComputePipelineCreateInfo>(pipelineInfo[i]);
-				auto [result, pipe] = dev.createComputePipelineUnique(nullptr, info);
-				vkCheck(result);
-				pipelines[i] = std::move(pipe);
-			}
+			tasks.emplace_back([&, i]() {
+				if (std::holds_alternative<GraphicsPipelineCreationInfo>(pipelineInfo[i])) {
+					pipelines[i] = _createGraphicsPipeline(
+						std::get<GraphicsPipelineCreationInfo>(pipelineInfo[i]), static_cast<uint32_t>(i), dev
+					);
+				} else if (std::holds_alternative<vk::ComputePipelineCreateInfo>(pipelineInfo[i])) {
+					const auto &info = std::get<vk::ComputePipelineCreateInfo>(pipelineInfo[i]);
+					auto [result, pipe] = dev.createComputePipelineUnique(pipelineCache, info);
+					vkCheck(result);
+					pipelines[i] = std::move(pipe);
+				}
+			});
 		}
+		runInParallel(tasks);
 		return pipelines;
 	}
-	void _recreatePipelines(vk::Device dev) {
+	// discards the pipelines of all variants. derived classes that cache pipelines of their own must clear them too
+	virtual void _recreatePipelines(vk::Device dev) {
 		_pipelines.clear();
+		_pipelineVariants.clear();
 		_pipelines = _createPipelines(dev);
 	}
+	// Pipelines are cached for every variant that has been used, so that switching variants at runtime only creates
+	// pipelines the first time a variant is used. What a variant contains is up to the derived class, which must make
+	// _createPipelines() create the pipelines of the variant being switched to.
+	[[nodiscard]] bool _hasPipelineVariant(const std::string &variant) const {
+		return variant == _pipelineVariant || _pipelineVariants.contains(variant);
+	}
+	void _switchPipelineVariant(vk::Device dev, const std::string &variant) {
+		if (variant == _pipelineVariant) {
+			return;
+		}
+		_pipelineVariants[_pipelineVariant] = std::move(_pipelines);
+		if (auto it = _pipelineVariants.find(variant); it != _pipelineVariants.end()) {
+			_pipelines = std::move(it->second);
+			_pipelineVariants.erase(it);
+		} else {
+			_pipelines = _createPipelines(dev);
+		}
+		_pipelineVariant = variant;
+	}
 	virtual void _initialize(vk::Device dev) {
 		_pass = _createPass(dev);
 		_pipelines = _createPipelines(dev);
 	}
+
+	// the variant that the current pipelines belong to. derived classes that use variants should set this before the
+	// initial pipelines are created
+	std::string _pipelineVariant;
 private:
 	vk::UniqueRenderPass _pass;
 	std::vector<vk::UniquePipeline> _pipelines;
+	std::map<std::string, std::vector<vk::UniquePipeline>> _pipelineVariants;
 };
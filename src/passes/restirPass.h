@@ -4,6 +4,7 @@
 
 #include "pass.h"
 #include "vma.h"
+#include "../restirShaderConfig.h"
 
 class RestirPass : public Pass {
 	friend Pass;
@@ -33,31 +34,34 @@ public:
 		}
 	}
 
-	void issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer) const override {
-		commandBuffer.pipelineBarrier(
-			vk::PipelineStageFlagBits::eAllCommands,
-			vk::PipelineStageFlagBits::eAllCommands,
-			{}, {}, {}, {}
+	// fills the light tile buffer, which needs to be done before issueCommands() if light tiles are used
+	void issueLightTileCommands(vk::CommandBuffer commandBuffer) const {
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, getPipelines()[1].get());
+		commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eCompute, _swPipelineLayout.get(), 0, { staticDescriptorSet }, { uniformOffset }
 		);
-
+		commandBuffer.dispatch(ceilDiv<uint32_t>(LIGHT_TILE_COUNT * LIGHT_TILE_SIZE, LIGHT_TILE_GROUP_SIZE_X), 1, 1);
+	}
+	void issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer) const override {
+		vk::Extent2D gridSize = _config.getReservoirGridSize(bufferExtent);
 		if (useSoftwareRayTracing) {
 			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, getPipelines()[0].get());
 			commandBuffer.bindDescriptorSets(
 				vk::PipelineBindPoint::eCompute, _swPipelineLayout.get(), 0,
-				{ staticDescriptorSet, frameDescriptorSet, raytraceDescriptorSet }, {}
+				{ staticDescriptorSet, frameDescriptorSet, raytraceDescriptorSet }, { uniformOffset }
 			);
 			commandBuffer.dispatch(
-				ceilDiv<uint32_t>(bufferExtent.width, OMNI_GROUP_SIZE_X),
-				ceilDiv<uint32_t>(bufferExtent.height, OMNI_GROUP_SIZE_Y),
+				ceilDiv<uint32_t>(gridSize.width, _config.groupSizeX),
+				ceilDiv<uint32_t>(gridSize.height, _config.groupSizeY),
 				1
 			);
 		} else {
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, _hwRayTracePipeline.get());
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, _getHardwareRayTracePipeline());
 			commandBuffer.bindDescriptorSets(
 				vk::PipelineBindPoint::eRayTracingKHR, _hwPipelineLayout.get(), 0,
-				{ staticDescriptorSet, frameDescriptorSet, raytraceDescriptorSet }, {}
+				{ staticDescriptorSet, frameDescriptorSet, raytraceDescriptorSet }, { uniformOffset }
 			);
-			commandBuffer.traceRaysKHR(rayGenSBT, rayMissSBT, rayHitSBT, rayCallSBT, bufferExtent.width, bufferExtent.height, 1, *dynamicLoader);
+			commandBuffer.traceRaysKHR(rayGenSBT, rayMissSBT, rayHitSBT, rayCallSBT, gridSize.width, gridSize.height, 1, *dynamicLoader);
 		}
 	}
 
@@ -117,15 +121,32 @@ public:
 	}
 
 
+	// the shader binding table needs to be recreated after this
+	void setShaderConfig(vk::Device dev, const RestirShaderConfig &config) {
+		_config = config;
+		std::string variant = _config.getVariantName();
+		if (!_hasPipelineVariant(variant)) {
+			_loadShaders(dev);
+		}
+		_switchPipelineVariant(dev, variant);
+	}
+
+	[[nodiscard]] constexpr static vk::DeviceSize getLightTileBufferSize() {
+		return sizeof(shader::LightTileSample) * LIGHT_TILE_COUNT * LIGHT_TILE_SIZE;
+	}
+
 	void initializeStaticDescriptorSetFor(
-		const SceneBuffers& scene, vk::Buffer uniformBuffer, vk::Device device, vk::DescriptorSet set
+		const SceneBuffers& scene, vk::Buffer uniformBuffer, vk::Buffer lightTileBuffer,
+		vk::Device device, vk::DescriptorSet set
 	) {
-		std::array<vk::WriteDescriptorSet, 4> writes;
+		std::array<vk::WriteDescriptorSet, 6> writes;
 
 		vk::DescriptorBufferInfo pointLightBuffer(scene.getPtLights(), 0, scene.getPtLightsBufferSize());
 		vk::DescriptorBufferInfo triangleLightBuffer(scene.getTriLights(), 0, scene.getTriLightsBufferSize());
 		vk::DescriptorBufferInfo aliasTableBufferInfo(scene.getAliasTable(), 0, scene.getAliasTableBufferSize());
 		vk::DescriptorBufferInfo uniformBufferInfo(uniformBuffer, 0, sizeof(shader::RestirUniforms));
+		vk::DescriptorBufferInfo lightBvhBufferInfo(scene.getLightBvh(), 0, scene.getLightBvhBufferSize());
+		vk::DescriptorBufferInfo lightTileBufferInfo(lightTileBuffer, 0, getLightTileBufferSize());
 
 		writes[0]
 			.setDstSet(set)
@@ -146,8 +167,18 @@ public:
 		writes[3]
 			.setDstSet(set)
 			.setDstBinding(3)
-			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 			.setBufferInfo(uniformBufferInfo);
+		writes[4]
+			.setDstSet(set)
+			.setDstBinding(4)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(lightBvhBufferInfo);
+		writes[5]
+			.setDstSet(set)
+			.setDstBinding(5)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(lightTileBufferInfo);
 
 		device.updateDescriptorSets(writes, {});
 	}
@@ -165,10 +196,9 @@ public:
 			vk::DescriptorImageInfo(_sampler.get(), gbuffer.getNormalView(), vk::ImageLayout::eShaderReadOnlyOptimal),
 			vk::DescriptorImageInfo(_sampler.get(), gbuffer.getMaterialPropertiesView(), vk::ImageLayout::eShaderReadOnlyOptimal),
 
-			vk::DescriptorImageInfo(_sampler.get(), prevFrameGBuffer.getWorldPositionView(), vk::ImageLayout::eShaderReadOnlyOptimal),
-			vk::DescriptorImageInfo(_sampler.get(), prevFrameGBuffer.getAlbedoView(), vk::ImageLayout::eShaderReadOnlyOptimal),
-			vk::DescriptorImageInfo(_sampler.get(), prevFrameGBuffer.getNormalView(), vk::ImageLayout::eShaderReadOnlyOptimal),
-			vk::DescriptorImageInfo(_sampler.get(), prevFrameGBuffer.getDepthView(), vk::ImageLayout::eShaderReadOnlyOptimal)
+			vk::DescriptorImageInfo(_sampler.get(), gbuffer.getMotionVectorView(), vk::ImageLayout::eShaderReadOnlyOptimal),
+			vk::DescriptorImageInfo(_sampler.get(), gbuffer.getKeyView(), vk::ImageLayout::eShaderReadOnlyOptimal),
+			vk::DescriptorImageInfo(_sampler.get(), prevFrameGBuffer.getKeyView(), vk::ImageLayout::eShaderReadOnlyOptimal)
 		};
 
 		vk::DescriptorBufferInfo prevReservoirInfo(prevFrameReservoirBuffer, 0, reservoirBufferSize);
@@ -266,7 +296,7 @@ public:
 		uint8_t* dstData = _shaderBindingTable.mapAs<uint8_t>();
 		std::vector<uint8_t> shaderHandleStorage(shaderBindingTableSize);
 		vk::Result res = dev.getRayTracingShaderGroupHandlesKHR(
-			_hwRayTracePipeline.get(), 0, shaderGroupSize, shaderBindingTableSize, shaderHandleStorage.data(), *dynamicLoader
+			_getHardwareRayTracePipeline(), 0, shaderGroupSize, shaderBindingTableSize, shaderHandleStorage.data(), *dynamicLoader
 		);
 		vkCheck(res);
 
@@ -313,15 +343,22 @@ public:
 	vk::DescriptorSet staticDescriptorSet;
 	vk::DescriptorSet frameDescriptorSet;
 	vk::DescriptorSet raytraceDescriptorSet;
+	// dynamic offset of the uniforms bound through the static descriptor set
+	uint32_t uniformOffset = 0;
 
 	vk::Extent2D bufferExtent;
 	const vk::DispatchLoaderDynamic *dynamicLoader = nullptr;
 	bool useSoftwareRayTracing = false;
 protected:
-	explicit RestirPass(const vk::DispatchLoaderDynamic &loader) : Pass(), dynamicLoader(&loader) {
+	// hardware ray tracing pipelines and layouts are only created if hardwareRayTracing is true
+	RestirPass(const vk::DispatchLoaderDynamic &loader, bool hardwareRayTracing) :
+		Pass(), dynamicLoader(&loader), _hardwareRayTracing(hardwareRayTracing) {
 	}
 
-	Shader _rayGen, _rayChit, _rayMiss, _rayShadowMiss, _software;
+	bool _hardwareRayTracing = false;
+
+	Shader _rayGen, _rayChit, _rayMiss, _rayShadowMiss, _software, _lightTiles;
+	RestirShaderConfig _config;
 
 	vk::UniqueSampler _sampler;
 	vk::UniquePipelineLayout _hwPipelineLayout;
@@ -330,7 +367,18 @@ protected:
 	vk::UniqueDescriptorSetLayout _frameDescriptorSetLayout;
 	vk::UniqueDescriptorSetLayout _hwRayTraceDescriptorSetLayout;
 	vk::UniqueDescriptorSetLayout _swRayTraceDescriptorSetLayout;
-	vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic> _hwRayTracePipeline;
+	// hardware ray tracing pipelines of all variants, see Pass::_switchPipelineVariant()
+	std::map<std::string, vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic>> _hwRayTracePipelines;
+
+	[[nodiscard]] vk::Pipeline _getHardwareRayTracePipeline() const {
+		return _hwRayTracePipelines.at(_pipelineVariant).get();
+	}
+
+	void _recreatePipelines(vk::Device dev) override {
+		// cleared first, since _createPipelines() adds the pipeline of the current variant
+		_hwRayTracePipelines.clear();
+		Pass::_recreatePipelines(dev);
+	}
 
 	[[nodiscard]] vk::UniqueRenderPass _createPass(vk::Device) override {
 		return {};
@@ -341,38 +389,101 @@ protected:
 	}
 
 	[[nodiscard]] std::vector<vk::UniquePipeline> _createPipelines(vk::Device dev) override {
-		std::vector<vk::UniquePipeline> pipelines;
+		std::vector<vk::UniquePipeline> pipelines(2);
+		vk::UniquePipeline hwPipeline;
+
+		RestirShaderConfig::Specialization specialization = _config.getSpecialization();
+		vk::SpecializationInfo specializationInfo = specialization.getInfo();
+
+		std::vector<std::function<void()>> tasks;
+		tasks.emplace_back([&]() { // compute pipeline
+			vk::PipelineShaderStageCreateInfo stageInfo = _software.getStageInfo();
+			stageInfo.setPSpecializationInfo(&specializationInfo);
 
-		{ // compute pipeline
 			vk::ComputePipelineCreateInfo pipelineInfo;
 			pipelineInfo
-				.setStage(_software.getStageInfo())
+				.setStage(stageInfo)
 				.setLayout(_swPipelineLayout.get());
-			auto [res, pipeline] = dev.createComputePipelineUnique(nullptr, pipelineInfo);
+			auto [res, pipeline] = dev.createComputePipelineUnique(pipelineCache, pipelineInfo);
 			vkCheck(res);
-			pipelines.emplace_back(std::move(pipeline));
+			pipelines[0] = std::move(pipeline);
+		});
+		tasks.emplace_back([&]() { // light tiles pipeline
+			vk::ComputePipelineCreateInfo pipelineInfo;
+			pipelineInfo
+				.setStage(_lightTiles.getStageInfo())
+				.setLayout(_swPipelineLayout.get());
+			auto [res, pipeline] = dev.createComputePipelineUnique(pipelineCache, pipelineInfo);
+			vkCheck(res);
+			pipelines[1] = std::move(pipeline);
+		});
+
+		if (_hardwareRayTracing) {
+			tasks.emplace_back([&]() { // ray tracing pipeline
+				std::vector<vk::RayTracingShaderGroupCreateInfoKHR> shaderGroups;
+				shaderGroups.emplace_back(getRtGenShaderGroupCreate());
+				shaderGroups.emplace_back(getRtHitShaderGroupCreate());
+				shaderGroups.emplace_back(getRtMissShaderGroupCreate());
+				shaderGroups.emplace_back(getRtShadowMissShaderGroupCreate());
+
+				std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
+				shaderStages.emplace_back(_rayGen.getStageInfo()).setPSpecializationInfo(&specializationInfo);
+				shaderStages.emplace_back(_rayChit.getStageInfo());
+				shaderStages.emplace_back(_rayMiss.getStageInfo());
+				shaderStages.emplace_back(_rayShadowMiss.getStageInfo());
+
+				vk::RayTracingPipelineCreateInfoKHR rtPipelineInfo;
+				rtPipelineInfo
+					.setStages(shaderStages)
+					.setGroups(shaderGroups)
+					.setMaxPipelineRayRecursionDepth(1)
+					.setLayout(_hwPipelineLayout.get());
+				auto [res, pipeline] = dev.createRayTracingPipelineKHRUnique(
+					nullptr, pipelineCache, rtPipelineInfo, nullptr, *dynamicLoader
+				);
+				vkCheck(res);
+				hwPipeline = std::move(pipeline);
+			});
 		}
 
+		runInParallel(tasks);
+		if (_hardwareRayTracing) {
+			_hwRayTracePipelines[_config.getVariantName()] = std::move(hwPipeline);
+		}
 		return pipelines;
 	}
 
+	void _loadShaders(vk::Device dev) {
+		if (_hardwareRayTracing) {
+			_rayGen = Shader::load(dev, _config.getShaderPath("restirOmniHardware.rgen"), "main", vk::ShaderStageFlagBits::eRaygenKHR);
+		}
+		_software = Shader::load(dev, _config.getShaderPath("restirOmniSoftware.comp"), "main", vk::ShaderStageFlagBits::eCompute);
+	}
+
 	void _initialize(vk::Device dev) override {
-		constexpr vk::ShaderStageFlags stageFlags = vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eCompute;
+		vk::ShaderStageFlags stageFlags = vk::ShaderStageFlagBits::eCompute;
+		if (_hardwareRayTracing) {
+			stageFlags |= vk::ShaderStageFlagBits::eRaygenKHR;
+		}
 
 		_sampler = createSampler(dev, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
 
-		_rayGen = Shader::load(dev, "shaders/restirOmniHardware.rgen.spv", "main", vk::ShaderStageFlagBits::eRaygenKHR);
-		_rayChit = Shader::load(dev, "shaders/hwVisibilityTest.rchit.spv", "main", vk::ShaderStageFlagBits::eClosestHitKHR);
-		_rayMiss = Shader::load(dev, "shaders/hwVisibilityTest.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
-		_rayShadowMiss = Shader::load(dev, "shaders/hwVisibilityTestShadow.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
-		_software = Shader::load(dev, "shaders/restirOmniSoftware.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+		_loadShaders(dev);
+		if (_hardwareRayTracing) {
+			_rayChit = Shader::load(dev, "shaders/hwVisibilityTest.rchit.spv", "main", vk::ShaderStageFlagBits::eClosestHitKHR);
+			_rayMiss = Shader::load(dev, "shaders/hwVisibilityTest.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
+			_rayShadowMiss = Shader::load(dev, "shaders/hwVisibilityTestShadow.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
+		}
+		_lightTiles = Shader::load(dev, "shaders/lightTiles.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
 
 
-		std::array<vk::DescriptorSetLayoutBinding, 4> staticBindings{
+		std::array<vk::DescriptorSetLayoutBinding, 6> staticBindings{
 			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
-			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eUniformBuffer, 1, stageFlags)
+			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eUniformBufferDynamic, 1, stageFlags),
+			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
+			vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, stageFlags)
 		};
 
 		vk::DescriptorSetLayoutCreateInfo staticLayoutInfo;
@@ -380,7 +491,7 @@ protected:
 		_staticDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(staticLayoutInfo);
 
 
-		std::array<vk::DescriptorSetLayoutBinding, 10> frameBindings{
+		std::array<vk::DescriptorSetLayoutBinding, 9> frameBindings{
 			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
@@ -388,9 +499,8 @@ protected:
 			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
-			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
-			vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
-			vk::DescriptorSetLayoutBinding(9, vk::DescriptorType::eStorageBuffer, 1, stageFlags)
+			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
+			vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer, 1, stageFlags)
 		};
 
 		vk::DescriptorSetLayoutCreateInfo frameDescriptorInfo;
@@ -398,22 +508,6 @@ protected:
 		_frameDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(frameDescriptorInfo);
 
 
-		// Acceleration structure descriptor binding
-		vk::DescriptorSetLayoutBinding accelerationStructureLayoutBinding;
-		accelerationStructureLayoutBinding.binding = 0;
-		accelerationStructureLayoutBinding.descriptorType = vk::DescriptorType::eAccelerationStructureKHR;
-		accelerationStructureLayoutBinding.descriptorCount = 1;
-		accelerationStructureLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eRaygenKHR;
-
-		std::array<vk::DescriptorSetLayoutBinding, 1> hwRayTraceBindings{
-			accelerationStructureLayoutBinding
-		};
-
-		vk::DescriptorSetLayoutCreateInfo hwRayTraceLayoutInfo;
-		hwRayTraceLayoutInfo.setBindings(hwRayTraceBindings);
-		_hwRayTraceDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(hwRayTraceLayoutInfo);
-
-
 		std::array<vk::DescriptorSetLayoutBinding, 2> swRayTraceBindings{
 			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
@@ -423,13 +517,32 @@ protected:
 		_swRayTraceDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(swRayTraceLayoutInfo);
 
 
-		std::array<vk::DescriptorSetLayout, 3> hwDescriptorLayouts{
-			_staticDescriptorSetLayout.get(), _frameDescriptorSetLayout.get(), _hwRayTraceDescriptorSetLayout.get()
-		};
+		if (_hardwareRayTracing) {
+			// Acceleration structure descriptor binding
+			vk::DescriptorSetLayoutBinding accelerationStructureLayoutBinding;
+			accelerationStructureLayoutBinding.binding = 0;
+			accelerationStructureLayoutBinding.descriptorType = vk::DescriptorType::eAccelerationStructureKHR;
+			accelerationStructureLayoutBinding.descriptorCount = 1;
+			accelerationStructureLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eRaygenKHR;
+
+			std::array<vk::DescriptorSetLayoutBinding, 1> hwRayTraceBindings{
+				accelerationStructureLayoutBinding
+			};
+
+			vk::DescriptorSetLayoutCreateInfo hwRayTraceLayoutInfo;
+			hwRayTraceLayoutInfo.setBindings(hwRayTraceBindings);
+			_hwRayTraceDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(hwRayTraceLayoutInfo);
+
+
+			std::array<vk::DescriptorSetLayout, 3> hwDescriptorLayouts{
+				_staticDescriptorSetLayout.get(), _frameDescriptorSetLayout.get(), _hwRayTraceDescriptorSetLayout.get()
+			};
+
+			vk::PipelineLayoutCreateInfo hwPipelineLayoutInfo;
+			hwPipelineLayoutInfo.setSetLayouts(hwDescriptorLayouts);
+			_hwPipelineLayout = dev.createPipelineLayoutUnique(hwPipelineLayoutInfo);
+		}
 
-		vk::PipelineLayoutCreateInfo hwPipelineLayoutInfo;
-		hwPipelineLayoutInfo.setSetLayouts(hwDescriptorLayouts);
-		_hwPipelineLayout = dev.createPipelineLayoutUnique(hwPipelineLayoutInfo);
 
 		std::array<vk::DescriptorSetLayout, 3> swDescriptorLayouts{
 			_staticDescriptorSetLayout.get(), _frameDescriptorSetLayout.get(), _swRayTraceDescriptorSetLayout.get()
@@ -440,33 +553,7 @@ protected:
 		_swPipelineLayout = dev.createPipelineLayoutUnique(swPipelineLayoutInfo);
 
 
-#ifndef RENDERDOC_CAPTURE
-		{ // create ray tracing pipeline
-			std::vector<vk::RayTracingShaderGroupCreateInfoKHR> shaderGroups;
-			shaderGroups.emplace_back(getRtGenShaderGroupCreate());
-			shaderGroups.emplace_back(getRtHitShaderGroupCreate());
-			shaderGroups.emplace_back(getRtMissShaderGroupCreate());
-			shaderGroups.emplace_back(getRtShadowMissShaderGroupCreate());
-
-			std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
-			shaderStages.emplace_back(_rayGen.getStageInfo());
-			shaderStages.emplace_back(_rayChit.getStageInfo());
-			shaderStages.emplace_back(_rayMiss.getStageInfo());
-			shaderStages.emplace_back(_rayShadowMiss.getStageInfo());
-
-			vk::RayTracingPipelineCreateInfoKHR rtPipelineInfo;
-			rtPipelineInfo
-				.setStages(shaderStages)
-				.setGroups(shaderGroups)
-				.setMaxPipelineRayRecursionDepth(1)
-				.setLayout(_hwPipelineLayout.get());
-			auto [res, pipeline] = dev.createRayTracingPipelineKHRUnique(nullptr, nullptr, rtPipelineInfo, nullptr, *dynamicLoader);
-			vkCheck(res);
-			_hwRayTracePipeline = std::move(pipeline);
-		}
-#endif
-
-
+		_pipelineVariant = _config.getVariantName();
 		Pass::_initialize(dev);
 	}
 private:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "pass.h"
+#include "../restirShaderConfig.h"
 
 class SpatialReusePass : public Pass {
 public:
@@ -9,29 +10,34 @@ public:
 	}
 
 	void issueCommands(vk::CommandBuffer buffer, vk::Framebuffer) const override {
-		buffer.pipelineBarrier(
-			vk::PipelineStageFlagBits::eComputeShader,
-			vk::PipelineStageFlagBits::eComputeShader,
-			{}, {}, {}, {}
-		);
 		buffer.bindPipeline(vk::PipelineBindPoint::eCompute, getPipelines()[0].get());
-		buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _layout.get(), 0, { descriptorSet }, {});
+		buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _layout.get(), 0, { descriptorSet }, { uniformOffset });
 		std::array<const int, 1> iterations = { iter };
 		buffer.pushConstants(_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(int), &iterations[0]);
+		vk::Extent2D gridSize = _config.getReservoirGridSize(screenSize);
 		buffer.dispatch(
-			ceilDiv<uint32_t>(screenSize.width, LIGHT_SAMPLE_GROUP_SIZE_X),
-			ceilDiv<uint32_t>(screenSize.height, LIGHT_SAMPLE_GROUP_SIZE_Y),
+			ceilDiv<uint32_t>(gridSize.width, _config.groupSizeX),
+			ceilDiv<uint32_t>(gridSize.height, _config.groupSizeY),
 			1
 		);
 	}
 
+	void setShaderConfig(vk::Device dev, const RestirShaderConfig &config) {
+		_config = config;
+		std::string variant = _config.getVariantName();
+		if (!_hasPipelineVariant(variant)) {
+			_loadShaders(dev);
+		}
+		_switchPipelineVariant(dev, variant);
+	}
+
 	void initializeDescriptorSetFor(
-		const GBuffer& gbuffer,  vk::Buffer uniformBuffer,
+		const GBuffer& gbuffer, const SceneBuffers &scene, vk::Buffer uniformBuffer,
 		vk::Buffer reservoirBuffer, vk::DeviceSize reservoirBufferSize,
 		vk::Buffer resultReservoirBuffer,
 		vk::Device device, vk::DescriptorSet set
 	) {
-		std::array<vk::WriteDescriptorSet, 8> writes;
+		std::array<vk::WriteDescriptorSet, 10> writes;
 
 		// currently no world position buffer, so use depth as a placeholder
 		vk::DescriptorBufferInfo uniformInfo(uniformBuffer, 0, sizeof(shader::RestirUniforms));
@@ -42,11 +48,13 @@ public:
 		vk::DescriptorImageInfo depthImageInfo(_sampler.get(), gbuffer.getDepthView(), vk::ImageLayout::eShaderReadOnlyOptimal);
 		vk::DescriptorBufferInfo reservoirInfo(reservoirBuffer, 0, reservoirBufferSize);
 		vk::DescriptorBufferInfo resultReservoirInfo(resultReservoirBuffer, 0, reservoirBufferSize);
+		vk::DescriptorBufferInfo pointLightsInfo(scene.getPtLights(), 0, scene.getPtLightsBufferSize());
+		vk::DescriptorBufferInfo triLightsInfo(scene.getTriLights(), 0, scene.getTriLightsBufferSize());
 
 		writes[0]
 			.setDstSet(set)
 			.setDstBinding(0)
-			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 			.setBufferInfo(uniformInfo);
 		writes[1]
 			.setDstSet(set)
@@ -83,16 +91,31 @@ public:
 			.setDstBinding(7)
 			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
 			.setBufferInfo(resultReservoirInfo);
+		writes[8]
+			.setDstSet(set)
+			.setDstBinding(8)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(pointLightsInfo);
+		writes[9]
+			.setDstSet(set)
+			.setDstBinding(9)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(triLightsInfo);
 
 
 		device.updateDescriptorSets(writes, {});
 	}
 
 	vk::DescriptorSet descriptorSet;
+	// dynamic offset of the uniforms
+	uint32_t uniformOffset = 0;
 	vk::Extent2D screenSize;
 	int iter;
 protected:
 	Shader _shader;
+	RestirShaderConfig _config;
+	RestirShaderConfig::Specialization _specialization;
+	vk::SpecializationInfo _specializationInfo;
 	vk::UniqueDescriptorSetLayout _descriptorLayout;
 	vk::UniquePipelineLayout _layout;
 	vk::UniqueSampler _sampler;
@@ -104,29 +127,41 @@ protected:
 	std::vector<PipelineCreationInfo> _getPipelineCreationInfo() override {
 		std::vector<PipelineCreationInfo> result;
 
+		_specialization = _config.getSpecialization();
+		_specializationInfo = _specialization.getInfo();
+		vk::PipelineShaderStageCreateInfo stageInfo = _shader.getStageInfo();
+		stageInfo.setPSpecializationInfo(&_specializationInfo);
+
 		vk::ComputePipelineCreateInfo pipelineInfo;
 		pipelineInfo
-			.setStage(_shader.getStageInfo())
+			.setStage(stageInfo)
 			.setLayout(_layout.get());
 		result.emplace_back(pipelineInfo);
 
 		return result;
 	}
 
+	void _loadShaders(vk::Device dev) {
+		_shader = Shader::load(dev, _config.getShaderPath("spatialReuse.comp"), "main", vk::ShaderStageFlagBits::eCompute);
+	}
+
 	void _initialize(vk::Device dev) override {
-		_shader = Shader::load(dev, "shaders/spatialReuse.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+		_loadShaders(dev);
+		_pipelineVariant = _config.getVariantName();
 
 		_sampler = createSampler(dev, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
 
-		std::array<vk::DescriptorSetLayoutBinding, 8> bindings{
-			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+		std::array<vk::DescriptorSetLayoutBinding, 10> bindings{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
-			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+			vk::DescriptorSetLayoutBinding(9, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
 		};
 
 		vk::DescriptorSetLayoutCreateInfo descriptorInfo;
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <map>
+#include <string>
+
 #include <vulkan/vulkan.hpp>
 
 #include "vma.h"
+#include "pass.h"
+#include "../restirShaderConfig.h"
 
 class UnbiasedReusePass {
 public:
@@ -21,30 +26,25 @@ public:
 	}
 
 	void issueCommands(vk::CommandBuffer commandBuffer, vk::DispatchLoaderDynamic dld) {
-		commandBuffer.pipelineBarrier(
-			vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader,
-			vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader,
-			{}, {}, {}, {}
-		);
-
+		vk::Extent2D gridSize = _config.getReservoirGridSize(bufferExtent);
 		if (useSoftwareRayTracing) {
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _softwarePipeline.get());
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _getPipelines().software.get());
 			commandBuffer.bindDescriptorSets(
 				vk::PipelineBindPoint::eCompute, _swPipelineLayout.get(), 0,
-				{ frameDescriptorSet, raytraceDescriptorSet }, {}
+				{ frameDescriptorSet, raytraceDescriptorSet }, { uniformOffset }
 			);
 			commandBuffer.dispatch(
-				ceilDiv<uint32_t>(bufferExtent.width, UNBIASED_REUSE_GROUP_SIZE_X),
-				ceilDiv<uint32_t>(bufferExtent.height, UNBIASED_REUSE_GROUP_SIZE_Y),
+				ceilDiv<uint32_t>(gridSize.width, _config.groupSizeX),
+				ceilDiv<uint32_t>(gridSize.height, _config.groupSizeY),
 				1
 			);
 		} else {
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, _hwRaytracePipeline.get());
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, _getPipelines().hardware.get());
 			commandBuffer.bindDescriptorSets(
 				vk::PipelineBindPoint::eRayTracingKHR, _hwPipelineLayout.get(), 0,
-				{ frameDescriptorSet, raytraceDescriptorSet }, {}
+				{ frameDescriptorSet, raytraceDescriptorSet }, { uniformOffset }
 			);
-			commandBuffer.traceRaysKHR(rayGenSBT, rayMissSBT, rayHitSBT, rayCallSBT, bufferExtent.width, bufferExtent.height, 1, dld);
+			commandBuffer.traceRaysKHR(rayGenSBT, rayMissSBT, rayHitSBT, rayCallSBT, gridSize.width, gridSize.height, 1, dld);
 		}
 	}
 
@@ -110,11 +110,11 @@ public:
 
 	void initializeFrameDescriptorSet(
 		vk::Device dev,
-		const GBuffer& gbuffer, vk::Buffer uniformBuffer,
+		const GBuffer& gbuffer, const SceneBuffers &scene, vk::Buffer uniformBuffer,
 		vk::Buffer reservoirBuffer, vk::Buffer resultReservoirBuffer, vk::DeviceSize reservoirBufferSize,
 		vk::DescriptorSet set
 	) {
-		std::array<vk::WriteDescriptorSet, 8> descriptorWrite;
+		std::array<vk::WriteDescriptorSet, 10> descriptorWrite;
 
 		// GBuffer Data
 		std::array<vk::DescriptorImageInfo, 5> imageInfo{
@@ -132,10 +132,12 @@ public:
 				.setImageInfo(imageInfo[i]);
 		}
 
-		std::array<vk::DescriptorBufferInfo, 3> reservoirsBufferInfo{
+		std::array<vk::DescriptorBufferInfo, 5> reservoirsBufferInfo{
 			vk::DescriptorBufferInfo(reservoirBuffer, 0, reservoirBufferSize),
 			vk::DescriptorBufferInfo(resultReservoirBuffer, 0, reservoirBufferSize),
-			vk::DescriptorBufferInfo(uniformBuffer, 0, sizeof(shader::RestirUniforms))
+			vk::DescriptorBufferInfo(uniformBuffer, 0, sizeof(shader::RestirUniforms)),
+			vk::DescriptorBufferInfo(scene.getPtLights(), 0, scene.getPtLightsBufferSize()),
+			vk::DescriptorBufferInfo(scene.getTriLights(), 0, scene.getTriLightsBufferSize())
 		};
 
 		descriptorWrite[5]
@@ -151,8 +153,18 @@ public:
 		descriptorWrite[7]
 			.setDstSet(set)
 			.setDstBinding(7)
-			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 			.setBufferInfo(reservoirsBufferInfo[2]);
+		descriptorWrite[8]
+			.setDstSet(set)
+			.setDstBinding(8)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(reservoirsBufferInfo[3]);
+		descriptorWrite[9]
+			.setDstSet(set)
+			.setDstBinding(9)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setBufferInfo(reservoirsBufferInfo[4]);
 
 		dev.updateDescriptorSets(descriptorWrite, {});
 	}
@@ -224,7 +236,7 @@ public:
 		uint8_t* dstData = _shaderBindingTable.mapAs<uint8_t>();
 		std::vector<uint8_t> shaderHandleStorage(shaderBindingTableSize);
 		vk::Result res = dev.getRayTracingShaderGroupHandlesKHR(
-			_hwRaytracePipeline.get(), 0, shaderGroupSize, shaderBindingTableSize, shaderHandleStorage.data(), dld
+			_getPipelines().hardware.get(), 0, shaderGroupSize, shaderBindingTableSize, shaderHandleStorage.data(), dld
 		);
 		vkCheck(res);
 
@@ -261,9 +273,11 @@ public:
 			.setSize(0);
 	}
 
-	inline static UnbiasedReusePass create(vk::Device dev, vk::DispatchLoaderDynamic& dld)
+	// hardware ray tracing pipelines and layouts are only created if hardwareRayTracing is true
+	inline static UnbiasedReusePass create(vk::Device dev, vk::DispatchLoaderDynamic& dld, bool hardwareRayTracing)
 	{
 		UnbiasedReusePass pass = UnbiasedReusePass();
+		pass._hardwareRayTracing = hardwareRayTracing;
 		pass._initialize(dev, dld);
 		return std::move(pass);
 	}
@@ -273,6 +287,17 @@ public:
 		_dld = &dld;
 	}
 
+	// pipelines of previously used configurations are kept around, so switching back does not recompile anything. the
+	// shader binding table needs to be recreated after this
+	void setShaderConfig(vk::Device dev, const RestirShaderConfig &config) {
+		_config = config;
+		_variant = _config.getVariantName();
+		if (!_pipelines.contains(_variant)) {
+			_loadShaders(dev);
+			_createPipelines(dev, *_dld);
+		}
+	}
+
 	//vk::DescriptorSet descriptorSet;
 	vma::UniqueBuffer _shaderBindingTable;
 	vk::StridedDeviceAddressRegionKHR rayGenSBT;
@@ -281,10 +306,14 @@ public:
 	vk::StridedDeviceAddressRegionKHR rayCallSBT;
 	vk::DescriptorSet frameDescriptorSet;
 	vk::DescriptorSet raytraceDescriptorSet;
+	// dynamic offset of the uniforms bound through the frame descriptor set
+	uint32_t uniformOffset = 0;
 	vk::Extent2D bufferExtent;
 	bool useSoftwareRayTracing = false;
 protected:
 	Shader _rayGen, _rayChit, _rayMiss, _rayShadowMiss, _software;
+	bool _hardwareRayTracing = false;
+	RestirShaderConfig _config;
 	vk::Format _swapchainFormat;
 	vk::UniqueSampler _sampler;
 	vk::UniquePipelineLayout _hwPipelineLayout;
@@ -293,14 +322,16 @@ protected:
 	vk::UniqueDescriptorSetLayout _hwRaytraceDescriptorLayout;
 	vk::UniqueDescriptorSetLayout _swRaytraceDescriptorLayout;
 
-	[[nodiscard]] vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic> _createHardwareRaytracePipeline(vk::Device dev, vk::DispatchLoaderDynamic& dld) {
+	[[nodiscard]] vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic> _createHardwareRaytracePipeline(
+		vk::Device dev, vk::DispatchLoaderDynamic &dld, const vk::SpecializationInfo &specialization
+	) {
 		// Set ray tracing pipeline
 		PipelineCreationInfo info;
 		info.shaderGroups.emplace_back(PipelineCreationInfo::getRtGenShaderGroupCreate());
 		info.shaderGroups.emplace_back(PipelineCreationInfo::getRtHitShaderGroupCreate());
 		info.shaderGroups.emplace_back(PipelineCreationInfo::getRtMissShaderGroupCreate());
 		info.shaderGroups.emplace_back(PipelineCreationInfo::getRtShadowMissShaderGroupCreate());
-		info.shaderStages.emplace_back(_rayGen.getStageInfo());
+		info.shaderStages.emplace_back(_rayGen.getStageInfo()).setPSpecializationInfo(&specialization);
 		info.shaderStages.emplace_back(_rayChit.getStageInfo());
 		info.shaderStages.emplace_back(_rayMiss.getStageInfo());
 		info.shaderStages.emplace_back(_rayShadowMiss.getStageInfo());
@@ -312,7 +343,9 @@ protected:
 			.setMaxPipelineRayRecursionDepth(1)
 			.setLayout(_hwPipelineLayout.get());
 
-		auto [res, pipeline] = dev.createRayTracingPipelineKHRUnique(nullptr, nullptr, rtPipelineInfo, nullptr, dld).asTuple();
+		auto [res, pipeline] = dev.createRayTracingPipelineKHRUnique(
+			nullptr, Pass::pipelineCache, rtPipelineInfo, nullptr, dld
+		).asTuple();
 		vkCheck(res);
 		return std::move(pipeline);
 	}
@@ -320,16 +353,16 @@ protected:
 	void _initialize(vk::Device dev, vk::DispatchLoaderDynamic& dld) {
 		_sampler = createSampler(dev, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest);
 
-		_rayGen = Shader::load(dev, "shaders/unbiasedReuseHardware.rgen.spv", "main", vk::ShaderStageFlagBits::eRaygenKHR);
-		_rayChit = Shader::load(dev, "shaders/hwVisibilityTest.rchit.spv", "main", vk::ShaderStageFlagBits::eClosestHitKHR);
-		_rayMiss = Shader::load(dev, "shaders/hwVisibilityTest.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
-		_rayShadowMiss = Shader::load(dev, "shaders/hwVisibilityTestShadow.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
-
-		_software = Shader::load(dev, "shaders/unbiasedReuseSoftware.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
-
-		vk::ShaderStageFlags stageFlags = vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eCompute;
+		_loadShaders(dev);
+		vk::ShaderStageFlags stageFlags = vk::ShaderStageFlagBits::eCompute;
+		if (_hardwareRayTracing) {
+			_rayChit = Shader::load(dev, "shaders/hwVisibilityTest.rchit.spv", "main", vk::ShaderStageFlagBits::eClosestHitKHR);
+			_rayMiss = Shader::load(dev, "shaders/hwVisibilityTest.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
+			_rayShadowMiss = Shader::load(dev, "shaders/hwVisibilityTestShadow.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
+			stageFlags |= vk::ShaderStageFlagBits::eRaygenKHR;
+		}
 
-		std::array<vk::DescriptorSetLayoutBinding, 8> frameBindings{
+		std::array<vk::DescriptorSetLayoutBinding, 10> frameBindings{
 			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
@@ -337,7 +370,9 @@ protected:
 			vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eCombinedImageSampler, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
 			vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
-			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eUniformBuffer, 1, stageFlags)
+			vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eUniformBufferDynamic, 1, stageFlags),
+			vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer, 1, stageFlags),
+			vk::DescriptorSetLayoutBinding(9, vk::DescriptorType::eStorageBuffer, 1, stageFlags)
 		};
 
 		vk::DescriptorSetLayoutCreateInfo layoutInfo;
@@ -345,19 +380,6 @@ protected:
 		_frameDescriptorSetLayout = dev.createDescriptorSetLayoutUnique(layoutInfo);
 
 
-		// Acceleration structure descriptor binding
-		vk::DescriptorSetLayoutBinding accelerationStructureLayoutBinding;
-		accelerationStructureLayoutBinding
-			.setBinding(0)
-			.setDescriptorType(vk::DescriptorType::eAccelerationStructureKHR)
-			.setDescriptorCount(1)
-			.setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
-
-		vk::DescriptorSetLayoutCreateInfo raytraceLayoutInfo;
-		raytraceLayoutInfo.setBindings(accelerationStructureLayoutBinding);
-		_hwRaytraceDescriptorLayout = dev.createDescriptorSetLayoutUnique(raytraceLayoutInfo);
-
-
 		std::array<vk::DescriptorSetLayoutBinding, 2> swRaytraceBindings{
 			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
 			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
@@ -368,13 +390,6 @@ protected:
 		_swRaytraceDescriptorLayout = dev.createDescriptorSetLayoutUnique(swRaytraceLayoutInfo);
 
 
-		std::array<vk::DescriptorSetLayout, 2> hwDescriptorLayouts{ _frameDescriptorSetLayout.get(), _hwRaytraceDescriptorLayout.get() };
-
-		vk::PipelineLayoutCreateInfo hwPipelineLayoutInfo;
-		hwPipelineLayoutInfo.setSetLayouts(hwDescriptorLayouts);
-		_hwPipelineLayout = dev.createPipelineLayoutUnique(hwPipelineLayoutInfo);
-
-
 		std::array<vk::DescriptorSetLayout, 2> swDescriptorLayouts{ _frameDescriptorSetLayout.get(), _swRaytraceDescriptorLayout.get() };
 
 		vk::PipelineLayoutCreateInfo swPipelineLayoutInfo;
@@ -382,23 +397,80 @@ protected:
 		_swPipelineLayout = dev.createPipelineLayoutUnique(swPipelineLayoutInfo);
 
 
-		//Pipeline
-#ifndef RENDERDOC_CAPTURE
-		_hwRaytracePipeline = _createHardwareRaytracePipeline(dev, dld);
-#endif
+		if (_hardwareRayTracing) {
+			// Acceleration structure descriptor binding
+			vk::DescriptorSetLayoutBinding accelerationStructureLayoutBinding;
+			accelerationStructureLayoutBinding
+				.setBinding(0)
+				.setDescriptorType(vk::DescriptorType::eAccelerationStructureKHR)
+				.setDescriptorCount(1)
+				.setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
 
-		vk::ComputePipelineCreateInfo swPipelineInfo;
-		swPipelineInfo
-			.setLayout(_swPipelineLayout.get())
-			.setStage(_software.getStageInfo());
-		auto [res, pipeline] = dev.createComputePipelineUnique(nullptr, swPipelineInfo);
-		vkCheck(res);
-		_softwarePipeline = std::move(pipeline);
+			vk::DescriptorSetLayoutCreateInfo raytraceLayoutInfo;
+			raytraceLayoutInfo.setBindings(accelerationStructureLayoutBinding);
+			_hwRaytraceDescriptorLayout = dev.createDescriptorSetLayoutUnique(raytraceLayoutInfo);
+
+			std::array<vk::DescriptorSetLayout, 2> hwDescriptorLayouts{
+				_frameDescriptorSetLayout.get(), _hwRaytraceDescriptorLayout.get()
+			};
+
+			vk::PipelineLayoutCreateInfo hwPipelineLayoutInfo;
+			hwPipelineLayoutInfo.setSetLayouts(hwDescriptorLayouts);
+			_hwPipelineLayout = dev.createPipelineLayoutUnique(hwPipelineLayoutInfo);
+		}
+
+
+		_variant = _config.getVariantName();
+		_createPipelines(dev, dld);
+	}
+
+	void _loadShaders(vk::Device dev) {
+		if (_hardwareRayTracing) {
+			_rayGen = Shader::load(dev, _config.getShaderPath("unbiasedReuseHardware.rgen"), "main", vk::ShaderStageFlagBits::eRaygenKHR);
+		}
+		_software = Shader::load(dev, _config.getShaderPath("unbiasedReuseSoftware.comp"), "main", vk::ShaderStageFlagBits::eCompute);
+	}
+
+	// creates pipelines for the current configuration using the currently loaded shaders
+	void _createPipelines(vk::Device dev, vk::DispatchLoaderDynamic &dld) {
+		RestirShaderConfig::Specialization specialization = _config.getSpecialization();
+		vk::SpecializationInfo specializationInfo = specialization.getInfo();
+
+		Pipelines &pipelines = _pipelines[_variant];
+		std::vector<std::function<void()>> tasks;
+		if (_hardwareRayTracing) {
+			tasks.emplace_back([&]() {
+				pipelines.hardware = _createHardwareRaytracePipeline(dev, dld, specializationInfo);
+			});
+		}
+		tasks.emplace_back([&]() {
+			vk::PipelineShaderStageCreateInfo swStageInfo = _software.getStageInfo();
+			swStageInfo.setPSpecializationInfo(&specializationInfo);
+
+			vk::ComputePipelineCreateInfo swPipelineInfo;
+			swPipelineInfo
+				.setLayout(_swPipelineLayout.get())
+				.setStage(swStageInfo);
+			auto [res, pipeline] = dev.createComputePipelineUnique(Pass::pipelineCache, swPipelineInfo);
+			vkCheck(res);
+			pipelines.software = std::move(pipeline);
+		});
+		runInParallel(tasks);
 	}
 private:
+	struct Pipelines {
+		vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic> hardware;
+		vk::UniquePipeline software;
+	};
+
 	vk::UniqueRenderPass _pass;
-	vk::UniqueHandle<vk::Pipeline, vk::DispatchLoaderDynamic> _hwRaytracePipeline;
-	vk::UniquePipeline _softwarePipeline;
+	// pipelines of all configurations that have been used, indexed by RestirShaderConfig::getVariantName()
+	std::map<std::string, Pipelines> _pipelines;
+	std::string _variant;
+
+	[[nodiscard]] const Pipelines &_getPipelines() const {
+		return _pipelines.at(_variant);
+	}
 
 	vk::DispatchLoaderDynamic *_dld = nullptr;
 };
\ No newline at end of file
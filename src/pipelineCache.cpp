@@ -0,0 +1,69 @@
+#include "pipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "misc.h"
+
+// checks the header of the cache data against the device. the header consists of its size, its version, the vendor
+// and device IDs, and the pipeline cache UUID, all stored least significant byte first
+[[nodiscard]] static bool isPipelineCacheCompatible(
+	const std::vector<char> &data, const vk::PhysicalDeviceProperties &properties
+) {
+	constexpr std::size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+	if (data.size() < headerSize) {
+		return false;
+	}
+	uint32_t fields[4];
+	std::memcpy(fields, data.data(), sizeof(fields));
+	return
+		fields[0] >= headerSize && fields[0] <= data.size() &&
+		fields[1] == static_cast<uint32_t>(VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+		fields[2] == properties.vendorID &&
+		fields[3] == properties.deviceID &&
+		std::memcmp(data.data() + sizeof(fields), properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() const {
+	if (!_cache) {
+		return;
+	}
+	std::vector<uint8_t> data = _cache.getOwner().getPipelineCacheData(_cache.get());
+	std::filesystem::path tempPath = _path;
+	tempPath += ".tmp";
+	{
+		std::ofstream fout(tempPath, std::ios::binary);
+		fout.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!fout) {
+			std::cout << "Failed to write pipeline cache to " << tempPath << "\n";
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, _path, error);
+	if (error) {
+		std::cout << "Failed to write pipeline cache to " << _path << ": " << error.message() << "\n";
+	}
+}
+
+PipelineCache PipelineCache::load(vk::Device device, vk::PhysicalDevice physicalDevice, std::filesystem::path path) {
+	PipelineCache result;
+	result._path = std::move(path);
+
+	std::vector<char> data;
+	if (std::filesystem::is_regular_file(result._path)) {
+		data = readFile(result._path);
+		if (!isPipelineCacheCompatible(data, physicalDevice.getProperties())) {
+			std::cout << "Ignoring incompatible pipeline cache " << result._path << "\n";
+			data.clear();
+		}
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo;
+	cacheInfo
+		.setInitialDataSize(data.size())
+		.setPInitialData(data.data());
+	result._cache = device.createPipelineCacheUnique(cacheInfo);
+	return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.hpp>
+
+// A pipeline cache that is loaded from a file at startup and written back to it on exit, so that pipelines compiled
+// in previous runs don't need to be compiled again. Files written by another device or driver are ignored.
+class PipelineCache {
+public:
+	PipelineCache() = default;
+
+	// writes the contents of the cache to the file it was loaded from, replacing it only once all data is written
+	void save() const;
+
+	[[nodiscard]] vk::PipelineCache get() const {
+		return _cache.get();
+	}
+
+	// creates an empty cache if the file does not exist or is not compatible with the device
+	[[nodiscard]] static PipelineCache load(vk::Device, vk::PhysicalDevice, std::filesystem::path);
+private:
+	vk::UniquePipelineCache _cache;
+	std::filesystem::path _path;
+};
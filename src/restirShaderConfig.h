@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <vulkan/vulkan.hpp>
+
+#include "shaderIncludes.h"
+
+// Shader settings that can be changed at runtime. The reservoir size and UNBIASED_MIS change the layout of reservoirs,
+// so they select one of the shader permutations compiled by add_reservoir_shader() in CMakeLists.txt. Everything else
+// is passed to the shaders as specialization constants.
+struct RestirShaderConfig {
+	// must match the permutations compiled by add_reservoir_shader()
+	constexpr static std::array<uint32_t, 3> reservoirSizes{ 1, 2, 4 };
+
+	// specialization constants, indexed by the *_CONSTANT_ID macros in restirStructs.glsl
+	struct Specialization {
+		std::array<uint32_t, 9> data;
+		std::array<vk::SpecializationMapEntry, 9> entries;
+
+		// the returned object points into this struct
+		[[nodiscard]] vk::SpecializationInfo getInfo() const {
+			vk::SpecializationInfo info;
+			info
+				.setMapEntries(entries)
+				.setDataSize(sizeof(data))
+				.setPData(data.data());
+			return info;
+		}
+	};
+
+	uint32_t reservoirSize = RESERVOIR_SIZE;
+	bool unbiasedMis = false;
+	uint32_t unbiasedReuseNeighbors = UNBIASED_REUSE_NEIGHBORS;
+	// weight each neighbor of the unbiased spatial reuse pass only against the current pixel, which needs fewer
+	// visibility rays. see pairwiseMisReuse() in unbiasedReuse.glsl
+	bool pairwiseMis = false;
+	// group size of all compute shaders that run once per pixel
+	uint32_t groupSizeX = OMNI_GROUP_SIZE_X;
+	uint32_t groupSizeY = OMNI_GROUP_SIZE_Y;
+	// spatial reuse passes load reservoirs and G-buffer data of each workgroup into shared memory, limiting the reuse
+	// radius to tileApron pixels. see reuseTile.glsl
+	bool tiledReuse = false;
+	uint32_t tileApron = REUSE_TILE_APRON;
+	// order of reservoirs in reservoir buffers, see reservoirLayout.glsl
+	bool tiledReservoirLayout = false;
+	// one reservoir per 2x2 pixels, upsampled in the lighting pass. see getReservoirGridSize() in reservoirLayout.glsl
+	bool halfResolution = false;
+	// must match GBuffer::Formats, so this can only be chosen at startup. see gBuffer.glsl
+	bool compactGBuffer = false;
+
+	[[nodiscard]] friend bool operator==(const RestirShaderConfig&, const RestirShaderConfig&) = default;
+
+	// name of the shader permutation, e.g. "r2.mis"
+	[[nodiscard]] std::string getPermutationName() const {
+		std::string result = "r" + std::to_string(reservoirSize);
+		if (unbiasedMis) {
+			result += ".mis";
+		}
+		return result;
+	}
+	// name that identifies everything that affects how reservoirs are stored, e.g. "r2.mis.z.h"
+	[[nodiscard]] std::string getReservoirLayoutName() const {
+		return getPermutationName() + (tiledReservoirLayout ? ".z" : "") + (halfResolution ? ".h" : "");
+	}
+	// name that identifies pipelines created with this configuration
+	[[nodiscard]] std::string getVariantName() const {
+		return
+			getReservoirLayoutName() +
+			".n" + std::to_string(unbiasedReuseNeighbors) +
+			(pairwiseMis ? ".pw" : "") +
+			".g" + std::to_string(groupSizeX) + "x" + std::to_string(groupSizeY) +
+			(tiledReuse ? ".t" + std::to_string(tileApron) : "") +
+			(compactGBuffer ? ".cg" : "");
+	}
+	// e.g. "restirOmniSoftware.comp" -> "shaders/restirOmniSoftware.comp.r2.mis.spv"
+	[[nodiscard]] std::filesystem::path getShaderPath(std::string_view shader) const {
+		return "shaders/" + std::string(shader) + "." + getPermutationName() + ".spv";
+	}
+
+	[[nodiscard]] vk::DeviceSize getPackedReservoirSize() const {
+		// the c++ definition of PackedLightSample never contains sumPHat
+		vk::DeviceSize sampleSize = sizeof(shader::PackedLightSample) + (unbiasedMis ? sizeof(float) : 0);
+		return sampleSize * reservoirSize + sizeof(uint32_t);
+	}
+	// size of the grid that passes working on reservoirs are dispatched over
+	[[nodiscard]] vk::Extent2D getReservoirGridSize(vk::Extent2D screenSize) const {
+		nvmath::uvec2 size = shader::getReservoirGridSize(
+			nvmath::uvec2(screenSize.width, screenSize.height), halfResolution
+		);
+		return vk::Extent2D(size.x, size.y);
+	}
+	[[nodiscard]] vk::DeviceSize getReservoirBufferSize(vk::Extent2D screenSize) const {
+		vk::Extent2D gridSize = getReservoirGridSize(screenSize);
+		uint32_t count = shader::getReservoirCount(
+			nvmath::uvec2(gridSize.width, gridSize.height),
+			tiledReservoirLayout ? RESERVOIR_LAYOUT_TILED : RESERVOIR_LAYOUT_LINEAR
+		);
+		return count * getPackedReservoirSize();
+	}
+	// approximate amount of shared memory used by the tiled spatial reuse passes
+	[[nodiscard]] vk::DeviceSize getReuseTileSharedMemorySize(uint32_t apron) const {
+		// a packed reservoir, normal & depth, and world position for each pixel
+		vk::DeviceSize pixelSize = getPackedReservoirSize() + 2 * sizeof(nvmath::vec4f);
+		return pixelSize * (groupSizeX + 2 * apron) * (groupSizeY + 2 * apron);
+	}
+	// the largest apron no larger than tileApron whose tile fits in the given amount of shared memory, or std::nullopt
+	// if not even a tile without apron fits
+	[[nodiscard]] std::optional<uint32_t> getMaxTileApron(uint32_t maxSharedMemorySize) const {
+		for (uint32_t apron = tileApron; ; --apron) {
+			if (getReuseTileSharedMemorySize(apron) <= maxSharedMemorySize) {
+				return apron;
+			}
+			if (apron == 0) {
+				return std::nullopt;
+			}
+		}
+	}
+
+	[[nodiscard]] Specialization getSpecialization() const {
+		Specialization result;
+		result.data[GROUP_SIZE_X_CONSTANT_ID] = groupSizeX;
+		result.data[GROUP_SIZE_Y_CONSTANT_ID] = groupSizeY;
+		result.data[UNBIASED_REUSE_NEIGHBORS_CONSTANT_ID] = unbiasedReuseNeighbors;
+		result.data[TILED_REUSE_CONSTANT_ID] = tiledReuse ? VK_TRUE : VK_FALSE;
+		// the size of shared memory arrays depends on this, so keep them small when they're not used
+		result.data[TILE_APRON_CONSTANT_ID] = tiledReuse ? tileApron : 0;
+		result.data[RESERVOIR_LAYOUT_CONSTANT_ID] = tiledReservoirLayout ? RESERVOIR_LAYOUT_TILED : RESERVOIR_LAYOUT_LINEAR;
+		result.data[COMPACT_GBUFFER_CONSTANT_ID] = compactGBuffer ? VK_TRUE : VK_FALSE;
+		result.data[HALF_RES_RESTIR_CONSTANT_ID] = halfResolution ? VK_TRUE : VK_FALSE;
+		result.data[PAIRWISE_MIS_CONSTANT_ID] = pairwiseMis ? VK_TRUE : VK_FALSE;
+		for (uint32_t i = 0; i < result.entries.size(); ++i) {
+			result.entries[i] = vk::SpecializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t));
+		}
+		return result;
+	}
+};
@@ -8,6 +8,8 @@
 
 #include "vertex.h"
 #include "vma.h"
+#include "lightBvhBuilder.h"
+#include "lightGenerator.h"
 #include "transientCommandBuffer.h"
 #include "shaderIncludes.h"
 
@@ -36,6 +38,18 @@ public:
 	[[nodiscard]] vk::Buffer getMatrices() const {
 		return _matrices.get();
 	}
+	// NodeDrawInfo of every node
+	[[nodiscard]] vk::Buffer getNodes() const {
+		return _nodes.get();
+	}
+	// NodeBounds of every node
+	[[nodiscard]] vk::Buffer getNodeBounds() const {
+		return _nodeBounds.get();
+	}
+	// the contents of getNodeBounds(), used to cull nodes on the CPU
+	[[nodiscard]] const std::vector<shader::NodeBounds> &getCpuNodeBounds() const {
+		return _cpuNodeBounds;
+	}
 	[[nodiscard]] const vk::Buffer getPtLights() const {
 		return _ptLightsBuffer.get();
 	}
@@ -45,9 +59,16 @@ public:
 	[[nodiscard]] vk::Buffer getMaterials() const {
 		return _materials.get();
 	}
+	// MaterialTextures of every material, which index getBindlessTextureInfo()
+	[[nodiscard]] vk::Buffer getMaterialTextures() const {
+		return _materialTextures.get();
+	}
 	[[nodiscard]] vk::Buffer getAliasTable() const {
 		return _aliasTableBuffer.get();
 	}
+	[[nodiscard]] vk::Buffer getLightBvh() const {
+		return _lightBvhBuffers.nodeBuffer.get();
+	}
 	[[nodiscard]] const std::vector<SceneTexture> &getTextures() const {
 		return _textureImages;
 	}
@@ -57,6 +78,43 @@ public:
 	[[nodiscard]] const SceneTexture &getDefaultWhite() const {
 		return _defaultWhite;
 	}
+	// the texture array of bindless materials, which contains all textures of the scene followed by the default white
+	// and normal textures
+	[[nodiscard]] std::vector<vk::DescriptorImageInfo> getBindlessTextureInfo() const {
+		std::vector<vk::DescriptorImageInfo> result;
+		for (const SceneTexture &tex : _textureImages) {
+			result.emplace_back(tex.getDescriptorInfo());
+		}
+		result.emplace_back(_defaultWhite.getDescriptorInfo());
+		result.emplace_back(_defaultNormal.getDescriptorInfo());
+		return result;
+	}
+	[[nodiscard]] static uint32_t getBindlessTextureCount(const nvh::GltfScene &scene) {
+		return static_cast<uint32_t>(scene.m_textures.size() + 2);
+	}
+	// the world space bounding boxes of the meshes of all nodes. scenes are static, so they're only computed once
+	[[nodiscard]] static std::vector<shader::NodeBounds> computeNodeBounds(const nvh::GltfScene &scene) {
+		std::vector<shader::NodeBounds> result(scene.m_nodes.size());
+		for (std::size_t i = 0; i < scene.m_nodes.size(); ++i) {
+			const nvh::GltfNode &node = scene.m_nodes[i];
+			const nvh::GltfPrimMesh &mesh = scene.m_primMeshes[node.primMesh];
+			nvmath::vec3f boundsMin(std::numeric_limits<float>::max());
+			nvmath::vec3f boundsMax(-std::numeric_limits<float>::max());
+			for (int corner = 0; corner < 8; ++corner) {
+				nvmath::vec4f pos = node.worldMatrix * nvmath::vec4f(
+					(corner & 1) ? mesh.posMax.x : mesh.posMin.x,
+					(corner & 2) ? mesh.posMax.y : mesh.posMin.y,
+					(corner & 4) ? mesh.posMax.z : mesh.posMin.z,
+					1.0f
+				);
+				boundsMin = nvmath::nv_min(boundsMin, nvmath::vec3f(pos));
+				boundsMax = nvmath::nv_max(boundsMax, nvmath::vec3f(pos));
+			}
+			result[i].boundsMin = nvmath::vec4f(boundsMin, 0.0f);
+			result[i].boundsMax = nvmath::vec4f(boundsMax, 0.0f);
+		}
+		return result;
+	}
 	[[nodiscard]] const vk::DeviceSize getPtLightsBufferSize() const {
 		return _ptLightsBufferSize;
 	}
@@ -66,6 +124,9 @@ public:
 	[[nodiscard]] const vk::DeviceSize getAliasTableBufferSize() const {
 		return _aliasTableBufferSize;
 	}
+	[[nodiscard]] const vk::DeviceSize getLightBvhBufferSize() const {
+		return _lightBvhBuffers.nodeBufferSize;
+	}
 	
 
 	[[nodiscard]] static SceneBuffers create(
@@ -73,43 +134,81 @@ public:
 		vma::Allocator &allocator,
 		TransientCommandBufferPool &oneTimeBufferPool,
 		vk::Device l_device,
-		vk::Queue graphicsQueue
+		vk::Queue graphicsQueue,
+		const LightGeneratorSettings &lightSettings
 	) {
 		std::vector<shader::pointLight> pointLights = collectPointLightsFromScene(scene);
 		std::vector<shader::triLight> triangleLights = collectTriangleLightsFromScene(scene);
-		if (pointLights.empty() && triangleLights.empty()) {
-			pointLights = generateRandomPointLights(200, scene.m_dimensions.min, scene.m_dimensions.max);
+		if (lightSettings.numPointLights > 0 || lightSettings.numTriangleLights > 0) {
+			std::cout << "Generating lights...";
+			std::vector<shader::pointLight> generatedPointLights = generatePointLights(lightSettings, scene);
+			std::vector<shader::triLight> generatedTriangleLights = generateTriangleLights(lightSettings, scene);
+			pointLights.insert(pointLights.end(), generatedPointLights.begin(), generatedPointLights.end());
+			triangleLights.insert(triangleLights.end(), generatedTriangleLights.begin(), generatedTriangleLights.end());
+			std::cout << " done\n";
+		} else if (pointLights.empty() && triangleLights.empty()) {
+			LightGeneratorSettings defaultSettings = lightSettings;
+			defaultSettings.numPointLights = 200;
+			pointLights = generatePointLights(defaultSettings, scene);
+		}
+
+		// round-trip all lights through their packed representation, so that the alias table and the light BVH see
+		// exactly the same lights as the shaders
+		std::vector<shader::PackedPointLight> packedPointLights(pointLights.size());
+		for (std::size_t i = 0; i < pointLights.size(); ++i) {
+			packedPointLights[i] = shader::encodePointLight(pointLights[i]);
+			pointLights[i] = shader::decodePointLight(packedPointLights[i]);
+		}
+		std::vector<shader::PackedTriLight> packedTriangleLights(triangleLights.size());
+		for (std::size_t i = 0; i < triangleLights.size(); ++i) {
+			packedTriangleLights[i] = shader::encodeTriLight(triangleLights[i]);
+			triangleLights[i] = shader::decodeTriLight(packedTriangleLights[i]);
 		}
 
 		std::vector<shader::aliasTableColumn> aliasTable = createAliasTable(pointLights, triangleLights);
 
 		SceneBuffers result;
 
+		std::cout << "Building light BVH...";
+		result._lightBvhBuffers = LightBvhBuffers::create(LightBvh::build(pointLights, triangleLights), allocator);
+		std::cout << " done\n";
+
+		// vertices, indices, and matrices are also read as storage buffers when resolving visibility buffers
 		result._vertices = allocator.createTypedBuffer<Vertex>(
-			scene.m_positions.size(), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU
+			scene.m_positions.size(), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU
 			);
 		result._indices = allocator.createTypedBuffer<int32_t>(
-			scene.m_indices.size(), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU
+			scene.m_indices.size(), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU
 			);
 		result._matrices = allocator.createTypedBuffer<shader::ModelMatrices>(
-			scene.m_nodes.size(), vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+			scene.m_nodes.size(), vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
 			);
+		result._nodes = allocator.createTypedBuffer<shader::NodeDrawInfo>(
+			scene.m_nodes.size(), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+			);
+		result._nodeBounds = allocator.createTypedBuffer<shader::NodeBounds>(
+			scene.m_nodes.size(), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+			);
+		// materials are bound as uniform buffers for each draw, or read as storage buffers with bindless materials
 		result._materials = allocator.createTypedBuffer<shader::MaterialUniforms>(
-			scene.m_materials.size(), vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+			scene.m_materials.size(), vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
+			);
+		result._materialTextures = allocator.createTypedBuffer<shader::MaterialTextures>(
+			scene.m_materials.size(), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
 			);
 		// Lights
 		// Point lights
 		result._ptLightsBufferSize =
-			alignPreArrayBlock<shader::pointLight, int32_t>() + 
-			sizeof(shader::pointLight) * pointLights.size();
+			alignPreArrayBlock<shader::PackedPointLight, int32_t>() +
+			sizeof(shader::PackedPointLight) * packedPointLights.size();
 		result._ptLightsBuffer = allocator.createBuffer(
 			static_cast<uint32_t>(result._ptLightsBufferSize),
 			vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
 		);
 		// Triangle lights
 		result._triLightsBufferSize =
-			alignPreArrayBlock<shader::triLight, int32_t>() +
-			sizeof(shader::triLight) * triangleLights.size();
+			alignPreArrayBlock<shader::PackedTriLight, int32_t>() +
+			sizeof(shader::PackedTriLight) * packedTriangleLights.size();
 		result._triLightsBuffer = allocator.createBuffer(
 			static_cast<uint32_t>(result._triLightsBufferSize),
 			vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU
@@ -202,10 +301,22 @@ public:
 		result._indices.flush();
 
 
+		// missing textures are replaced by the default textures, see getBindlessTextureInfo()
+		uint32_t defaultWhiteIndex = static_cast<uint32_t>(scene.m_textures.size());
+		uint32_t defaultNormalIndex = defaultWhiteIndex + 1;
+		auto getTextureIndex = [](int texture, uint32_t defaultIndex) {
+			return texture >= 0 ? static_cast<uint32_t>(texture) : defaultIndex;
+		};
+
 		auto *mat_device = result._materials.mapAs<shader::MaterialUniforms>();
+		auto *matTextures = result._materialTextures.mapAs<shader::MaterialTextures>();
 		for (std::size_t i = 0; i < scene.m_materials.size(); ++i) {
 			const nvh::GltfMaterial &mat = scene.m_materials[i];
 			shader::MaterialUniforms &outMat = mat_device[i];
+			shader::MaterialTextures &outTextures = matTextures[i];
+
+			outTextures.normal = getTextureIndex(mat.normalTexture, defaultNormalIndex);
+			outTextures.emissive = getTextureIndex(mat.emissiveTexture, defaultWhiteIndex);
 
 			outMat.emissiveFactor = mat.emissiveFactor;
 			outMat.shadingModel = mat.shadingModel;
@@ -218,44 +329,71 @@ public:
 				outMat.colorParam = mat.pbrBaseColorFactor;
 				outMat.materialParam.y = mat.pbrRoughnessFactor;
 				outMat.materialParam.z = mat.pbrMetallicFactor;
+				outTextures.albedo = getTextureIndex(mat.pbrBaseColorTexture, defaultWhiteIndex);
+				outTextures.material = getTextureIndex(mat.pbrMetallicRoughnessTexture, defaultWhiteIndex);
 				break;
 			case SHADING_MODEL_SPECULAR_GLOSSINESS:
 				outMat.colorParam = mat.khrDiffuseFactor;
 				outMat.materialParam = mat.khrSpecularFactor;
 				outMat.materialParam.w = mat.khrGlossinessFactor;
+				outTextures.albedo = getTextureIndex(mat.khrDiffuseTexture, defaultWhiteIndex);
+				outTextures.material = getTextureIndex(mat.khrSpecularGlossinessTexture, defaultWhiteIndex);
 				break;
 			}
 		}
 		result._materials.unmap();
 		result._materials.flush();
+		result._materialTextures.unmap();
+		result._materialTextures.flush();
 
 
 		auto *matrices = result._matrices.mapAs<shader::ModelMatrices>();
 		for (std::size_t i = 0; i < scene.m_nodes.size(); ++i) {
 			matrices[i].transform = scene.m_nodes[i].worldMatrix;
 			matrices[i].transformInverseTransposed = nvmath::transpose(nvmath::invert(matrices[i].transform));
+			// scenes are static, so objects have not moved since the last frame
+			matrices[i].prevFrameTransform = matrices[i].transform;
 		}
 		result._matrices.unmap();
 		result._matrices.flush();
 
+		auto *nodes = result._nodes.mapAs<shader::NodeDrawInfo>();
+		for (std::size_t i = 0; i < scene.m_nodes.size(); ++i) {
+			const nvh::GltfPrimMesh &mesh = scene.m_primMeshes[scene.m_nodes[i].primMesh];
+			nodes[i].firstIndex = mesh.firstIndex;
+			nodes[i].vertexOffset = static_cast<int32_t>(mesh.vertexOffset);
+			nodes[i].materialIndex = static_cast<uint32_t>(mesh.materialIndex);
+			nodes[i].indexCount = mesh.indexCount;
+		}
+		result._nodes.unmap();
+		result._nodes.flush();
+
+		result._cpuNodeBounds = computeNodeBounds(scene);
+		std::memcpy(
+			result._nodeBounds.map(), result._cpuNodeBounds.data(),
+			sizeof(shader::NodeBounds) * result._cpuNodeBounds.size()
+		);
+		result._nodeBounds.unmap();
+		result._nodeBounds.flush();
+
 		// Lights
 		// Point lights
 		int32_t* pointLightPtr = result._ptLightsBuffer.mapAs<int32_t>();
-		*pointLightPtr = static_cast<int32_t>(pointLights.size());
-		auto* ptLights = reinterpret_cast<shader::pointLight*>(
-			reinterpret_cast<uintptr_t>(pointLightPtr) + alignPreArrayBlock<shader::pointLight, int32_t>()
+		*pointLightPtr = static_cast<int32_t>(packedPointLights.size());
+		auto* ptLights = reinterpret_cast<shader::PackedPointLight*>(
+			reinterpret_cast<uintptr_t>(pointLightPtr) + alignPreArrayBlock<shader::PackedPointLight, int32_t>()
 			);
-		std::memcpy(ptLights, pointLights.data(), sizeof(shader::pointLight) * pointLights.size());
+		std::memcpy(ptLights, packedPointLights.data(), sizeof(shader::PackedPointLight) * packedPointLights.size());
 		result._ptLightsBuffer.unmap();
 		result._ptLightsBuffer.flush();
 		
 		// Tri lights
 		int32_t* triLightsPtr = result._triLightsBuffer.mapAs<int32_t>();
-		*triLightsPtr = static_cast<int32_t>(triangleLights.size());
-		auto* triLights = reinterpret_cast<shader::triLight*>(
-			reinterpret_cast<uintptr_t>(triLightsPtr) + alignPreArrayBlock<shader::triLight, int32_t>()
+		*triLightsPtr = static_cast<int32_t>(packedTriangleLights.size());
+		auto* triLights = reinterpret_cast<shader::PackedTriLight*>(
+			reinterpret_cast<uintptr_t>(triLightsPtr) + alignPreArrayBlock<shader::PackedTriLight, int32_t>()
 			);
-		std::memcpy(triLights, triangleLights.data(), sizeof(shader::triLight) * triangleLights.size());
+		std::memcpy(triLights, packedTriangleLights.data(), sizeof(shader::PackedTriLight) * packedTriangleLights.size());
 		result._triLightsBuffer.unmap();
 		result._triLightsBuffer.flush();
 
@@ -275,11 +413,16 @@ private:
 	vma::UniqueBuffer _vertices;
 	vma::UniqueBuffer _indices;
 	vma::UniqueBuffer _matrices;
+	vma::UniqueBuffer _nodes;
+	vma::UniqueBuffer _nodeBounds;
 	vma::UniqueBuffer _materials;
+	vma::UniqueBuffer _materialTextures;
 	vma::UniqueBuffer _ptLightsBuffer;
 	vma::UniqueBuffer _triLightsBuffer;
 	vma::UniqueBuffer _aliasTableBuffer;
+	LightBvhBuffers _lightBvhBuffers;
 	std::vector<SceneTexture> _textureImages;
+	std::vector<shader::NodeBounds> _cpuNodeBounds;
 	SceneTexture _defaultNormal;
 	SceneTexture _defaultWhite;
 	vk::DeviceSize _ptLightsBufferSize;
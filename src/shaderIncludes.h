@@ -1,5 +1,9 @@
 #pragma once
 
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
 #include <nvmath_glsltypes.h>
 
 namespace shader {
@@ -24,12 +28,69 @@ namespace shader {
 
 #define CPP_FUNCTION inline
 
+	// implementations of glsl built-in functions used by shared code
+	[[nodiscard]] inline ::std::uint16_t floatToHalf(float f) {
+		::std::uint32_t bits = ::std::bit_cast<::std::uint32_t>(f);
+		::std::uint32_t sign = (bits >> 16) & 0x8000u;
+		::std::uint32_t mantissa = bits & 0x7FFFFFu;
+		::std::int32_t exponent = static_cast<::std::int32_t>((bits >> 23) & 0xFFu);
+		if (exponent == 0xFF) { // inf & nan
+			return static_cast<::std::uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u));
+		}
+		exponent += 15 - 127;
+		if (exponent >= 31) { // overflow
+			return static_cast<::std::uint16_t>(sign | 0x7C00u);
+		}
+		::std::uint32_t shift = 13;
+		::std::uint32_t result = sign | (static_cast<::std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+		if (exponent <= 0) { // denormals
+			if (exponent < -10) {
+				return static_cast<::std::uint16_t>(sign);
+			}
+			mantissa |= 0x800000u;
+			shift = static_cast<::std::uint32_t>(14 - exponent);
+			result = sign | (mantissa >> shift);
+		}
+		// round to nearest even; carries into the exponent are intended
+		::std::uint32_t remainder = mantissa & ((1u << shift) - 1u), halfway = 1u << (shift - 1u);
+		if (remainder > halfway || (remainder == halfway && (result & 1u) != 0)) {
+			++result;
+		}
+		return static_cast<::std::uint16_t>(result);
+	}
+	[[nodiscard]] inline float halfToFloat(::std::uint16_t h) {
+		::std::uint32_t sign = static_cast<::std::uint32_t>(h & 0x8000u) << 16;
+		::std::uint32_t exponent = (h >> 10) & 0x1Fu;
+		::std::uint32_t mantissa = h & 0x3FFu;
+		if (exponent == 0) {
+			float value = static_cast<float>(mantissa) * 5.9604644775390625e-8f; // 2^-24
+			return sign != 0 ? -value : value;
+		}
+		if (exponent == 31) {
+			return ::std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+		}
+		return ::std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+	[[nodiscard]] inline uint packHalf2x16(vec2 v) {
+		return static_cast<uint>(floatToHalf(v.x)) | (static_cast<uint>(floatToHalf(v.y)) << 16);
+	}
+	[[nodiscard]] inline vec2 unpackHalf2x16(uint v) {
+		return vec2(halfToFloat(static_cast<::std::uint16_t>(v & 0xFFFFu)), halfToFloat(static_cast<::std::uint16_t>(v >> 16)));
+	}
+	[[nodiscard]] inline vec2 unpackUnorm2x16(uint v) {
+		return vec2(static_cast<float>(v & 0xFFFFu) / 65535.0f, static_cast<float>(v >> 16) / 65535.0f);
+	}
+
 #include "shaders/include/common.glsl"
 #include "shaders/include/structs/aabbTree.glsl"
 #include "shaders/include/structs/lightingPassStructs.glsl"
 #include "shaders/include/structs/restirStructs.glsl"
+#include "shaders/include/reservoirLayout.glsl"
 #include "shaders/include/structs/sceneStructs.glsl"
+#include "shaders/include/culling.glsl"
 #include "shaders/include/structs/light.glsl"
+#include "shaders/include/structs/lightBvh.glsl"
+#include "shaders/include/packedLight.glsl"
 
 #ifdef SHADER_DEFINE_INT_UB
 #	undef int
@@ -3,11 +3,20 @@
 #include "include/structs/sceneStructs.glsl"
 
 layout (set = 0, binding = 0) uniform Uniforms {
-	mat4 projectionViewMatrix;
-} uniforms;
+	GBufferUniforms uniforms;
+};
+#ifdef BINDLESS_MATERIALS
+layout (set = 1, binding = 0) buffer Matrices {
+	ModelMatrices nodeMatrices[];
+};
+layout (set = 1, binding = 1) buffer Nodes {
+	NodeDrawInfo nodes[];
+};
+#else
 layout (set = 1, binding = 0) uniform Matrices {
 	ModelMatrices matrices;
 };
+#endif
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inNormal;
@@ -20,10 +29,23 @@ layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec4 outTangent;
 layout (location = 3) out vec4 outColor;
 layout (location = 4) out vec2 outUv;
+layout (location = 5) out vec4 outClipPosition;
+layout (location = 6) out vec4 outPrevFrameClipPosition;
+// GBufferPass draws each node with its index as the first instance
+layout (location = 7) flat out uint outNodeIndex;
+#ifdef BINDLESS_MATERIALS
+layout (location = 8) flat out uint outMaterialIndex;
+#endif
 
 void main() {
+#ifdef BINDLESS_MATERIALS
+	ModelMatrices matrices = nodeMatrices[gl_InstanceIndex];
+	outMaterialIndex = nodes[gl_InstanceIndex].materialIndex;
+#endif
 	vec4 worldPos = matrices.transform * vec4(inPosition, 1.0f);
 	gl_Position = uniforms.projectionViewMatrix * worldPos;
+	outClipPosition = gl_Position;
+	outPrevFrameClipPosition = uniforms.prevFrameProjectionViewMatrix * matrices.prevFrameTransform * vec4(inPosition, 1.0f);
 
 	outPosition = worldPos.xyz;
 	outNormal = normalize((matrices.transformInverseTransposed * vec4(inNormal, 0.0f)).xyz);
@@ -31,4 +53,5 @@ void main() {
 	outTangent.w = inTangent.w;
 	outColor = inColor;
 	outUv = inUv;
+	outNodeIndex = gl_InstanceIndex;
 }
@@ -0,0 +1,28 @@
+// Usage: Define BINDLESS_MATERIAL_SET as the set that GBufferPass binds its bindless descriptors to, then include this
+// file. structs/sceneStructs.glsl must be included before this file, and GL_EXT_nonuniform_qualifier must be enabled.
+//
+// Declares the materials and textures of the whole scene, which are indexed in shaders instead of being bound for
+// each draw. After loadMaterial(), material and the textures declared by gBufferMaterial.glsl for materials that are
+// bound for each draw refer to that material.
+
+layout (set = BINDLESS_MATERIAL_SET, binding = 2) buffer Materials {
+	MaterialUniforms materials[];
+};
+layout (set = BINDLESS_MATERIAL_SET, binding = 3) buffer MaterialTextureIndices {
+	MaterialTextures materialTextures[];
+};
+layout (set = BINDLESS_MATERIAL_SET, binding = 4) uniform sampler2D textures[];
+
+MaterialUniforms material;
+MaterialTextures materialTextureIndices;
+
+// each draw uses a single material, but fragments of different draws may still end up in the same subgroup
+#define uniAlbedo textures[nonuniformEXT(materialTextureIndices.albedo)]
+#define uniNormal textures[nonuniformEXT(materialTextureIndices.normal)]
+#define uniMaterial textures[nonuniformEXT(materialTextureIndices.material)]
+#define uniEmissiveTexture textures[nonuniformEXT(materialTextureIndices.emissive)]
+
+void loadMaterial(uint index) {
+	material = materials[index];
+	materialTextureIndices = materialTextures[index];
+}
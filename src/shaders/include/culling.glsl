@@ -0,0 +1,46 @@
+// this file will be included by c++, so make sure everything compiles
+
+// Culling of nodes against the view frustum, shared by culling.comp and CullingPass::cullOnCpu(). The test is
+// conservative: a node is only culled if its bounding box is completely behind one of the frustum planes.
+
+#define CULLING_GROUP_SIZE 64
+
+// world space bounding box of a node, computed from the bounds of its mesh. w is unused
+struct NodeBounds {
+	vec4 boundsMin;
+	vec4 boundsMax;
+};
+
+// same layout as VkDrawIndexedIndirectCommand
+struct DrawIndexedIndirectCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+struct CullingUniforms {
+	// left, right, bottom, top, near, and far planes. xyz is the normal pointing into the frustum, and w is the offset,
+	// so that points inside satisfy dot(plane.xyz, p) + plane.w >= 0
+	vec4 frustumPlanes[6];
+	uint nodeCount;
+};
+
+// whether the box is completely on the negative side of the plane, i.e., whether the corner that is furthest along
+// the normal of the plane is behind it
+CPP_FUNCTION bool isAabbBehindPlane(vec4 plane, vec4 boundsMin, vec4 boundsMax) {
+	float x = plane.x > 0.0f ? boundsMax.x : boundsMin.x;
+	float y = plane.y > 0.0f ? boundsMax.y : boundsMin.y;
+	float z = plane.z > 0.0f ? boundsMax.z : boundsMin.z;
+	return plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f;
+}
+
+CPP_FUNCTION bool isNodeInFrustum(CullingUniforms uniforms, NodeBounds bounds) {
+	for (int i = 0; i < 6; ++i) {
+		if (isAabbBehindPlane(uniforms.frustumPlanes[i], bounds.boundsMin, bounds.boundsMax)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -6,3 +6,8 @@ vec3 fragCoordDepthToViewPos(vec2 uv, float worldDepth, float tanHalfFovY, float
 	uv.x *= aspectRatio;
 	return vec3(uv * worldDepth * tanHalfFovY, worldDepth);
 }
+// uv is in [0, 1], and depth is the value stored in the depth buffer
+vec3 uvDepthToWorldPos(vec2 uv, float depth, mat4 inverseProjectionView) {
+	vec4 pos = inverseProjectionView * vec4(uv * 2.0f - 1.0f, depth, 1.0f);
+	return pos.xyz / pos.w;
+}
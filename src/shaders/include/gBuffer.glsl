@@ -0,0 +1,38 @@
+// Usage: Define ALBEDO_TEXTURE, NORMAL_TEXTURE, MATERIAL_TEXTURE, and WORLD_POSITION_TEXTURE as the G-buffer samplers,
+// and INVERSE_PROJECTION_VIEW_MATRIX and SCREEN_SIZE as the matrix and the size of the G-buffer before including this
+// file. structs/restirStructs.glsl must be included before this file.
+//
+// With the compact layout, albedo and material properties are packed into one RGBA16 target and normals are stored
+// as octahedral RG16 vectors, see gBufferPacking.glsl. There is no world position target; positions are reconstructed
+// from depth. The G-buffer views for material properties and world positions are then the albedo and depth views.
+
+#include "gBufferPacking.glsl"
+#include "frustumUtils.glsl"
+
+layout (constant_id = COMPACT_GBUFFER_CONSTANT_ID) const bool COMPACT_GBUFFER = false;
+
+// returns albedo in rgb and whether the surface is emissive in a
+vec4 fetchGBufferAlbedo(ivec2 pixel) {
+	vec4 value = texelFetch(ALBEDO_TEXTURE, pixel, 0);
+	return COMPACT_GBUFFER ? unpackAlbedo(value) : value;
+}
+
+// returns zero for pixels without geometry
+vec3 fetchGBufferNormal(ivec2 pixel) {
+	vec4 value = texelFetch(NORMAL_TEXTURE, pixel, 0);
+	return COMPACT_GBUFFER ? decodeGBufferNormal(value.xy) : value.xyz;
+}
+
+vec2 fetchGBufferRoughnessMetallic(ivec2 pixel) {
+	vec4 value = texelFetch(MATERIAL_TEXTURE, pixel, 0);
+	return COMPACT_GBUFFER ? unpackRoughnessMetallic(value) : value.xy;
+}
+
+vec3 fetchGBufferWorldPosition(ivec2 pixel) {
+	vec4 value = texelFetch(WORLD_POSITION_TEXTURE, pixel, 0);
+	if (COMPACT_GBUFFER) {
+		vec2 uv = (vec2(pixel) + 0.5f) / vec2(SCREEN_SIZE);
+		return uvDepthToWorldPos(uv, value.x, INVERSE_PROJECTION_VIEW_MATRIX);
+	}
+	return value.xyz;
+}
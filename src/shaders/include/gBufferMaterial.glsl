@@ -0,0 +1,105 @@
+// Usage: Include this file in fragment shaders that write the G-buffer. structs/sceneStructs.glsl and
+// structs/restirStructs.glsl must be included before this file. With BINDLESS_MATERIALS defined, the requirements of
+// bindlessMaterials.glsl apply too, and loadMaterial() must be called before writeGBuffer().
+//
+// Declares the material descriptor sets of GBufferPass and the G-buffer outputs, and evaluates materials.
+
+#include "gBufferPacking.glsl"
+
+#ifdef BINDLESS_MATERIALS
+#	include "bindlessMaterials.glsl"
+#else
+layout (set = 2, binding = 0) uniform Material {
+	MaterialUniforms material;
+};
+
+layout (set = 3, binding = 0) uniform sampler2D uniAlbedo;
+layout (set = 3, binding = 1) uniform sampler2D uniNormal;
+layout (set = 3, binding = 2) uniform sampler2D uniMaterial;
+layout (set = 3, binding = 3) uniform sampler2D uniEmissiveTexture;
+#endif
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outMaterialProperties;
+layout (location = 3) out vec3 outWorldPosition;
+layout (location = 4) out vec2 outMotionVector;
+layout (location = 5) out uint outKey;
+
+// see gBuffer.glsl
+layout (constant_id = COMPACT_GBUFFER_CONSTANT_ID) const bool COMPACT_GBUFFER = false;
+
+// evaluates the material at the given surface point and writes all G-buffer outputs. uvDx and uvDy are the
+// screen-space derivatives of uv
+void writeGBuffer(
+	vec3 position, vec3 normal, vec4 tangent, vec2 uv, vec2 uvDx, vec2 uvDy,
+	vec4 clipPosition, vec4 prevFrameClipPosition
+) {
+	// compute baseColor or diffuse
+	vec4 albedo = textureGrad(uniAlbedo, uv, uvDx, uvDy) * material.colorParam;
+	if (material.alphaMode == ALPHA_MODE_MASK) {
+		if (albedo.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+	// the deferred pipeline doesn't support transparency; set alpha to 1
+	outAlbedo.rgb = albedo.rgb;
+
+	// compute normal
+	// this front facing flag may come in handy later when handling double-sided geometry
+	vec3 bitangent = /*(gl_FrontFacing ? 1.0f : -1.0f) **/ cross(normal, tangent.xyz) * tangent.w;
+	vec3 normalTex = textureGrad(
+		uniNormal, uv * material.normalTextureScale,
+		uvDx * material.normalTextureScale, uvDy * material.normalTextureScale
+	).xyz * 2.0f - 1.0f;
+	outNormal = normalize(normalTex.x * tangent.xyz + normalTex.y * bitangent + normalTex.z * normal);
+
+	// compute material properties
+	vec4 materialProp = textureGrad(uniMaterial, uv, uvDx, uvDy) * material.materialParam;
+	float roughness = 0.0f;
+	float metallic = 0.0f;
+	if (material.shadingModel == SHADING_MODEL_METALLIC_ROUGHNESS) {
+		roughness = materialProp.y;
+		metallic = materialProp.z;
+	} else if (material.shadingModel == SHADING_MODEL_SPECULAR_GLOSSINESS) {
+		roughness = 1.0f - materialProp.a;
+
+		// get metallic and adjust albedo
+		//
+		// - full metal have a diffuse of 0
+		// - full dielectric have a specular of 0.04
+		// diffuse = albedo * (1 - metalness)
+		// specular = lerp(0.04, albedo, metalness)
+		
+		vec3 average = 0.5f * (albedo.rgb + materialProp.rgb);
+		vec3 sqrtTerm = sqrt(average * average - 0.04f * albedo.rgb);
+		vec3 metallicRgb = 25.0f * average - sqrtTerm;
+
+		metallic = (metallicRgb.r + metallicRgb.g + metallicRgb.b) / 3.0f;
+		outAlbedo.rgb = average + sqrtTerm;
+	}
+
+	outMaterialProperties = vec2(roughness, metallic);
+
+	outWorldPosition = position;
+
+	// offset from this pixel to where the surface was in the previous frame, in normalized screen coordinates
+	outMotionVector =
+		0.5f * (prevFrameClipPosition.xy / prevFrameClipPosition.w - clipPosition.xy / clipPosition.w);
+	// w is the view-space depth
+	outKey = packGBufferKey(outNormal, clipPosition.w);
+	
+	if (length(material.emissiveFactor.xyz) > 0.0) {
+		// Emissive material
+		outAlbedo.xyz = material.colorParam.rgb * material.emissiveFactor.xyz * textureGrad(uniEmissiveTexture, uv, uvDx, uvDy).rgb;
+		outAlbedo.w = 1.0;
+	} else {
+		outAlbedo.w = 0.0;
+	}
+
+	if (COMPACT_GBUFFER) {
+		// the material properties and world position targets are not used
+		outAlbedo = packAlbedoMaterial(outAlbedo, outMaterialProperties);
+		outNormal = vec3(encodeGBufferNormal(outNormal), 0.0f);
+	}
+}
@@ -0,0 +1,80 @@
+// Compact encodings of G-buffer data.
+
+// Octahedral normal encoding, see "A Survey of Efficient Representations for Independent Unit Vectors" by Cigolle et
+// al. The result is in [-1, 1]^2.
+vec2 encodeOctahedral(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 result = n.xy;
+	if (n.z < 0.0f) {
+		result = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return result;
+}
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// The G-buffer key identifies the surface seen by a pixel and is used to validate temporal reprojection. It contains
+// the view-space depth as a half-precision float in the lower 16 bits, and the normal in the upper 16 bits. A key of
+// zero means that the pixel does not contain any geometry.
+uint packGBufferKey(vec3 normal, float viewDepth) {
+	uint depthBits = packHalf2x16(vec2(viewDepth, 0.0f)) & 0xFFFFu;
+	uint normalBits = packSnorm4x8(vec4(encodeOctahedral(normal), 0.0f, 0.0f)) & 0xFFFFu;
+	return depthBits | (normalBits << 16);
+}
+float getGBufferKeyDepth(uint key) {
+	return unpackHalf2x16(key).x;
+}
+vec3 getGBufferKeyNormal(uint key) {
+	return decodeOctahedral(unpackSnorm4x8(key >> 16).xy);
+}
+
+// whether two pixels with the given keys likely see the same surface
+bool isSameSurface(uint key, uint otherKey) {
+	if (key == 0 || otherKey == 0) {
+		return false;
+	}
+	float depth = getGBufferKeyDepth(key);
+	float otherDepth = getGBufferKeyDepth(otherKey);
+	if (abs(depth - otherDepth) > 0.1f * depth) {
+		return false;
+	}
+	return dot(getGBufferKeyNormal(key), getGBufferKeyNormal(otherKey)) > 0.9f;
+}
+
+// Normals in the compact G-buffer layout are stored in an RG16 snorm target. (-1, -1) marks pixels without geometry;
+// it decodes to the same normal as (1, 1), so valid normals never need it.
+vec2 encodeGBufferNormal(vec3 n) {
+	vec2 result = encodeOctahedral(n);
+	if (all(lessThan(result, vec2(-1.0f + 0.5f / 32767.0f)))) {
+		result = vec2(1.0f);
+	}
+	return result;
+}
+vec3 decodeGBufferNormal(vec2 e) {
+	if (all(equal(e, vec2(-1.0f)))) {
+		return vec3(0.0f);
+	}
+	return decodeOctahedral(e);
+}
+
+// Albedo and material properties in the compact G-buffer layout are stored in an RGBA16 unorm target. Alpha contains
+// 8 bits of roughness, 7 bits of metallic, and the emissive flag in the highest bit.
+vec4 packAlbedoMaterial(vec4 albedo, vec2 roughnessMetallic) {
+	uvec2 quantized = uvec2(round(clamp(roughnessMetallic, 0.0f, 1.0f) * vec2(255.0f, 127.0f)));
+	uint bits = quantized.x | (quantized.y << 8) | (albedo.a > 0.5f ? 1u << 15 : 0u);
+	return vec4(albedo.rgb, float(bits) / 65535.0f);
+}
+// returns albedo in rgb and the emissive flag in a
+vec4 unpackAlbedo(vec4 packed) {
+	uint bits = uint(round(packed.a * 65535.0f));
+	return vec4(packed.rgb, (bits & (1u << 15)) != 0 ? 1.0f : 0.0f);
+}
+vec2 unpackRoughnessMetallic(vec4 packed) {
+	uint bits = uint(round(packed.a * 65535.0f));
+	return vec2(bits & 0xFFu, (bits >> 8) & 0x7Fu) / vec2(255.0f, 127.0f);
+}
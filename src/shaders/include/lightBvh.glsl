@@ -0,0 +1,55 @@
+// Usage: Define LIGHT_BVH_BUFFER as the name of the shader storage buffer containing the light BVH nodes before
+// including this file. structs/lightBvh.glsl, rand.glsl, and disneyBRDF.glsl must also be included beforehand.
+
+// Conservative estimate of the contribution of all lights in the node to a shading point, following "Importance
+// Sampling of Many Lights with Adaptive Tree Splitting" by Conty Estevez and Kulla.
+float lightBvhNodeImportance(LightBvhNode node, vec3 pos, vec3 normal) {
+	vec3 halfExtent = 0.5f * (node.aabbMax_cosTheta.xyz - node.aabbMin_power.xyz);
+	vec3 toCenter = node.aabbMin_power.xyz + halfExtent - pos;
+	float sqrRadius = dot(halfExtent, halfExtent);
+	float sqrDist = dot(toCenter, toCenter);
+	vec3 wi = toCenter * inversesqrt(max(sqrDist, 1e-12f));
+
+	// half angle of the cone of directions from pos towards the bounding sphere of the node
+	float thetaU = sqrDist > sqrRadius ? asin(sqrt(sqrRadius / sqrDist)) : M_PI;
+	sqrDist = max(max(sqrDist, sqrRadius), 1e-6f);
+
+	// the lights are two-sided
+	float thetaO = acos(node.aabbMax_cosTheta.w);
+	float theta = acos(min(abs(dot(node.axis.xyz, wi)), 1.0f));
+	float cosThetaPrime = max(cos(max(theta - thetaO - thetaU, 0.0f)), 0.0f);
+
+	float thetaI = acos(clamp(dot(normal, wi), -1.0f, 1.0f));
+	float cosThetaIPrime = max(cos(max(thetaI - thetaU, 0.0f)), 0.0f);
+
+	return node.aabbMin_power.w * cosThetaPrime * cosThetaIPrime / sqrDist;
+}
+
+// Samples a light by stochastically traversing the light BVH, choosing each child with probability proportional to
+// its importance. Returns the index of the light in the list of all point lights followed by all triangle lights, and
+// the probability of picking that light.
+int sampleLightBvh(vec3 pos, vec3 normal, inout Rand rand, out float probability) {
+	probability = 1.0f;
+	LightBvhNode node = LIGHT_BVH_BUFFER.nodes[0];
+	while (node.leftChild >= 0) {
+		LightBvhNode left = LIGHT_BVH_BUFFER.nodes[node.leftChild];
+		LightBvhNode right = LIGHT_BVH_BUFFER.nodes[node.rightChild];
+		float leftImportance = lightBvhNodeImportance(left, pos, normal);
+		float rightImportance = lightBvhNodeImportance(right, pos, normal);
+		if (leftImportance + rightImportance <= 0.0f) {
+			// fall back to power so that no light ends up with a zero probability
+			leftImportance = left.aabbMin_power.w;
+			rightImportance = right.aabbMin_power.w;
+		}
+		float sumImportance = leftImportance + rightImportance;
+		float leftProbability = sumImportance > 0.0f ? leftImportance / sumImportance : 0.5f;
+		if (randFloat(rand) < leftProbability) {
+			node = left;
+			probability *= leftProbability;
+		} else {
+			node = right;
+			probability *= 1.0f - leftProbability;
+		}
+	}
+	return ~node.leftChild;
+}
@@ -0,0 +1,28 @@
+// Usage: Define POINT_LIGHT_BUFFER and ALIAS_TABLE_BUFFER as the names of the shader storage buffers before including
+// this file. packedLight.glsl must be included before this file.
+
+// The point is computed from the quantized barycentric coordinates, so that it can be reconstructed exactly from a
+// PackedReservoir.
+vec3 pickPointOnTriangle(float r1, float r2, triLight light, out uint barycentrics) {
+	float sqrt_r1 = sqrt(r1);
+	barycentrics = packUnorm2x16(vec2(sqrt_r1 * (1.0 - r2), r2 * sqrt_r1));
+	return triLightPointAt(light, barycentrics).xyz;
+}
+
+// Converts an index into the list of all point lights followed by all triangle lights into the convention used by
+// Reservoir.lightIndex: non-negative for point lights, and -1 - i for triangle light i.
+int toReservoirLightIndex(int index) {
+	return index < POINT_LIGHT_BUFFER.count ? index : -1 - (index - POINT_LIGHT_BUFFER.count);
+}
+
+void aliasTableSample(float r1, float r2, out int index, out float probability) {
+	int selected_column = min(int(ALIAS_TABLE_BUFFER.count * r1), ALIAS_TABLE_BUFFER.count - 1);
+	aliasTableColumn col = ALIAS_TABLE_BUFFER.aliasCol[selected_column];
+	if (col.prob > r2) {
+		index = selected_column;
+		probability = col.oriProb;
+	} else {
+		index = col.alias;
+		probability = col.aliasOriProb;
+	}
+}
@@ -0,0 +1,96 @@
+// this file will be included by c++, so make sure everything compiles
+// common.glsl must be included before this file
+
+// Compact light records. Positions are stored as individual floats so that the records are tightly packed, while
+// emission colors and triangle edges are stored as half-precision floats. Luminance, normals, and areas are derived
+// when decoding.
+
+struct PackedPointLight {
+	float posX;
+	float posY;
+	float posZ;
+	uint emissionRG;
+	uint emissionB;
+};
+
+struct PackedTriLight {
+	float p1X;
+	float p1Y;
+	float p1Z;
+	uint edge1XY; // edge1 = p2 - p1
+	uint edge1ZEdge2X; // edge2 = p3 - p1
+	uint edge2YZ;
+	uint emissionRG;
+	uint emissionB;
+};
+
+// returns the emission color in xyz, and its luminance in w
+CPP_FUNCTION vec4 decodeEmission(uint emissionRG, uint emissionB) {
+	vec2 rg = unpackHalf2x16(emissionRG);
+	float b = unpackHalf2x16(emissionB).x;
+	return vec4(rg.x, rg.y, b, luminance(rg.x, rg.y, b));
+}
+
+CPP_FUNCTION PackedPointLight encodePointLight(pointLight light) {
+	PackedPointLight result;
+	result.posX = light.pos.x;
+	result.posY = light.pos.y;
+	result.posZ = light.pos.z;
+	result.emissionRG = packHalf2x16(vec2(light.color_luminance.x, light.color_luminance.y));
+	result.emissionB = packHalf2x16(vec2(light.color_luminance.z, 0.0f));
+	return result;
+}
+
+CPP_FUNCTION pointLight decodePointLight(PackedPointLight light) {
+	pointLight result;
+	result.pos = vec4(light.posX, light.posY, light.posZ, 1.0f);
+	result.color_luminance = decodeEmission(light.emissionRG, light.emissionB);
+	return result;
+}
+
+CPP_FUNCTION PackedTriLight encodeTriLight(triLight light) {
+	PackedTriLight result;
+	result.p1X = light.p1.x;
+	result.p1Y = light.p1.y;
+	result.p1Z = light.p1.z;
+	result.edge1XY = packHalf2x16(vec2(light.p2.x - light.p1.x, light.p2.y - light.p1.y));
+	result.edge1ZEdge2X = packHalf2x16(vec2(light.p2.z - light.p1.z, light.p3.x - light.p1.x));
+	result.edge2YZ = packHalf2x16(vec2(light.p3.y - light.p1.y, light.p3.z - light.p1.z));
+	result.emissionRG = packHalf2x16(vec2(light.emission_luminance.x, light.emission_luminance.y));
+	result.emissionB = packHalf2x16(vec2(light.emission_luminance.z, 0.0f));
+	return result;
+}
+
+CPP_FUNCTION triLight decodeTriLight(PackedTriLight light) {
+	vec2 edge1XY = unpackHalf2x16(light.edge1XY);
+	vec2 edge1ZEdge2X = unpackHalf2x16(light.edge1ZEdge2X);
+	vec2 edge2YZ = unpackHalf2x16(light.edge2YZ);
+
+	// cross(edge1, edge2)
+	float normalX = edge1XY.y * edge2YZ.y - edge1ZEdge2X.x * edge2YZ.x;
+	float normalY = edge1ZEdge2X.x * edge1ZEdge2X.y - edge1XY.x * edge2YZ.y;
+	float normalZ = edge1XY.x * edge2YZ.x - edge1XY.y * edge1ZEdge2X.y;
+	float normalLength = sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+	float invNormalLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+
+	triLight result;
+	result.p1 = vec4(light.p1X, light.p1Y, light.p1Z, 1.0f);
+	result.p2 = vec4(light.p1X + edge1XY.x, light.p1Y + edge1XY.y, light.p1Z + edge1ZEdge2X.x, 1.0f);
+	result.p3 = vec4(light.p1X + edge1ZEdge2X.y, light.p1Y + edge2YZ.x, light.p1Z + edge2YZ.y, 1.0f);
+	result.emission_luminance = decodeEmission(light.emissionRG, light.emissionB);
+	result.normalArea = vec4(
+		normalX * invNormalLength, normalY * invNormalLength, normalZ * invNormalLength, 0.5f * normalLength
+	);
+	return result;
+}
+
+// returns the point on the triangle with the given barycentric coordinates for p2 and p3, packed as two 16-bit unorms
+CPP_FUNCTION vec4 triLightPointAt(triLight light, uint barycentrics) {
+	vec2 b = unpackUnorm2x16(barycentrics);
+	return vec4(
+		light.p1.x + b.x * (light.p2.x - light.p1.x) + b.y * (light.p3.x - light.p1.x),
+		light.p1.y + b.x * (light.p2.y - light.p1.y) + b.y * (light.p3.y - light.p1.y),
+		light.p1.z + b.x * (light.p2.z - light.p1.z) + b.y * (light.p3.z - light.p1.z),
+		1.0f
+	);
+}
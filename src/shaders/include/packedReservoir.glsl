@@ -0,0 +1,94 @@
+// Usage: Define POINT_LIGHT_BUFFER and TRIANGLE_LIGHT_BUFFER as the names of the shader storage buffers before
+// including this file. structs/light.glsl, structs/restirStructs.glsl, and packedLight.glsl must be included before
+// this file.
+
+#include "reservoirLayout.glsl"
+
+layout (constant_id = RESERVOIR_LAYOUT_CONSTANT_ID) const uint RESERVOIR_LAYOUT = RESERVOIR_LAYOUT_LINEAR;
+layout (constant_id = HALF_RES_RESTIR_CONSTANT_ID) const bool HALF_RES_RESTIR = false;
+
+// size of the grid of reservoirs, see reservoirLayout.glsl
+uvec2 getReservoirGridSize(uvec2 screenSize) {
+	return getReservoirGridSize(screenSize, HALF_RES_RESTIR);
+}
+// the pixel that a reservoir is generated for
+uvec2 getReservoirPixel(uvec2 reservoir) {
+	return HALF_RES_RESTIR ? reservoir * 2 : reservoir;
+}
+// the reservoir generated for the 2x2 block that contains the pixel
+uvec2 getPixelReservoir(uvec2 pixel) {
+	return HALF_RES_RESTIR ? pixel / 2 : pixel;
+}
+
+// index of the given reservoir in reservoir buffers
+uint getReservoirIndex(uvec2 reservoir, uvec2 gridSize) {
+	return getReservoirIndex(reservoir, gridSize, RESERVOIR_LAYOUT);
+}
+
+PackedReservoir packReservoir(Reservoir res) {
+	PackedReservoir result;
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		result.samples[i].lightIndex = res.samples[i].lightIndex;
+		result.samples[i].barycentrics = res.samples[i].barycentrics;
+		result.samples[i].w = res.samples[i].w;
+#ifdef UNBIASED_MIS
+		result.samples[i].sumPHat = res.samples[i].sumPHat;
+#endif
+	}
+	result.numStreamSamples = res.numStreamSamples;
+	return result;
+}
+
+// pHat and sumWeights depend on the pixel that owns the reservoir and are set to zero. Call restoreReservoirWeights()
+// before adding samples to a reservoir unpacked at the pixel that owns it.
+Reservoir unpackReservoir(PackedReservoir packed) {
+	Reservoir result;
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		int lightIndex = packed.samples[i].lightIndex;
+		uint barycentrics = packed.samples[i].barycentrics;
+		// samples with zero weight do not necessarily refer to a valid light
+		if (packed.samples[i].w <= 0.0f) {
+			result.samples[i].position_emissionLum = vec4(0.0f);
+			result.samples[i].normal = vec4(0.0f);
+		} else if (lightIndex >= 0) {
+			pointLight light = decodePointLight(POINT_LIGHT_BUFFER.lights[lightIndex]);
+			result.samples[i].position_emissionLum = vec4(light.pos.xyz, light.color_luminance.w);
+			result.samples[i].normal = vec4(0.0f);
+		} else {
+			triLight light = decodeTriLight(TRIANGLE_LIGHT_BUFFER.lights[-1 - lightIndex]);
+			result.samples[i].position_emissionLum = vec4(
+				triLightPointAt(light, barycentrics).xyz, light.emission_luminance.w
+			);
+			result.samples[i].normal = vec4(light.normalArea.xyz, 1.0f);
+		}
+		result.samples[i].lightIndex = lightIndex;
+		result.samples[i].barycentrics = barycentrics;
+		result.samples[i].pHat = 0.0f;
+		result.samples[i].sumWeights = 0.0f;
+		result.samples[i].w = packed.samples[i].w;
+#ifdef UNBIASED_MIS
+		result.samples[i].sumPHat = packed.samples[i].sumPHat;
+#endif
+	}
+	result.numStreamSamples = packed.numStreamSamples;
+	return result;
+}
+
+// pHat contains the target function of each sample evaluated at the pixel that owns the reservoir. sumWeights is set to
+// w * numStreamSamples * pHat, the weight that combineReservoirs() gives a reservoir that is merged into another one,
+// so that the reservoir enters further reuse in the same way as its neighbors. This is the sum of weights that the
+// sample was resampled from only for reservoirs produced by addSampleToReservoir() and combineReservoirs(). The
+// unbiased reuse pass normalizes w by the number of samples whose domain contains the sample (or by the sum of their
+// pHat with UNBIASED_MIS) instead of by numStreamSamples, and the original sum cannot be recovered from the packed
+// reservoir, which is also not needed since w is already an unbiased contribution weight.
+void restoreReservoirWeights(inout Reservoir res, float pHat[RESERVOIR_SIZE]) {
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		if (res.samples[i].w > 0.0f) {
+			res.samples[i].pHat = pHat[i];
+			res.samples[i].sumWeights = res.samples[i].w * res.numStreamSamples * pHat[i];
+		} else {
+			res.samples[i].pHat = 0.0f;
+			res.samples[i].sumWeights = 0.0f;
+		}
+	}
+}
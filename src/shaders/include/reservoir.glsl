@@ -5,7 +5,7 @@
 
 void updateReservoirAt(
 	inout Reservoir res, int i, float weight, vec3 position, vec4 normal, float emissionLum, int lightIdx,
-	float pHat, float w,
+	uint barycentrics, float pHat, float w,
 #ifdef UNBIASED_MIS
 	float sumPHat,
 #endif
@@ -17,6 +17,7 @@ void updateReservoirAt(
 		res.samples[i].position_emissionLum = vec4(position, emissionLum);
 		res.samples[i].normal = normal;
 		res.samples[i].lightIndex = lightIdx;
+		res.samples[i].barycentrics = barycentrics;
 		res.samples[i].pHat = pHat;
 		res.samples[i].w = w;
 #ifdef UNBIASED_MIS
@@ -25,19 +26,25 @@ void updateReservoirAt(
 	}
 }
 
-void addSampleToReservoir(inout Reservoir res, vec3 position, vec4 normal, float emissionLum, int lightIdx, float pHat, float sampleP, inout Rand rand) {
+void addSampleToReservoir(
+	inout Reservoir res, vec3 position, vec4 normal, float emissionLum, int lightIdx, uint barycentrics,
+	float pHat, float sampleP, inout Rand rand
+) {
 	float weight = pHat / sampleP;
 	res.numStreamSamples += 1;
 
 	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-		float w = (res.samples[i].sumWeights + weight) / (res.numStreamSamples * pHat);
 		updateReservoirAt(
-			res, i, weight, position, normal, emissionLum, lightIdx, pHat, w,
+			res, i, weight, position, normal, emissionLum, lightIdx, barycentrics, pHat, 0.0f,
 #ifdef UNBIASED_MIS
 			pHat,
 #endif
 			rand
 		);
+		// keep w up to date even if the sample is not replaced, so that the sum of weights can be recovered from it
+		if (res.samples[i].sumWeights > 0.0f) {
+			res.samples[i].w = res.samples[i].sumWeights / (res.numStreamSamples * res.samples[i].pHat);
+		}
 	}
 }
 
@@ -50,7 +57,7 @@ void combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVO
 			updateReservoirAt(
 				self, i, weight,
 				other.samples[i].position_emissionLum.xyz, other.samples[i].normal, other.samples[i].position_emissionLum.w,
-				other.samples[i].lightIndex, pHat[i],
+				other.samples[i].lightIndex, other.samples[i].barycentrics, pHat[i],
 #ifdef UNBIASED_MIS
 				other.samples[i].sumPHat,
 #endif
@@ -66,7 +73,13 @@ void combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVO
 Reservoir newReservoir() {
 	Reservoir result;
 	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		result.samples[i].position_emissionLum = vec4(0.0f);
+		result.samples[i].normal = vec4(0.0f);
+		result.samples[i].lightIndex = 0;
+		result.samples[i].barycentrics = 0;
+		result.samples[i].pHat = 0.0f;
 		result.samples[i].sumWeights = 0.0f;
+		result.samples[i].w = 0.0f;
 #ifdef UNBIASED_MIS
 		result.samples[i].sumPHat = 0.0f;
 #endif
@@ -0,0 +1,44 @@
+// this file will be included by c++, so make sure everything compiles
+
+// With half-resolution ReSTIR, there is one reservoir for every 2x2 pixels, generated for the top left pixel. All
+// functions below take positions and sizes of this reservoir grid instead of the screen.
+CPP_FUNCTION uvec2 getReservoirGridSize(uvec2 screenSize, bool halfResolution) {
+	if (halfResolution) {
+		return uvec2((screenSize.x + 1) / 2, (screenSize.y + 1) / 2);
+	}
+	return screenSize;
+}
+
+// Reservoirs are either stored in row-major order (RESERVOIR_LAYOUT_LINEAR), or in tiles of RESERVOIR_TILE_SIZE x
+// RESERVOIR_TILE_SIZE pixels (RESERVOIR_LAYOUT_TILED). The tiles are stored in row-major order, and the pixels inside
+// each tile in Z-order, so that pixels that are close on screen are also close in memory. With the tiled layout, the
+// buffer is padded to a whole number of tiles.
+
+// spreads the lower 8 bits of x to the even bits of the result
+CPP_FUNCTION uint mortonSpreadBits(uint x) {
+	x = (x | (x << 4)) & 0x0F0Fu;
+	x = (x | (x << 2)) & 0x3333u;
+	x = (x | (x << 1)) & 0x5555u;
+	return x;
+}
+
+CPP_FUNCTION uint getReservoirIndex(uvec2 pixel, uvec2 gridSize, uint reservoirLayout) {
+	if (reservoirLayout == RESERVOIR_LAYOUT_TILED) {
+		uint numTilesX = (gridSize.x + RESERVOIR_TILE_SIZE - 1) / RESERVOIR_TILE_SIZE;
+		uint tileIndex = (pixel.y / RESERVOIR_TILE_SIZE) * numTilesX + pixel.x / RESERVOIR_TILE_SIZE;
+		uint indexInTile =
+			mortonSpreadBits(pixel.x % RESERVOIR_TILE_SIZE) | (mortonSpreadBits(pixel.y % RESERVOIR_TILE_SIZE) << 1);
+		return tileIndex * (RESERVOIR_TILE_SIZE * RESERVOIR_TILE_SIZE) + indexInTile;
+	}
+	return pixel.y * gridSize.x + pixel.x;
+}
+
+// number of reservoirs in a reservoir buffer, including padding
+CPP_FUNCTION uint getReservoirCount(uvec2 gridSize, uint reservoirLayout) {
+	if (reservoirLayout == RESERVOIR_LAYOUT_TILED) {
+		uint numTilesX = (gridSize.x + RESERVOIR_TILE_SIZE - 1) / RESERVOIR_TILE_SIZE;
+		uint numTilesY = (gridSize.y + RESERVOIR_TILE_SIZE - 1) / RESERVOIR_TILE_SIZE;
+		return numTilesX * numTilesY * (RESERVOIR_TILE_SIZE * RESERVOIR_TILE_SIZE);
+	}
+	return gridSize.x * gridSize.y;
+}
@@ -0,0 +1,100 @@
+// Usage: Define RESERVOIR_BUFFER as the name of the packed reservoir array, and DEPTH_TEXTURE as the depth sampler
+// before including this file. gBuffer.glsl must be included before this file. Additionally define
+// REUSE_TILE_WORLD_POSITION if world positions of neighbors are needed, and REUSE_TILE_UNAVAILABLE for shader stages
+// without shared memory, in which case all neighbors are fetched from global memory.
+//
+// When TILED_REUSE is enabled, each workgroup loads the reservoirs and G-buffer data of its pixels and an apron of
+// TILE_APRON pixels around them into shared memory, and neighbors are picked within TILE_APRON pixels. The tile must
+// be loaded with loadReuseTile() by all invocations before any of them returns.
+//
+// Positions and sizes are those of the reservoir grid, see getReservoirGridSize(). G-buffer data is fetched at the
+// pixels that the reservoirs are generated for.
+
+#ifdef REUSE_TILE_UNAVAILABLE
+const bool TILED_REUSE = false;
+const uint TILE_APRON = 0;
+
+void loadReuseTile(uvec2 gridSize) {
+}
+#else
+layout (constant_id = TILED_REUSE_CONSTANT_ID) const bool TILED_REUSE = false;
+layout (constant_id = TILE_APRON_CONSTANT_ID) const uint TILE_APRON = 0;
+
+// TILE_APRON is zero when tiled reuse is disabled, so these are only as large as the workgroup in that case
+const uint TILE_SIZE_X = gl_WorkGroupSize.x + 2 * TILE_APRON;
+const uint TILE_SIZE_Y = gl_WorkGroupSize.y + 2 * TILE_APRON;
+
+shared PackedReservoir tileReservoirs[TILE_SIZE_X * TILE_SIZE_Y];
+shared vec4 tileNormalDepth[TILE_SIZE_X * TILE_SIZE_Y];
+#	ifdef REUSE_TILE_WORLD_POSITION
+shared vec4 tileWorldPosition[TILE_SIZE_X * TILE_SIZE_Y];
+#	endif
+
+// pixel that corresponds to the first element of the tile
+ivec2 tileOrigin;
+
+void loadReuseTile(uvec2 gridSize) {
+	tileOrigin = ivec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy) - int(TILE_APRON);
+	uint groupSize = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+	for (uint i = gl_LocalInvocationIndex; i < TILE_SIZE_X * TILE_SIZE_Y; i += groupSize) {
+		ivec2 reservoir = clamp(
+			tileOrigin + ivec2(i % TILE_SIZE_X, i / TILE_SIZE_X), ivec2(0), ivec2(gridSize) - 1
+		);
+		ivec2 pixel = ivec2(getReservoirPixel(uvec2(reservoir)));
+		tileReservoirs[i] = RESERVOIR_BUFFER[getReservoirIndex(uvec2(reservoir), gridSize)];
+		tileNormalDepth[i] = vec4(fetchGBufferNormal(pixel), texelFetch(DEPTH_TEXTURE, pixel, 0).x);
+#	ifdef REUSE_TILE_WORLD_POSITION
+		tileWorldPosition[i] = vec4(fetchGBufferWorldPosition(pixel), 1.0f);
+#	endif
+	}
+	barrier();
+}
+
+uint getReuseTileIndex(ivec2 reservoir) {
+	ivec2 tilePixel = reservoir - tileOrigin;
+	return tilePixel.y * TILE_SIZE_X + tilePixel.x;
+}
+#endif
+
+// maximum distance of neighbors to the current reservoir, given a radius in screen pixels
+float getReuseRadius(float radius) {
+	if (HALF_RES_RESTIR) {
+		radius *= 0.5f;
+	}
+	return TILED_REUSE ? min(radius, float(TILE_APRON)) : radius;
+}
+
+// the functions below take the position of the neighbor before it's clamped to the grid, which must be at most
+// getReuseRadius() away from the current reservoir along both axes
+PackedReservoir fetchReuseNeighborReservoir(ivec2 reservoir, uvec2 gridSize) {
+#ifndef REUSE_TILE_UNAVAILABLE
+	if (TILED_REUSE) {
+		return tileReservoirs[getReuseTileIndex(reservoir)];
+	}
+#endif
+	reservoir = clamp(reservoir, ivec2(0), ivec2(gridSize) - 1);
+	return RESERVOIR_BUFFER[getReservoirIndex(uvec2(reservoir), gridSize)];
+}
+
+// returns the normal in xyz and depth in w
+vec4 fetchReuseNeighborNormalDepth(ivec2 reservoir, uvec2 gridSize) {
+#ifndef REUSE_TILE_UNAVAILABLE
+	if (TILED_REUSE) {
+		return tileNormalDepth[getReuseTileIndex(reservoir)];
+	}
+#endif
+	ivec2 pixel = ivec2(getReservoirPixel(uvec2(clamp(reservoir, ivec2(0), ivec2(gridSize) - 1))));
+	return vec4(fetchGBufferNormal(pixel), texelFetch(DEPTH_TEXTURE, pixel, 0).x);
+}
+
+#ifdef REUSE_TILE_WORLD_POSITION
+vec3 fetchReuseNeighborWorldPosition(ivec2 reservoir, uvec2 gridSize) {
+#	ifndef REUSE_TILE_UNAVAILABLE
+	if (TILED_REUSE) {
+		return tileWorldPosition[getReuseTileIndex(reservoir)].xyz;
+	}
+#	endif
+	ivec2 pixel = ivec2(getReservoirPixel(uvec2(clamp(reservoir, ivec2(0), ivec2(gridSize) - 1))));
+	return fetchGBufferWorldPosition(pixel);
+}
+#endif
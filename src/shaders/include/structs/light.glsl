@@ -18,3 +18,12 @@ struct aliasTableColumn {
 	float oriProb;
 	float aliasOriProb;
 };
+
+// A light sample drawn from the alias table by the light tiles pre-pass
+struct LightTileSample {
+	vec4 position_emissionLum;
+	vec4 normal; // w is 1 for triangle lights and 0 for point lights
+	int lightIndex; // negative for triangle lights
+	float probability; // for triangle lights, this is with respect to area
+	uint barycentrics; // for triangle lights, see PackedLightSample
+};
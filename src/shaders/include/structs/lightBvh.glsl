@@ -0,0 +1,11 @@
+// Light BVH nodes. Leaves and interior nodes are stored in the same array, with the root at index 0. All lights are
+// treated as two-sided emitters with a hemispherical emission profile, so only the normal bound of the orientation
+// cone is stored; for two-sided lights the cone covers both its axis and the opposite direction.
+struct LightBvhNode {
+	vec4 aabbMin_power; // xyz: minimum of the bounding box, w: total power of all lights in this subtree
+	vec4 aabbMax_cosTheta; // xyz: maximum of the bounding box, w: cosine of the normal bound angle of the cone
+	vec4 axis; // xyz: axis of the orientation cone
+	// for leaf nodes, leftChild is ~i where i indexes the list of all point lights followed by all triangle lights
+	int leftChild;
+	int rightChild;
+};
@@ -1,5 +1,5 @@
 struct LightingPassUniforms{
-	mat4 prevFrameProjectionViewMatrix;
+	mat4 inverseProjectionViewMatrix;
 	vec4 cameraPos;
 	uvec2 bufferSize;
 	int debugMode;
@@ -1,25 +1,55 @@
+// default values of the group size specialization constants
 #define LIGHT_SAMPLE_GROUP_SIZE_X 64
 #define LIGHT_SAMPLE_GROUP_SIZE_Y 1
 
-#define SW_VISIBILITY_TEST_GROUP_SIZE_X 64
-#define SW_VISIBILITY_TEST_GROUP_SIZE_Y 1
+#define SW_VISIBILITY_TEST_GROUP_SIZE_X 8
+#define SW_VISIBILITY_TEST_GROUP_SIZE_Y 8
 
 #define TEMPORAL_REUSE_GROUP_SIZE_X 64
 #define TEMPORAL_REUSE_GROUP_SIZE_Y 1
 
-#define OMNI_GROUP_SIZE_X 64
-#define OMNI_GROUP_SIZE_Y 1
+#define OMNI_GROUP_SIZE_X 8
+#define OMNI_GROUP_SIZE_Y 8
 
-#define UNBIASED_REUSE_GROUP_SIZE_X 64
-#define UNBIASED_REUSE_GROUP_SIZE_Y 1
+#define UNBIASED_REUSE_GROUP_SIZE_X 8
+#define UNBIASED_REUSE_GROUP_SIZE_Y 8
 
+#define LIGHT_TILE_GROUP_SIZE_X 64
+
+#define LIGHT_TILE_COUNT 128
+#define LIGHT_TILE_SIZE 256
+#define LIGHT_TILE_SCREEN_TILE_SIZE 8
+
+// specialization constant ids, see RestirShaderConfig
+#define GROUP_SIZE_X_CONSTANT_ID 0
+#define GROUP_SIZE_Y_CONSTANT_ID 1
+#define UNBIASED_REUSE_NEIGHBORS_CONSTANT_ID 2
+#define TILED_REUSE_CONSTANT_ID 3
+#define TILE_APRON_CONSTANT_ID 4
+#define RESERVOIR_LAYOUT_CONSTANT_ID 5
+#define COMPACT_GBUFFER_CONSTANT_ID 6
+#define HALF_RES_RESTIR_CONSTANT_ID 7
+#define PAIRWISE_MIS_CONSTANT_ID 8
+
+#define UNBIASED_REUSE_NEIGHBORS 3
+#define REUSE_TILE_APRON 8
+
+// see reservoirLayout.glsl
+#define RESERVOIR_LAYOUT_LINEAR 0
+#define RESERVOIR_LAYOUT_TILED 1
+#define RESERVOIR_TILE_SIZE 8
+
+// these change the layout of reservoirs, so they're set when compiling the shaders instead
 /*#define UNBIASED_MIS*/
-#define RESERVOIR_SIZE 1
+#ifndef RESERVOIR_SIZE
+#	define RESERVOIR_SIZE 1
+#endif
 
 struct LightSample {
 	vec4 position_emissionLum;
 	vec4 normal;
 	int lightIndex; // negative for triangle lights
+	uint barycentrics; // for triangle lights, see PackedLightSample
 	float pHat;
 	float sumWeights;
 	float w;
@@ -33,12 +63,32 @@ struct Reservoir {
 	uint numStreamSamples;
 };
 
+// Reservoirs are stored in this form between passes. Light positions, normals, and emission are fetched from the light
+// buffers when unpacking, and the sum of weights is recovered from w, the number of samples, and the target function at
+// the pixel that owns the reservoir. See packedReservoir.glsl.
+struct PackedLightSample {
+	int lightIndex; // negative for triangle lights
+	uint barycentrics; // barycentric coordinates of p2 and p3 as two 16-bit unorms, only used by triangle lights
+	float w;
+#ifdef UNBIASED_MIS
+	float sumPHat;
+#endif
+};
+
+struct PackedReservoir {
+	PackedLightSample samples[RESERVOIR_SIZE];
+	uint numStreamSamples;
+};
+
 
 #define RESTIR_VISIBILITY_REUSE_FLAG (1 << 0)
 #define RESTIR_TEMPORAL_REUSE_FLAG (1 << 1)
+#define RESTIR_LIGHT_BVH_SAMPLING_FLAG (1 << 2)
+#define RESTIR_LIGHT_TILES_SAMPLING_FLAG (1 << 3)
+#define RESTIR_ADAPTIVE_SAMPLING_FLAG (1 << 4)
 
 struct RestirUniforms {
-	mat4 prevFrameProjectionViewMatrix;
+	mat4 inverseProjectionViewMatrix;
 	vec4 cameraPos;
 	uvec2 screenSize;
 	uint frame;
@@ -53,4 +103,8 @@ struct RestirUniforms {
 	float spatialRadius;
 
 	int flags;
+
+	// lower bound of the number of candidates with RESTIR_ADAPTIVE_SAMPLING_FLAG, in which case
+	// initialLightSampleCount is the upper bound
+	uint minInitialLightSampleCount;
 };
@@ -1,8 +1,34 @@
 struct ModelMatrices {
 	mat4 transform;
 	mat4 transformInverseTransposed;
+	mat4 prevFrameTransform; // used for motion vectors
 };
 
+struct GBufferUniforms {
+	mat4 projectionViewMatrix;
+	mat4 prevFrameProjectionViewMatrix;
+	mat4 inverseProjectionViewMatrix;
+	uvec2 screenSize;
+};
+
+// draw parameters of a node, used to resolve the visibility buffer
+struct NodeDrawInfo {
+	uint firstIndex;
+	int vertexOffset;
+	uint materialIndex;
+	uint indexCount;
+};
+
+// layout of Vertex in vertex.h, in floats
+#define VERTEX_FLOAT_COUNT 20 // including padding at the end
+#define VERTEX_POSITION_OFFSET 0
+#define VERTEX_NORMAL_OFFSET 4
+#define VERTEX_TANGENT_OFFSET 8
+#define VERTEX_UV_OFFSET 16
+
+// value of visibility buffer pixels without geometry
+#define VISIBILITY_BUFFER_EMPTY 0xFFFFFFFFu
+
 
 #define SHADING_MODEL_METALLIC_ROUGHNESS 0
 #define SHADING_MODEL_SPECULAR_GLOSSINESS 1
@@ -30,3 +56,11 @@ struct MaterialUniforms {
 	float alphaCutoff;
 	float normalTextureScale;
 };
+
+// indices of the textures of a material in the texture array of bindless materials, see bindlessMaterials.glsl
+struct MaterialTextures {
+	uint albedo;
+	uint normal;
+	uint material;
+	uint emissive;
+};
@@ -0,0 +1,38 @@
+// Helpers for the visibility buffer mode of GBufferPass. Pixels are first classified by material by writing
+// getMaterialDepth() to a depth buffer, then each material is resolved by a fullscreen draw at that depth with an
+// equality depth test.
+
+#include "frustumUtils.glsl"
+
+// depth of pixels of the given material in the 16-bit material depth buffer. the buffer is cleared to 1, which does
+// not correspond to any material
+float getMaterialDepth(uint materialIndex) {
+	return float(materialIndex + 1) / 65535.0f;
+}
+
+// a ray through the given position on the screen, where uv is in [0, 1]. the direction is not normalized
+void getScreenRay(vec2 uv, mat4 inverseProjectionView, out vec3 origin, out vec3 direction) {
+	origin = uvDepthToWorldPos(uv, 0.0f, inverseProjectionView);
+	direction = uvDepthToWorldPos(uv, 1.0f, inverseProjectionView) - origin;
+}
+
+// barycentric coordinates of p1 and p2 at the intersection of a ray and the plane of the triangle (p0, p1, p2). the
+// result may lie outside of the triangle
+vec2 getRayTriangleBarycentrics(vec3 origin, vec3 direction, vec3 p0, vec3 p1, vec3 p2) {
+	vec3 edge1 = p1 - p0;
+	vec3 edge2 = p2 - p0;
+	vec3 p = cross(direction, edge2);
+	vec3 t = origin - p0;
+	vec3 q = cross(t, edge1);
+	return vec2(dot(t, p), dot(direction, q)) / dot(edge1, p);
+}
+
+vec2 interpolate(vec2 v0, vec2 v1, vec2 v2, vec2 barycentrics) {
+	return v0 + barycentrics.x * (v1 - v0) + barycentrics.y * (v2 - v0);
+}
+vec3 interpolate(vec3 v0, vec3 v1, vec3 v2, vec2 barycentrics) {
+	return v0 + barycentrics.x * (v1 - v0) + barycentrics.y * (v2 - v0);
+}
+vec4 interpolate(vec4 v0, vec4 v1, vec4 v2, vec2 barycentrics) {
+	return v0 + barycentrics.x * (v1 - v0) + barycentrics.y * (v2 - v0);
+}
@@ -7,6 +7,7 @@
 #include "include/structs/light.glsl"
 #include "include/structs/restirStructs.glsl"
 #include "include/restirUtils.glsl"
+#include "include/packedLight.glsl"
 
 layout (binding = 0) uniform sampler2D uniAlbedo;
 layout (binding = 1) uniform sampler2D uniNormal;
@@ -17,55 +18,120 @@ layout (binding = 4) uniform Uniforms {
 	LightingPassUniforms uniforms;
 };
 layout (binding = 5) buffer Reservoirs {
-	Reservoir reservoirs[];
+	PackedReservoir reservoirs[];
 };
 layout (binding = 6) buffer PointLights {
 	int count;
-	pointLight lights[];
+	PackedPointLight lights[];
 } pointLights;
 layout (binding = 7) buffer TriangleLights {
 	int count;
-	triLight lights[];
+	PackedTriLight lights[];
 } triangleLights;
 
+#define POINT_LIGHT_BUFFER pointLights
+#define TRIANGLE_LIGHT_BUFFER triangleLights
+#include "include/packedReservoir.glsl"
+
 layout (location = 0) in vec2 inUv;
 
 layout (location = 0) out vec3 outColor;
 
 #define PI 3.1415926
 
-#include "include/frustumUtils.glsl"
+#define ALBEDO_TEXTURE uniAlbedo
+#define NORMAL_TEXTURE uniNormal
+#define MATERIAL_TEXTURE uniMaterialProperties
+#define WORLD_POSITION_TEXTURE uniWorldPosition
+#define INVERSE_PROJECTION_VIEW_MATRIX uniforms.inverseProjectionViewMatrix
+#define SCREEN_SIZE uniforms.bufferSize
+#include "include/gBuffer.glsl"
 
 float rnd(uint seed) {
 	return 0.0f;
 }
 
+// neighboring reservoirs are only used for upsampling if their surfaces are similar to this pixel's
+const float UPSAMPLE_NORMAL_THRESHOLD = 0.9f;
+const float UPSAMPLE_PLANE_DISTANCE_THRESHOLD = 0.05f; // relative to the distance to the camera
+
+vec3 shadeWithReservoir(Reservoir reservoir, vec3 worldPos, vec3 normal, vec3 albedo, vec2 materialProps) {
+	vec3 color = vec3(0.0f);
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		if (reservoir.samples[i].w <= 0.0f) {
+			continue;
+		}
+		vec3 emission;
+		int lightIndex = reservoir.samples[i].lightIndex;
+		if (lightIndex < 0) {
+			PackedTriLight light = triangleLights.lights[-1 - lightIndex];
+			emission = decodeEmission(light.emissionRG, light.emissionB).rgb;
+		} else {
+			PackedPointLight light = pointLights.lights[lightIndex];
+			emission = decodeEmission(light.emissionRG, light.emissionB).rgb;
+		}
+		vec3 pHat = evaluatePHatFull(
+			worldPos, reservoir.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
+			normal, reservoir.samples[i].normal.xyz, reservoir.samples[i].normal.w > 0.5f,
+			albedo, emission, materialProps.x, materialProps.y
+		);
+		color += pHat * reservoir.samples[i].w;
+	}
+	return color / RESERVOIR_SIZE;
+}
+
+// with half-resolution ReSTIR, the samples of the 2x2 reservoirs around the pixel are evaluated at the pixel and
+// blended bilinearly, skipping reservoirs that were generated for different surfaces
+vec3 shadeUpsampled(uvec2 pixelCoord, vec3 worldPos, vec3 normal, vec3 albedo, vec2 materialProps) {
+	uvec2 gridSize = getReservoirGridSize(uniforms.bufferSize);
+	vec2 gridPos = vec2(pixelCoord) * 0.5f;
+	ivec2 base = ivec2(floor(gridPos));
+	vec2 fraction = gridPos - vec2(base);
+	float planeDistanceThreshold = UPSAMPLE_PLANE_DISTANCE_THRESHOLD * distance(worldPos, uniforms.cameraPos.xyz);
+
+	vec3 color = vec3(0.0f);
+	float sumWeights = 0.0f;
+	for (int i = 0; i < 4; ++i) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 bilinear = mix(1.0f - fraction, fraction, vec2(offset));
+		float weight = bilinear.x * bilinear.y;
+		if (weight <= 0.0f) {
+			continue;
+		}
+		uvec2 reservoir = uvec2(min(base + offset, ivec2(gridSize) - 1));
+		ivec2 reservoirPixel = ivec2(getReservoirPixel(reservoir));
+		if (
+			dot(fetchGBufferNormal(reservoirPixel), normal) < UPSAMPLE_NORMAL_THRESHOLD ||
+			abs(dot(fetchGBufferWorldPosition(reservoirPixel) - worldPos, normal)) > planeDistanceThreshold
+		) {
+			continue;
+		}
+		Reservoir res = unpackReservoir(reservoirs[getReservoirIndex(reservoir, gridSize)]);
+		color += weight * shadeWithReservoir(res, worldPos, normal, albedo, materialProps);
+		sumWeights += weight;
+	}
+	if (sumWeights > 0.0f) {
+		return color / sumWeights;
+	}
+	// no similar surface nearby, e.g. on thin geometry
+	Reservoir res = unpackReservoir(reservoirs[getReservoirIndex(getPixelReservoir(pixelCoord), gridSize)]);
+	return shadeWithReservoir(res, worldPos, normal, albedo, materialProps);
+}
+
 void main() {
-	vec4 albedo = texture(uniAlbedo, inUv);
-	vec3 normal = texture(uniNormal, inUv).xyz;
-	vec2 materialProps = texture(uniMaterialProperties, inUv).xy;
-	vec3 worldPos = texture(uniWorldPosition, inUv).xyz;
+	uvec2 pixelCoord = uvec2(gl_FragCoord.xy);
+	vec4 albedo = fetchGBufferAlbedo(ivec2(pixelCoord));
+	vec3 normal = fetchGBufferNormal(ivec2(pixelCoord));
+	vec2 materialProps = fetchGBufferRoughnessMetallic(ivec2(pixelCoord));
+	vec3 worldPos = fetchGBufferWorldPosition(ivec2(pixelCoord));
 
 	if (uniforms.debugMode == GBUFFER_DEBUG_NONE) {
-		uvec2 pixelCoord = uvec2(gl_FragCoord.xy);
-		Reservoir reservoir = reservoirs[pixelCoord.y * uniforms.bufferSize.x + pixelCoord.x];
-		outColor = vec3(0.0f);
-		for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-			vec3 emission;
-			int lightIndex = reservoir.samples[i].lightIndex;
-			if (lightIndex < 0) {
-				emission = triangleLights.lights[-1 - lightIndex].emission_luminance.rgb;
-			} else {
-				emission = pointLights.lights[lightIndex].color_luminance.rgb;
-			}
-			vec3 pHat = evaluatePHatFull(
-				worldPos, reservoir.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
-				normal, reservoir.samples[i].normal.xyz, reservoir.samples[i].normal.w > 0.5f,
-				albedo.rgb, emission, materialProps.x, materialProps.y
-			);
-			outColor += pHat * reservoir.samples[i].w;
+		if (HALF_RES_RESTIR) {
+			outColor = shadeUpsampled(pixelCoord, worldPos, normal, albedo.rgb, materialProps);
+		} else {
+			Reservoir reservoir = unpackReservoir(reservoirs[getReservoirIndex(pixelCoord, uniforms.bufferSize)]);
+			outColor = shadeWithReservoir(reservoir, worldPos, normal, albedo.rgb, materialProps);
 		}
-		outColor /= RESERVOIR_SIZE;
 		if (albedo.w > 0.5f) {
 			outColor = albedo.xyz;
 		}
@@ -93,9 +159,10 @@ void main() {
 
 		outColor = vec3(0.0f);
 		for (int i = 0; i < pointLights.count; ++i) {
+			pointLight light = decodePointLight(pointLights.lights[i]);
 			outColor += evaluatePHatFull(
-				worldPos, pointLights.lights[i].pos.xyz, uniforms.cameraPos.xyz, normal, vec3(0.0f), false,
-				albedo.rgb, pointLights.lights[i].color_luminance.rgb, roughness, metallic
+				worldPos, light.pos.xyz, uniforms.cameraPos.xyz, normal, vec3(0.0f), false,
+				albedo.rgb, light.color_luminance.rgb, roughness, metallic
 			);
 		}
 	}
@@ -0,0 +1,17 @@
+#version 450
+
+#include "include/structs/sceneStructs.glsl"
+#include "include/visibilityBuffer.glsl"
+
+layout (input_attachment_index = 0, set = 1, binding = 0) uniform usubpassInput uniVisibility;
+layout (set = 1, binding = 1) buffer Nodes {
+	NodeDrawInfo nodes[];
+};
+
+void main() {
+	uint node = subpassLoad(uniVisibility).x;
+	if (node == VISIBILITY_BUFFER_EMPTY) {
+		discard;
+	}
+	gl_FragDepth = getMaterialDepth(nodes[node].materialIndex);
+}
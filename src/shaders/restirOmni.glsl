@@ -6,15 +6,17 @@
 #include "include/reservoir.glsl"
 #include "include/restirUtils.glsl"
 #include "include/structs/light.glsl"
+#include "include/structs/lightBvh.glsl"
+#include "include/packedLight.glsl"
 
 
 layout (binding = 0, set = 0) buffer PointLights {
 	int count;
-	pointLight lights[];
+	PackedPointLight lights[];
 } pointLights;
 layout (binding = 1, set = 0) buffer TriangleLights {
 	int count;
-	triLight lights[];
+	PackedTriLight lights[];
 } triangleLights;
 layout (binding = 2, set = 0) buffer AliasTable{
 	int count;
@@ -25,22 +27,27 @@ layout (binding = 2, set = 0) buffer AliasTable{
 layout (binding = 3, set = 0) uniform Restiruniforms {
 	RestirUniforms uniforms;
 };
+layout (binding = 4, set = 0) buffer LightBvhNodes {
+	LightBvhNode nodes[];
+} lightBvh;
+layout (binding = 5, set = 0) buffer LightTiles {
+	LightTileSample samples[];
+} lightTiles;
 
 layout (binding = 0, set = 1) uniform sampler2D uniWorldPosition;
 layout (binding = 1, set = 1) uniform sampler2D uniAlbedo;
 layout (binding = 2, set = 1) uniform sampler2D uniNormal;
 layout (binding = 3, set = 1) uniform sampler2D uniMaterialProperties;
 
-layout (binding = 4, set = 1) uniform sampler2D uniPrevFrameWorldPosition;
-layout (binding = 5, set = 1) uniform sampler2D uniPrevFrameAlbedo;
-layout (binding = 6, set = 1) uniform sampler2D uniPrevFrameNormal;
-layout (binding = 7, set = 1) uniform sampler2D uniPrevDepth;
+layout (binding = 4, set = 1) uniform sampler2D uniMotionVectors;
+layout (binding = 5, set = 1) uniform usampler2D uniKey;
+layout (binding = 6, set = 1) uniform usampler2D uniPrevFrameKey;
 
-layout (binding = 8, set = 1) buffer Reservoirs {
-	Reservoir reservoirs[];
+layout (binding = 7, set = 1) buffer Reservoirs {
+	PackedReservoir reservoirs[];
 };
-layout (binding = 9, set = 1) buffer PrevFrameReservoirs {
-	Reservoir prevFrameReservoirs[];
+layout (binding = 8, set = 1) buffer PrevFrameReservoirs {
+	PackedReservoir prevFrameReservoirs[];
 };
 
 #ifdef HARDWARE_RAY_TRACING
@@ -55,7 +62,10 @@ layout (binding = 1, set = 2) buffer Triangles {
 	Triangle triangles[];
 };
 
-layout (local_size_x = OMNI_GROUP_SIZE_X, local_size_y = OMNI_GROUP_SIZE_Y, local_size_z = 1) in;
+layout (
+	local_size_x = OMNI_GROUP_SIZE_X, local_size_y = OMNI_GROUP_SIZE_Y, local_size_z = 1,
+	local_size_x_id = GROUP_SIZE_X_CONSTANT_ID, local_size_y_id = GROUP_SIZE_Y_CONSTANT_ID
+) in;
 
 #	define NODE_BUFFER aabbTree
 #	define TRIANGLE_BUFFER triangles
@@ -64,72 +74,159 @@ layout (local_size_x = OMNI_GROUP_SIZE_X, local_size_y = OMNI_GROUP_SIZE_Y, loca
 
 #include "include/visibilityTest.glsl"
 
+#define LIGHT_BVH_BUFFER lightBvh
+#include "include/lightBvh.glsl"
 
-vec3 pickPointOnTriangle(float r1, float r2, vec3 p1, vec3 p2, vec3 p3) {
-	float sqrt_r1 = sqrt(r1);
-	return (1.0 - sqrt_r1) * p1 + (sqrt_r1 * (1.0 - r2)) * p2 + (r2 * sqrt_r1) * p3;
-}
+#define POINT_LIGHT_BUFFER pointLights
+#define ALIAS_TABLE_BUFFER aliasTable
+#include "include/lightSampling.glsl"
+
+#define TRIANGLE_LIGHT_BUFFER triangleLights
+#include "include/packedReservoir.glsl"
+
+#define ALBEDO_TEXTURE uniAlbedo
+#define NORMAL_TEXTURE uniNormal
+#define MATERIAL_TEXTURE uniMaterialProperties
+#define WORLD_POSITION_TEXTURE uniWorldPosition
+#define INVERSE_PROJECTION_VIEW_MATRIX uniforms.inverseProjectionViewMatrix
+#define SCREEN_SIZE uniforms.screenSize
+#include "include/gBuffer.glsl"
+
+// Number of initial candidates for a pixel whose temporal reuse found a previous reservoir with the given number of
+// samples, or zero samples if temporal reuse failed. Pixels that have accumulated a long history get fewer candidates,
+// while disocclusions and edges get the full budget. The previous reservoir is also penalized if the contributions of
+// its samples vary a lot, which usually happens in penumbrae and near many similarly bright lights.
+uint getAdaptiveLightSampleCount(uint prevSampleCount, Reservoir prevRes, float pHat[RESERVOIR_SIZE]) {
+	uint maxCount = uniforms.initialLightSampleCount;
+	uint minCount = min(uniforms.minInitialLightSampleCount, maxCount);
+	if (prevSampleCount == 0) {
+		return maxCount;
+	}
 
-void aliasTableSample(float r1, float r2, out int index, out float probability) {
-	int selected_column = min(int(aliasTable.count * r1), aliasTable.count - 1);
-	aliasTableColumn col = aliasTable.aliasCol[selected_column];
-	if (col.prob > r2) {
-		index = selected_column;
-		probability = col.oriProb;
-	} else {
-		index = col.alias;
-		probability = col.aliasOriProb;
+	// relative variance of the contributions of the samples
+	float sum = 0.0f, sumSquared = 0.0f;
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		float contribution = pHat[i] * prevRes.samples[i].w;
+		sum += contribution;
+		sumSquared += contribution * contribution;
 	}
+	float relativeVariance = sum > 0.0f ? max(RESERVOIR_SIZE * sumSquared / (sum * sum) - 1.0f, 0.0f) : 0.0f;
+
+	float confidence = min(
+		float(prevSampleCount) / float(max(uniforms.temporalSampleCountMultiplier * maxCount, 1)), 1.0f
+	) / (1.0f + relativeVariance);
+	return uint(ceil(mix(float(maxCount), float(minCount), confidence)));
 }
 
 
 void main() {
-	uvec2 pixelCoord =
+	uvec2 gridSize = getReservoirGridSize(uniforms.screenSize);
+	uvec2 reservoirCoord =
 #ifdef HARDWARE_RAY_TRACING
 		gl_LaunchIDEXT.xy;
 #else
 		gl_GlobalInvocationID.xy;
 #endif
-	if (any(greaterThanEqual(pixelCoord, uniforms.screenSize))) {
+	if (any(greaterThanEqual(reservoirCoord, gridSize))) {
 		return;
 	}
+	uvec2 pixelCoord = getReservoirPixel(reservoirCoord);
 
 	// Light Sampling
-	vec3 albedo = texelFetch(uniAlbedo, ivec2(pixelCoord), 0).xyz;
-	vec3 normal = texelFetch(uniNormal, ivec2(pixelCoord), 0).xyz;
-	vec2 roughnessMetallic = texelFetch(uniMaterialProperties, ivec2(pixelCoord), 0).xy;
-	vec3 worldPos = texelFetch(uniWorldPosition, ivec2(pixelCoord), 0).xyz;
+	vec3 albedo = fetchGBufferAlbedo(ivec2(pixelCoord)).xyz;
+	vec3 normal = fetchGBufferNormal(ivec2(pixelCoord));
+	vec2 roughnessMetallic = fetchGBufferRoughnessMetallic(ivec2(pixelCoord));
+	vec3 worldPos = fetchGBufferWorldPosition(ivec2(pixelCoord));
 
 	float albedoLum = luminance(albedo.r, albedo.g, albedo.b);
 
+	// Find the previous reservoir first, since the number of candidates may depend on it
+	bool hasPrevRes = false;
+	Reservoir prevRes;
+	float prevPHat[RESERVOIR_SIZE];
+	if ((uniforms.flags & RESTIR_TEMPORAL_REUSE_FLAG) != 0) {
+		vec2 motionVector = texelFetch(uniMotionVectors, ivec2(pixelCoord), 0).xy;
+		vec2 prevFramePos = vec2(pixelCoord) + 0.5f + motionVector * vec2(uniforms.screenSize);
+		if (
+			all(greaterThanEqual(prevFramePos, vec2(0.0f))) &&
+			all(lessThan(prevFramePos, vec2(uniforms.screenSize)))
+		) {
+			// compare against the pixel that the previous reservoir was generated for
+			uvec2 prevReservoir = getPixelReservoir(uvec2(prevFramePos));
+			ivec2 prevFrag = ivec2(getReservoirPixel(prevReservoir));
+			uint key = texelFetch(uniKey, ivec2(pixelCoord), 0).x;
+			if (isSameSurface(key, texelFetch(uniPrevFrameKey, prevFrag, 0).x)) {
+				hasPrevRes = true;
+				prevRes = unpackReservoir(prevFrameReservoirs[getReservoirIndex(prevReservoir, gridSize)]);
+				for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+					prevPHat[i] = evaluatePHat(
+						worldPos, prevRes.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
+						normal, prevRes.samples[i].normal.xyz, prevRes.samples[i].normal.w > 0.5f,
+						albedoLum, prevRes.samples[i].position_emissionLum.w, roughnessMetallic.x, roughnessMetallic.y
+					);
+				}
+			}
+		}
+	}
+
+	uint lightSampleCount = uniforms.initialLightSampleCount;
+	if ((uniforms.flags & RESTIR_ADAPTIVE_SAMPLING_FLAG) != 0) {
+		lightSampleCount = getAdaptiveLightSampleCount(hasPrevRes ? prevRes.numStreamSamples : 0, prevRes, prevPHat);
+	}
+
 	Reservoir res = newReservoir();
 	Rand rand = seedRand(uniforms.frame, pixelCoord.y * 10007 + pixelCoord.x);
 	if (dot(normal, normal) != 0.0f) {
-		for (int i = 0; i < uniforms.initialLightSampleCount; ++i) {
-			int selected_idx;
-			float lightSampleProb;
-			aliasTableSample(randFloat(rand), randFloat(rand), selected_idx, lightSampleProb);
+		// all pixels in the same screen tile draw their candidates from the same light tile. the tile is chosen with a
+		// sequence that no pixel uses, see also lightTiles.comp
+		uvec2 screenTile = pixelCoord / LIGHT_TILE_SCREEN_TILE_SIZE;
+		Rand tileRand = seedRand(uniforms.frame, 0x40000000u + screenTile.y * 10007 + screenTile.x);
+		uint lightTileOffset = min(uint(randFloat(tileRand) * LIGHT_TILE_COUNT), LIGHT_TILE_COUNT - 1) * LIGHT_TILE_SIZE;
 
+		for (uint i = 0; i < lightSampleCount; ++i) {
 			vec3 lightSamplePos;
 			vec4 lightNormal;
 			float lightSampleLum;
 			int lightSampleIndex;
-			if (pointLights.count != 0) {
-				pointLight light = pointLights.lights[selected_idx];
-				lightSamplePos = light.pos.xyz;
-				lightSampleLum = light.color_luminance.w;
-				lightSampleIndex = selected_idx;
-				lightNormal = vec4(0.0f);
+			uint lightSampleBarycentrics;
+			float lightSampleProb;
+			if ((uniforms.flags & RESTIR_LIGHT_TILES_SAMPLING_FLAG) != 0) {
+				LightTileSample tileSample = lightTiles.samples[
+					lightTileOffset + min(uint(randFloat(rand) * LIGHT_TILE_SIZE), LIGHT_TILE_SIZE - 1)
+				];
+				lightSamplePos = tileSample.position_emissionLum.xyz;
+				lightSampleLum = tileSample.position_emissionLum.w;
+				lightSampleIndex = tileSample.lightIndex;
+				lightSampleBarycentrics = tileSample.barycentrics;
+				lightNormal = tileSample.normal;
+				lightSampleProb = tileSample.probability;
 			} else {
-				triLight light = triangleLights.lights[selected_idx];
-				lightSamplePos = pickPointOnTriangle(randFloat(rand), randFloat(rand), light.p1.xyz, light.p2.xyz, light.p3.xyz);
-				lightSampleLum = light.emission_luminance.w;
-				lightSampleIndex = -1 - selected_idx;
+				int selected_idx;
+				if ((uniforms.flags & RESTIR_LIGHT_BVH_SAMPLING_FLAG) != 0) {
+					selected_idx = sampleLightBvh(worldPos, normal, rand, lightSampleProb);
+				} else {
+					aliasTableSample(randFloat(rand), randFloat(rand), selected_idx, lightSampleProb);
+				}
+				selected_idx = toReservoirLightIndex(selected_idx);
 
+				if (selected_idx >= 0) {
+					pointLight light = decodePointLight(pointLights.lights[selected_idx]);
+					lightSamplePos = light.pos.xyz;
+					lightSampleLum = light.color_luminance.w;
+					lightNormal = vec4(0.0f);
+					lightSampleBarycentrics = 0;
+				} else {
+					triLight light = decodeTriLight(triangleLights.lights[-1 - selected_idx]);
+					lightSamplePos = pickPointOnTriangle(randFloat(rand), randFloat(rand), light, lightSampleBarycentrics);
+					lightSampleLum = light.emission_luminance.w;
+					lightSampleProb /= light.normalArea.w;
+					lightNormal = vec4(light.normalArea.xyz, 1.0f);
+				}
+				lightSampleIndex = selected_idx;
+			}
+			if (lightNormal.w > 0.5f) {
 				vec3 wi = normalize(worldPos - lightSamplePos);
-				vec3 normal = light.normalArea.xyz;
-				lightSampleProb /= abs(dot(wi, normal)) * light.normalArea.w;
-				lightNormal = vec4(normal, 1.0f);
+				lightSampleProb /= abs(dot(wi, lightNormal.xyz));
 			}
 
 			float pHat = evaluatePHat(
@@ -138,11 +235,14 @@ void main() {
 				albedoLum, lightSampleLum, roughnessMetallic.x, roughnessMetallic.y
 			);
 
-			addSampleToReservoir(res, lightSamplePos, lightNormal, lightSampleLum, lightSampleIndex, pHat, lightSampleProb, rand);
+			addSampleToReservoir(
+				res, lightSamplePos, lightNormal, lightSampleLum, lightSampleIndex, lightSampleBarycentrics,
+				pHat, lightSampleProb, rand
+			);
 		}
 	}
 	
-	uint reservoirIndex = pixelCoord.y * uniforms.screenSize.x + pixelCoord.x;
+	uint reservoirIndex = getReservoirIndex(reservoirCoord, gridSize);
 	
 	// Visibility Reuse
 	if ((uniforms.flags & RESTIR_VISIBILITY_REUSE_FLAG) != 0) {
@@ -160,53 +260,15 @@ void main() {
 	}
 
 	// Temporal reuse
-	if ((uniforms.flags & RESTIR_TEMPORAL_REUSE_FLAG) != 0) {
-		vec4 prevFramePos = uniforms.prevFrameProjectionViewMatrix * vec4(worldPos, 1.0f);
-		prevFramePos.xyz /= prevFramePos.w;
-		prevFramePos.xy = (prevFramePos.xy + 1.0f) * 0.5f * vec2(uniforms.screenSize);
-		if (
-			all(greaterThan(prevFramePos.xy, vec2(0.0f))) &&
-			all(lessThan(prevFramePos.xy, vec2(uniforms.screenSize)))
-		) {
-			ivec2 prevFrag = ivec2(prevFramePos.xy);
+	if (hasPrevRes) {
+		// clamp the number of samples. with adaptive sampling the clamp is relative to the full budget, otherwise the
+		// history of pixels with few candidates would be shortened, which would in turn give them more candidates
+		uint clampBase =
+			(uniforms.flags & RESTIR_ADAPTIVE_SAMPLING_FLAG) != 0 ? uniforms.initialLightSampleCount : res.numStreamSamples;
+		prevRes.numStreamSamples = min(prevRes.numStreamSamples, uniforms.temporalSampleCountMultiplier * clampBase);
 
-#ifdef COMPARE_DEPTH
-			float depthDiff = prevFramePos.z - texelFetch(uniPrevDepth, prevFrag, 0).x;
-			if (depthDiff < 0.001f * prevFramePos.z) {
-#else
-			// highest quality results can be obtained by directly comparing the world positions
-			// the performance impact of this is unclear
-			vec3 positionDiff = worldPos - texelFetch(uniPrevFrameWorldPosition, prevFrag, 0).xyz;
-			if (dot(positionDiff, positionDiff) < 0.01f) {
-#endif
-				vec3 albedoDiff = albedo - texelFetch(uniPrevFrameAlbedo, prevFrag, 0).rgb;
-				if (dot(albedoDiff, albedoDiff) < 0.01f) {
-					float normalDot = dot(normal, texelFetch(uniPrevFrameNormal, prevFrag, 0).xyz);
-					if (normalDot > 0.5f) {
-						Reservoir prevRes = prevFrameReservoirs[prevFrag.y * uniforms.screenSize.x + prevFrag.x];
-
-						// clamp the number of samples
-						prevRes.numStreamSamples = min(
-							prevRes.numStreamSamples, uniforms.temporalSampleCountMultiplier * res.numStreamSamples
-						);
-
-						vec2 metallicRoughness = texelFetch(uniMaterialProperties, ivec2(pixelCoord), 0).xy;
-
-						float pHat[RESERVOIR_SIZE];
-						for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-							pHat[i] = evaluatePHat(
-								worldPos, prevRes.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
-								normal, prevRes.samples[i].normal.xyz, prevRes.samples[i].normal.w > 0.5f,
-								albedoLum, prevRes.samples[i].position_emissionLum.w, metallicRoughness.x, metallicRoughness.y
-							);
-						}
-
-						combineReservoirs(res, prevRes, pHat, rand);
-					}
-				}
-			}
-		}
+		combineReservoirs(res, prevRes, prevPHat, rand);
 	}
 
-	reservoirs[reservoirIndex] = res;
+	reservoirs[reservoirIndex] = packReservoir(res);
 }
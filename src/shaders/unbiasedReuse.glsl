@@ -5,6 +5,8 @@
 #include "include/structs/lightingPassStructs.glsl"
 #include "include/reservoir.glsl"
 #include "include/restirUtils.glsl"
+#include "include/structs/light.glsl"
+#include "include/packedLight.glsl"
 
 layout (set = 0, binding = 0) uniform sampler2D uniWorldPosition;
 layout (set = 0, binding = 1) uniform sampler2D uniAlbedo;
@@ -13,16 +15,29 @@ layout (set = 0, binding = 3) uniform sampler2D uniMaterialProperties;
 layout (set = 0, binding = 4) uniform sampler2D uniDepth;
 
 layout (set = 0, binding = 5) buffer Reservoirs {
-    Reservoir reservoirs[];
+    PackedReservoir reservoirs[];
 };
 layout (set = 0, binding = 6) buffer ResultReservoirs {
-	Reservoir resultReservoirs[];
+	PackedReservoir resultReservoirs[];
 };
 
 layout (set = 0, binding = 7) uniform Restiruniforms {
 	RestirUniforms uniforms;
 };
 
+layout (set = 0, binding = 8) buffer PointLights {
+	int count;
+	PackedPointLight lights[];
+} pointLights;
+layout (set = 0, binding = 9) buffer TriangleLights {
+	int count;
+	PackedTriLight lights[];
+} triangleLights;
+
+#define POINT_LIGHT_BUFFER pointLights
+#define TRIANGLE_LIGHT_BUFFER triangleLights
+#include "include/packedReservoir.glsl"
+
 #ifdef HARDWARE_RAY_TRACING
 layout (location = 0) rayPayloadEXT bool isShadowed;
 layout (set = 1, binding = 0) uniform accelerationStructureEXT acc;
@@ -35,7 +50,10 @@ layout (set = 1, binding = 1) buffer Triangles {
 	Triangle triangles[];
 };
 
-layout (local_size_x = UNBIASED_REUSE_GROUP_SIZE_X, local_size_y = UNBIASED_REUSE_GROUP_SIZE_Y, local_size_z = 1) in;
+layout (
+	local_size_x = UNBIASED_REUSE_GROUP_SIZE_X, local_size_y = UNBIASED_REUSE_GROUP_SIZE_Y, local_size_z = 1,
+	local_size_x_id = GROUP_SIZE_X_CONSTANT_ID, local_size_y_id = GROUP_SIZE_Y_CONSTANT_ID
+) in;
 
 #	define NODE_BUFFER aabbTree
 #	define TRIANGLE_BUFFER triangles
@@ -44,33 +62,209 @@ layout (local_size_x = UNBIASED_REUSE_GROUP_SIZE_X, local_size_y = UNBIASED_REUS
 
 #include "include/visibilityTest.glsl"
 
+#define ALBEDO_TEXTURE uniAlbedo
+#define NORMAL_TEXTURE uniNormal
+#define MATERIAL_TEXTURE uniMaterialProperties
+#define WORLD_POSITION_TEXTURE uniWorldPosition
+#define INVERSE_PROJECTION_VIEW_MATRIX uniforms.inverseProjectionViewMatrix
+#define SCREEN_SIZE uniforms.screenSize
+#include "include/gBuffer.glsl"
+
+#define RESERVOIR_BUFFER reservoirs
+#define DEPTH_TEXTURE uniDepth
+#define REUSE_TILE_WORLD_POSITION
+#ifdef HARDWARE_RAY_TRACING
+// ray generation shaders have no shared memory
+#	define REUSE_TILE_UNAVAILABLE
+#endif
+#include "include/reuseTile.glsl"
+
+layout (constant_id = UNBIASED_REUSE_NEIGHBORS_CONSTANT_ID) const int NUM_NEIGHBORS = UNBIASED_REUSE_NEIGHBORS;
+layout (constant_id = PAIRWISE_MIS_CONSTANT_ID) const bool PAIRWISE_MIS = false;
+
+// Pairwise MIS: the reservoir of this pixel is the canonical one, and each neighbor is only weighted against it. The MIS
+// weight of a neighbor's sample only needs target functions that are either known to include visibility or are
+// evaluated without it consistently, so the only rays needed are one per neighbor whose target function at the
+// canonical sample is non-zero, plus one for the final sample, instead of NUM_NEIGHBORS + 1 rays per sample.
+//
+// With confidence weights c (numStreamSamples), the MIS weights of the neighbor sample y_i and the canonical sample
+// y_c are:
+//   m_i(y_i) = 1/k * c_i pHat_i(y_i) / (c_i pHat_i(y_i) + c_c pHat_c(y_i))
+//   m_c(y_c) = 1/k * sum_i c_c pHat_c(y_c) / (c_i pHat_i(y_c) + c_c pHat_c(y_c))
+// which sum to one for any sample.
+Reservoir pairwiseMisReuse(
+	Reservoir canonical, uvec2 reservoirCoord, uvec2 gridSize, vec3 worldPos, vec3 normal, float albedoLum,
+	vec2 roughnessMetallic, inout Rand rand
+) {
+	Reservoir result = newReservoir();
+	result.numStreamSamples = canonical.numStreamSamples;
+	float canonicalMisWeight[RESERVOIR_SIZE];
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		canonicalMisWeight[i] = 0.0f;
+	}
+	float canonicalConfidence = float(canonical.numStreamSamples);
+
+	float spatialRadius = getReuseRadius(uniforms.spatialRadius);
+	for (int i = 0; i < NUM_NEIGHBORS; ++i) {
+		float angle = randFloat(rand) * 2.0 * M_PI;
+		float radius = sqrt(randFloat(rand)) * spatialRadius;
+
+		// clamped to the grid by the fetch functions
+		ivec2 randNeighbor = ivec2(reservoirCoord) + ivec2(round(vec2(cos(angle), sin(angle)) * radius));
+
+		Reservoir randRes = unpackReservoir(fetchReuseNeighborReservoir(randNeighbor, gridSize));
+		vec3 neighborPos = fetchReuseNeighborWorldPosition(randNeighbor, gridSize);
+		vec3 neighborNormal = fetchReuseNeighborNormalDepth(randNeighbor, gridSize).xyz;
+		ivec2 neighborPixel = ivec2(getReservoirPixel(uvec2(clamp(randNeighbor, ivec2(0), ivec2(gridSize) - 1))));
+		vec3 neighborAlbedo = fetchGBufferAlbedo(neighborPixel).xyz;
+		float neighborAlbedoLum = luminance(neighborAlbedo.r, neighborAlbedo.g, neighborAlbedo.b);
+		vec2 neighborRoughnessMetallic = fetchGBufferRoughnessMetallic(neighborPixel);
+		float neighborConfidence = float(randRes.numStreamSamples);
+
+		result.numStreamSamples += randRes.numStreamSamples;
+		for (int j = 0; j < RESERVOIR_SIZE; ++j) {
+			// the neighbor's sample, which is visible from the neighbor if its weight is non-zero
+			if (randRes.samples[j].w > 0.0f) {
+				vec3 lightPos = randRes.samples[j].position_emissionLum.xyz;
+				float lightLum = randRes.samples[j].position_emissionLum.w;
+				bool isTriLight = randRes.samples[j].normal.w > 0.5f;
+				float pHat = evaluatePHat(
+					worldPos, lightPos, uniforms.cameraPos.xyz,
+					normal, randRes.samples[j].normal.xyz, isTriLight,
+					albedoLum, lightLum, roughnessMetallic.x, roughnessMetallic.y
+				);
+				float neighborPHat = evaluatePHat(
+					neighborPos, lightPos, uniforms.cameraPos.xyz,
+					neighborNormal, randRes.samples[j].normal.xyz, isTriLight,
+					neighborAlbedoLum, lightLum, neighborRoughnessMetallic.x, neighborRoughnessMetallic.y
+				);
+				float misDenom = neighborConfidence * neighborPHat + canonicalConfidence * pHat;
+				float misWeight = misDenom > 0.0f ? neighborConfidence * neighborPHat / (NUM_NEIGHBORS * misDenom) : 0.0f;
+				float weight = misWeight * pHat * randRes.samples[j].w;
+				if (weight > 0.0f) {
+					updateReservoirAt(
+						result, j, weight,
+						lightPos, randRes.samples[j].normal, lightLum,
+						randRes.samples[j].lightIndex, randRes.samples[j].barycentrics, pHat, randRes.samples[j].w,
+#ifdef UNBIASED_MIS
+						randRes.samples[j].sumPHat,
+#endif
+						rand
+					);
+				}
+			}
+
+			// the canonical sample as seen from the neighbor
+			if (canonical.samples[j].w > 0.0f) {
+				vec3 lightPos = canonical.samples[j].position_emissionLum.xyz;
+				float neighborPHat = 0.0f;
+				if (neighborConfidence > 0.0f && dot(lightPos - neighborPos, neighborNormal) >= 0.0f) {
+					neighborPHat = evaluatePHat(
+						neighborPos, lightPos, uniforms.cameraPos.xyz,
+						neighborNormal, canonical.samples[j].normal.xyz, canonical.samples[j].normal.w > 0.5f,
+						neighborAlbedoLum, canonical.samples[j].position_emissionLum.w,
+						neighborRoughnessMetallic.x, neighborRoughnessMetallic.y
+					);
+				}
+				// only trace a ray if the neighbor could have produced this sample at all
+				if (neighborPHat > 0.0f && (uniforms.flags & RESTIR_VISIBILITY_REUSE_FLAG) != 0) {
+					if (testVisibility(neighborPos, lightPos)) {
+						neighborPHat = 0.0f;
+					}
+				}
+				float canonicalTerm = canonicalConfidence * canonical.samples[j].pHat;
+				float misDenom = canonicalTerm + neighborConfidence * neighborPHat;
+				canonicalMisWeight[j] += misDenom > 0.0f ? canonicalTerm / misDenom : 1.0f;
+			}
+		}
+	}
+
+	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+		if (canonical.samples[i].w > 0.0f) {
+			float weight = canonicalMisWeight[i] / NUM_NEIGHBORS * canonical.samples[i].pHat * canonical.samples[i].w;
+			if (weight > 0.0f) {
+				updateReservoirAt(
+					result, i, weight,
+					canonical.samples[i].position_emissionLum.xyz, canonical.samples[i].normal,
+					canonical.samples[i].position_emissionLum.w,
+					canonical.samples[i].lightIndex, canonical.samples[i].barycentrics,
+					canonical.samples[i].pHat, canonical.samples[i].w,
+#ifdef UNBIASED_MIS
+					canonical.samples[i].sumPHat,
+#endif
+					rand
+				);
+			}
+		}
 
-#define NUM_NEIGHBORS 3
+		bool visible = result.samples[i].sumWeights > 0.0f;
+		if (visible && (uniforms.flags & RESTIR_VISIBILITY_REUSE_FLAG) != 0) {
+			visible = !testVisibility(worldPos, result.samples[i].position_emissionLum.xyz);
+		}
+		// the MIS weights are already normalized, so the sum of weights is not divided by the number of samples. the
+		// sum of weights is restored from w and numStreamSamples when this reservoir is reused later
+		if (visible) {
+			result.samples[i].w = result.samples[i].sumWeights / result.samples[i].pHat;
+			result.samples[i].sumWeights = result.samples[i].w * result.numStreamSamples * result.samples[i].pHat;
+		} else {
+			result.samples[i].w = 0.0f;
+			result.samples[i].sumWeights = 0.0f;
+#ifdef UNBIASED_MIS
+			result.samples[i].sumPHat = 0.0f;
+#endif
+		}
+	}
+	return result;
+}
 
 void main() {
-	uvec2 pixelCoord =
+	uvec2 gridSize = getReservoirGridSize(uniforms.screenSize);
+	if (TILED_REUSE) {
+		loadReuseTile(gridSize);
+	}
+
+	uvec2 reservoirCoord =
 #ifdef HARDWARE_RAY_TRACING
 		gl_LaunchIDEXT.xy;
 #else
 		gl_GlobalInvocationID.xy;
 #endif
-	if (any(greaterThanEqual(pixelCoord, uniforms.screenSize))) {
+	if (any(greaterThanEqual(reservoirCoord, gridSize))) {
 		return;
 	}
+	uvec2 pixelCoord = getReservoirPixel(reservoirCoord);
 
-	vec3 albedo = texelFetch(uniAlbedo, ivec2(pixelCoord), 0).xyz;
-	vec3 normal = texelFetch(uniNormal, ivec2(pixelCoord), 0).xyz;
-	vec2 roughnessMetallic = texelFetch(uniMaterialProperties, ivec2(pixelCoord), 0).xy;
-    vec3 worldPos = texelFetch(uniWorldPosition, ivec2(pixelCoord), 0).xyz;
+	vec3 albedo = fetchGBufferAlbedo(ivec2(pixelCoord)).xyz;
+	vec3 normal = fetchGBufferNormal(ivec2(pixelCoord));
+	vec2 roughnessMetallic = fetchGBufferRoughnessMetallic(ivec2(pixelCoord));
+    vec3 worldPos = fetchGBufferWorldPosition(ivec2(pixelCoord));
     float worldDepth = texelFetch(uniDepth, ivec2(pixelCoord), 0).x;
     
     float albedoLum = luminance(albedo.r, albedo.g, albedo.b);
 
-	uint reservoirIndex = pixelCoord.y * uniforms.screenSize.x + pixelCoord.x;
-    Reservoir res = reservoirs[reservoirIndex];
+	uint reservoirIndex = getReservoirIndex(reservoirCoord, gridSize);
+    Reservoir res = unpackReservoir(reservoirs[reservoirIndex]);
+	{
+		float pHats[RESERVOIR_SIZE];
+		for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+			pHats[i] = evaluatePHat(
+				worldPos, res.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
+				normal, res.samples[i].normal.xyz, res.samples[i].normal.w > 0.5f,
+				albedoLum, res.samples[i].position_emissionLum.w, roughnessMetallic.x, roughnessMetallic.y);
+		}
+		restoreReservoirWeights(res, pHats);
+	}
 
     Rand rand = seedRand(uniforms.frame * 17, pixelCoord.y * 10007 + pixelCoord.x);
-	ivec2 neighborPositions[NUM_NEIGHBORS];
+	if (PAIRWISE_MIS) {
+		resultReservoirs[reservoirIndex] = packReservoir(pairwiseMisReuse(
+			res, reservoirCoord, gridSize, worldPos, normal, albedoLum, roughnessMetallic, rand
+		));
+		return;
+	}
+
+	vec3 neighborWorldPos[NUM_NEIGHBORS];
+	vec3 neighborNormal[NUM_NEIGHBORS];
 #ifdef UNBIASED_MIS
 	float neighborSumPHat[RESERVOIR_SIZE][NUM_NEIGHBORS];
 	float originalSumPHat[RESERVOIR_SIZE];
@@ -81,18 +275,18 @@ void main() {
 	uint neighborNumSamples[NUM_NEIGHBORS];
 	uint originalNumSamples = res.numStreamSamples;
 #endif
+	float spatialRadius = getReuseRadius(uniforms.spatialRadius);
     for (int i = 0; i < NUM_NEIGHBORS; ++i) {
         float angle = randFloat(rand) * 2.0 * M_PI;
-        float radius = sqrt(randFloat(rand)) * uniforms.spatialRadius;
+        float radius = sqrt(randFloat(rand)) * spatialRadius;
 
-        ivec2 randNeighbor = ivec2(round(vec2(cos(angle), sin(angle)) * radius));
-        randNeighbor = clamp(ivec2(pixelCoord) + randNeighbor, ivec2(0), ivec2(uniforms.screenSize - 1));
+        // clamped to the grid by the fetch functions
+        ivec2 randNeighbor = ivec2(reservoirCoord) + ivec2(round(vec2(cos(angle), sin(angle)) * radius));
 
-        uint neighborIndex = randNeighbor.y * uniforms.screenSize.x + randNeighbor.x;
+		Reservoir randRes = unpackReservoir(fetchReuseNeighborReservoir(randNeighbor, gridSize));
 
-		Reservoir randRes = reservoirs[neighborIndex];
-
-		neighborPositions[i] = randNeighbor;
+		neighborWorldPos[i] = fetchReuseNeighborWorldPosition(randNeighbor, gridSize);
+		neighborNormal[i] = fetchReuseNeighborNormalDepth(randNeighbor, gridSize).xyz;
 #ifdef UNBIASED_MIS
 		for (int j = 0; j < RESERVOIR_SIZE; ++j) {
 			neighborSumPHat[j][i] = randRes.samples[j].sumPHat;
@@ -113,7 +307,7 @@ void main() {
 					res, j, weight,
 					randRes.samples[j].position_emissionLum.xyz, randRes.samples[j].normal,
 					randRes.samples[j].position_emissionLum.w,
-					randRes.samples[j].lightIndex, newPHat, randRes.samples[j].w,
+					randRes.samples[j].lightIndex, randRes.samples[j].barycentrics, newPHat, randRes.samples[j].w,
 #ifdef UNBIASED_MIS
 					randRes.samples[j].sumPHat,
 #endif
@@ -123,12 +317,6 @@ void main() {
         }
     }
 
-	vec3 neighborWorldPos[NUM_NEIGHBORS];
-	vec3 neighborNormal[NUM_NEIGHBORS];
-	for (int i = 0; i < NUM_NEIGHBORS; ++i) {
-		neighborWorldPos[i] = texelFetch(uniWorldPosition, neighborPositions[i], 0).xyz;
-		neighborNormal[i] = texelFetch(uniNormal, neighborPositions[i], 0).xyz;
-	}
 	for (int i = 0; i < RESERVOIR_SIZE; ++i) {
 		vec3 lightPos = res.samples[i].position_emissionLum.xyz;
 #ifdef UNBIASED_MIS
@@ -166,10 +354,10 @@ void main() {
 		}
 
 #ifdef UNBIASED_MIS
-		if (sumPHat > 0.0f) {
+		if (sumPHat > 0.0f && res.samples[i].sumWeights > 0.0f) {
 			res.samples[i].w = res.samples[i].sumWeights * res.samples[i].pHat / (sumPHat * res.samples[i].pHat);
 #else
-		if (numSamples > 0) {
+		if (numSamples > 0 && res.samples[i].sumWeights > 0.0f) {
 			res.samples[i].w = res.samples[i].sumWeights / (numSamples * res.samples[i].pHat);
 #endif
 		} else {
@@ -181,5 +369,5 @@ void main() {
 		}
 	}
 
-    resultReservoirs[reservoirIndex] = res;
+    resultReservoirs[reservoirIndex] = packReservoir(res);
 }
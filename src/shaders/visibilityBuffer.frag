@@ -0,0 +1,35 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : enable
+
+#include "include/structs/sceneStructs.glsl"
+
+#ifdef BINDLESS_MATERIALS
+#	define BINDLESS_MATERIAL_SET 1
+#	include "include/bindlessMaterials.glsl"
+#else
+layout (set = 2, binding = 0) uniform Material {
+	MaterialUniforms material;
+};
+layout (set = 3, binding = 0) uniform sampler2D uniAlbedo;
+#endif
+
+layout (location = 4) in vec2 inUv;
+layout (location = 7) flat in uint inNodeIndex;
+#ifdef BINDLESS_MATERIALS
+layout (location = 8) flat in uint inMaterialIndex;
+#endif
+
+layout (location = 0) out uvec2 outVisibility;
+
+void main() {
+#ifdef BINDLESS_MATERIALS
+	loadMaterial(inMaterialIndex);
+#endif
+	// alpha testing is the only part of the material that affects visibility
+	if (material.alphaMode == ALPHA_MODE_MASK) {
+		if (texture(uniAlbedo, inUv).a * material.colorParam.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+	outVisibility = uvec2(inNodeIndex, gl_PrimitiveID);
+}
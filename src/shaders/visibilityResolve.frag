@@ -0,0 +1,92 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : enable
+
+#define BINDLESS_MATERIAL_SET 2
+
+#include "include/structs/sceneStructs.glsl"
+#include "include/structs/restirStructs.glsl"
+#include "include/visibilityBuffer.glsl"
+#include "include/gBufferMaterial.glsl"
+
+layout (set = 0, binding = 0) uniform Uniforms {
+	GBufferUniforms uniforms;
+};
+
+layout (input_attachment_index = 0, set = 1, binding = 0) uniform usubpassInput uniVisibility;
+layout (set = 1, binding = 1) buffer Nodes {
+	NodeDrawInfo nodes[];
+};
+layout (set = 1, binding = 2) buffer Indices {
+	uint indices[];
+};
+layout (set = 1, binding = 3) buffer Vertices {
+	float vertices[];
+};
+layout (set = 1, binding = 4) buffer Matrices {
+	ModelMatrices matrices[];
+};
+
+vec4 fetchVertexAttribute(uint vertex, uint offset) {
+	uint first = vertex * VERTEX_FLOAT_COUNT + offset;
+	return vec4(vertices[first], vertices[first + 1], vertices[first + 2], vertices[first + 3]);
+}
+
+void main() {
+	uvec2 visibility = subpassLoad(uniVisibility).xy;
+	NodeDrawInfo node = nodes[visibility.x];
+	ModelMatrices nodeMatrices = matrices[visibility.x];
+#ifdef BINDLESS_MATERIALS
+	loadMaterial(node.materialIndex);
+#endif
+
+	uint firstIndex = node.firstIndex + 3 * visibility.y;
+	uint vertex0 = uint(int(indices[firstIndex]) + node.vertexOffset);
+	uint vertex1 = uint(int(indices[firstIndex + 1]) + node.vertexOffset);
+	uint vertex2 = uint(int(indices[firstIndex + 2]) + node.vertexOffset);
+
+	vec3 objectPos0 = fetchVertexAttribute(vertex0, VERTEX_POSITION_OFFSET).xyz;
+	vec3 objectPos1 = fetchVertexAttribute(vertex1, VERTEX_POSITION_OFFSET).xyz;
+	vec3 objectPos2 = fetchVertexAttribute(vertex2, VERTEX_POSITION_OFFSET).xyz;
+	vec3 pos0 = (nodeMatrices.transform * vec4(objectPos0, 1.0f)).xyz;
+	vec3 pos1 = (nodeMatrices.transform * vec4(objectPos1, 1.0f)).xyz;
+	vec3 pos2 = (nodeMatrices.transform * vec4(objectPos2, 1.0f)).xyz;
+
+	// barycentrics at this pixel and its neighbors, used for texture filtering
+	vec2 screenSize = vec2(uniforms.screenSize);
+	vec2 barycentrics[3];
+	for (int i = 0; i < 3; ++i) {
+		vec2 pixel = gl_FragCoord.xy + vec2(i == 1 ? 1.0f : 0.0f, i == 2 ? 1.0f : 0.0f);
+		vec3 origin, direction;
+		getScreenRay(pixel / screenSize, uniforms.inverseProjectionViewMatrix, origin, direction);
+		barycentrics[i] = getRayTriangleBarycentrics(origin, direction, pos0, pos1, pos2);
+	}
+
+	vec2 uv0 = fetchVertexAttribute(vertex0, VERTEX_UV_OFFSET).xy;
+	vec2 uv1 = fetchVertexAttribute(vertex1, VERTEX_UV_OFFSET).xy;
+	vec2 uv2 = fetchVertexAttribute(vertex2, VERTEX_UV_OFFSET).xy;
+	vec2 uv = interpolate(uv0, uv1, uv2, barycentrics[0]);
+	vec2 uvDx = interpolate(uv0, uv1, uv2, barycentrics[1]) - uv;
+	vec2 uvDy = interpolate(uv0, uv1, uv2, barycentrics[2]) - uv;
+
+	vec3 position = interpolate(pos0, pos1, pos2, barycentrics[0]);
+	vec3 objectPosition = interpolate(objectPos0, objectPos1, objectPos2, barycentrics[0]);
+	vec3 normal = normalize((nodeMatrices.transformInverseTransposed * vec4(interpolate(
+		fetchVertexAttribute(vertex0, VERTEX_NORMAL_OFFSET).xyz,
+		fetchVertexAttribute(vertex1, VERTEX_NORMAL_OFFSET).xyz,
+		fetchVertexAttribute(vertex2, VERTEX_NORMAL_OFFSET).xyz,
+		barycentrics[0]
+	), 0.0f)).xyz);
+	vec4 tangent = interpolate(
+		fetchVertexAttribute(vertex0, VERTEX_TANGENT_OFFSET),
+		fetchVertexAttribute(vertex1, VERTEX_TANGENT_OFFSET),
+		fetchVertexAttribute(vertex2, VERTEX_TANGENT_OFFSET),
+		barycentrics[0]
+	);
+	tangent.xyz = normalize((nodeMatrices.transform * vec4(tangent.xyz, 0.0f)).xyz);
+
+	writeGBuffer(
+		position, normal, tangent, uv, uvDx, uvDy,
+		uniforms.projectionViewMatrix * vec4(position, 1.0f),
+		uniforms.prevFrameProjectionViewMatrix * nodeMatrices.prevFrameTransform * vec4(objectPosition, 1.0f)
+	);
+}
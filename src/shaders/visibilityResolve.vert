@@ -0,0 +1,19 @@
+#version 450
+
+#include "include/visibilityBuffer.glsl"
+
+layout (push_constant) uniform PushConstants {
+	uint materialIndex;
+} constants;
+
+vec2 positions[4] = vec2[](
+	vec2(-1.0f, -1.0f),
+	vec2(-1.0f,  1.0f),
+	vec2( 1.0f, -1.0f),
+	vec2( 1.0f,  1.0f)
+);
+
+void main() {
+	// only pixels of this material pass the depth test
+	gl_Position = vec4(positions[gl_VertexIndex], getMaterialDepth(constants.materialIndex), 1.0f);
+}
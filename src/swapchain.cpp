@@ -45,4 +45,12 @@ Swapchain Swapchain::create(vk::Device device, const vk::SwapchainCreateInfoKHR
 	result._imageFormat = createInfo.imageFormat;
 	result._imageExtent = createInfo.imageExtent;
 	return result;
+}
+
+Swapchain Swapchain::createOffscreen(std::vector<vk::Image> images, vk::Format format, vk::Extent2D extent) {
+	Swapchain result;
+	result._swapchainImages = std::move(images);
+	result._imageFormat = format;
+	result._imageExtent = extent;
+	return result;
 }
\ No newline at end of file
@@ -38,6 +38,8 @@ public:
 	}
 
 	[[nodiscard]] static Swapchain create(vk::Device, const vk::SwapchainCreateInfoKHR&);
+	// wraps images that are not owned by the returned object, used for rendering without a window
+	[[nodiscard]] static Swapchain createOffscreen(std::vector<vk::Image>, vk::Format, vk::Extent2D);
 private:
 	std::vector<vk::Image> _swapchainImages;
 	vk::UniqueSwapchainKHR _swapchain;
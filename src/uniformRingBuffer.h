@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include <vulkan/vulkan.hpp>
+
+#include "misc.h"
+#include "vma.h"
+
+// A persistently mapped uniform buffer divided into one region per frame that can be in flight. Each uniform struct is
+// reserved once and lives at the same offset in every region, and is bound as a dynamic uniform buffer with the offset
+// of the region of the frame being rendered. Uniforms of a frame are thus written in place without mapping memory,
+// and without touching regions that are still being read by frames in flight.
+class UniformRingBuffer {
+public:
+	UniformRingBuffer() = default;
+	UniformRingBuffer(UniformRingBuffer&&) = default;
+	UniformRingBuffer &operator=(UniformRingBuffer&&) = default;
+
+	// reserves space for a T in every frame and returns its offset from the start of a frame. all uniforms need to be
+	// reserved before allocate() is called
+	template <typename T> [[nodiscard]] uint32_t reserve() {
+		assert(!_mapped);
+		uint32_t offset = _frameSize;
+		_frameSize = ceilDiv(offset + static_cast<uint32_t>(sizeof(T)), _alignment) * _alignment;
+		return offset;
+	}
+	void allocate(vma::Allocator &allocator, std::size_t numFrames) {
+		_numFrames = numFrames;
+		_buffer = allocator.createBuffer(
+			static_cast<uint32_t>(_frameSize * numFrames), vk::BufferUsageFlagBits::eUniformBuffer,
+			VMA_MEMORY_USAGE_CPU_TO_GPU, nullptr, VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
+		_mapped = static_cast<std::byte*>(_buffer.getMappedData());
+	}
+
+	// the dynamic offset to bind a uniform struct with for the given frame
+	[[nodiscard]] uint32_t getDynamicOffset(std::size_t frame, uint32_t offset) const {
+		assert(frame < _numFrames && offset < _frameSize);
+		return static_cast<uint32_t>(frame) * _frameSize + offset;
+	}
+	// the uniforms of the given frame. the last submission of that frame must have finished
+	template <typename T> [[nodiscard]] T &at(std::size_t frame, uint32_t offset) {
+		return *reinterpret_cast<T*>(_mapped + getDynamicOffset(frame, offset));
+	}
+	// makes the writes to the region of the frame visible to the device
+	void flush(std::size_t frame) {
+		_buffer.flush(getDynamicOffset(frame, 0), _frameSize);
+	}
+
+	[[nodiscard]] vk::Buffer getBuffer() const {
+		return _buffer.get();
+	}
+
+	// offsets are aligned to minUniformBufferOffsetAlignment of the device
+	[[nodiscard]] static UniformRingBuffer create(vk::PhysicalDevice physicalDevice) {
+		UniformRingBuffer result;
+		result._alignment = static_cast<uint32_t>(
+			physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment
+		);
+		return result;
+	}
+private:
+	vma::UniqueBuffer _buffer;
+	std::byte *_mapped = nullptr;
+	std::size_t _numFrames = 0;
+	uint32_t _frameSize = 0;
+	uint32_t _alignment = 1;
+};
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 
 #include <vulkan/vulkan.hpp>
 
 #include <nvmath_glsltypes.h>
 
+#include "shaderIncludes.h"
+
 struct Vertex {
 	nvmath::vec4 position;
 	nvmath::vec4 normal;
@@ -13,3 +16,10 @@ struct Vertex {
 	nvmath::vec4 color;
 	nvmath::vec2 uv;
 };
+
+// visibilityResolve.frag reads vertices as arrays of floats
+static_assert(sizeof(Vertex) == VERTEX_FLOAT_COUNT * sizeof(float));
+static_assert(offsetof(Vertex, position) == VERTEX_POSITION_OFFSET * sizeof(float));
+static_assert(offsetof(Vertex, normal) == VERTEX_NORMAL_OFFSET * sizeof(float));
+static_assert(offsetof(Vertex, tangent) == VERTEX_TANGENT_OFFSET * sizeof(float));
+static_assert(offsetof(Vertex, uv) == VERTEX_UV_OFFSET * sizeof(float));
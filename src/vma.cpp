@@ -11,6 +11,11 @@ namespace vma {
 		const vk::BufferCreateInfo &vkBufferInfo, const VmaAllocationCreateInfo &allocationInfo
 	) {
 		auto bufferInfo = static_cast<VkBufferCreateInfo>(vkBufferInfo);
+		if (_bufferQueueFamilies.size() > 1) {
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(_bufferQueueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = _bufferQueueFamilies.data();
+		}
 		UniqueBuffer result;
 		VkBuffer buffer;
 		vkCheck(vmaCreateBuffer(_allocator, &bufferInfo, &allocationInfo, &buffer, &result._allocation, nullptr));
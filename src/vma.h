@@ -54,9 +54,16 @@ namespace vma {
 		void unmap() {
 			vmaUnmapMemory(_getAllocator(), _allocation);
 		}
+		// the pointer to the memory of an allocation created with VMA_ALLOCATION_CREATE_MAPPED_BIT, which stays valid
+		// for the lifetime of the allocation. null for other allocations
+		[[nodiscard]] void *getMappedData() {
+			VmaAllocationInfo info;
+			vmaGetAllocationInfo(_getAllocator(), _allocation, &info);
+			return info.pMappedData;
+		}
 
-		void flush() {
-			vmaFlushAllocation(_getAllocator(), _allocation, 0, VK_WHOLE_SIZE);
+		void flush(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) {
+			vmaFlushAllocation(_getAllocator(), _allocation, offset, size);
 		}
 		void invalidate() {
 			vmaInvalidateAllocation(_getAllocator(), _allocation, 0, VK_WHOLE_SIZE);
@@ -132,7 +139,8 @@ namespace vma {
 		template <typename, typename> friend struct UniqueHandle;
 	public:
 		Allocator() = default;
-		Allocator(Allocator &&src) : _allocator(src._allocator) {
+		Allocator(Allocator &&src) :
+			_allocator(src._allocator), _bufferQueueFamilies(std::move(src._bufferQueueFamilies)) {
 			assert(&src != this);
 			src._allocator = nullptr;
 		}
@@ -141,6 +149,7 @@ namespace vma {
 			assert(&src != this);
 			reset();
 			_allocator = src._allocator;
+			_bufferQueueFamilies = std::move(src._bufferQueueFamilies);
 			src._allocator = nullptr;
 			return *this;
 		}
@@ -150,6 +159,11 @@ namespace vma {
 		}
 
 		[[nodiscard]] UniqueBuffer createBuffer(const vk::BufferCreateInfo&, const VmaAllocationCreateInfo&);
+		// if there are multiple families, all buffers created afterwards are shared concurrently between them regardless
+		// of the sharing mode they're created with, so that they can be used on all queues without ownership transfers
+		void setBufferQueueFamilies(std::vector<uint32_t> families) {
+			_bufferQueueFamilies = std::move(families);
+		}
 		[[nodiscard]] UniqueImage createImage(const vk::ImageCreateInfo&, const VmaAllocationCreateInfo&);
 
 		[[nodiscard]] UniqueImage createImage2D(
@@ -164,7 +178,7 @@ namespace vma {
 		);
 		[[nodiscard]] UniqueBuffer createBuffer(
 			uint32_t size, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage,
-			const std::vector<uint32_t> *sharedQueues = nullptr
+			const std::vector<uint32_t> *sharedQueues = nullptr, VmaAllocationCreateFlags allocationFlags = 0
 		) {
 			vk::BufferCreateInfo bufferInfo;
 			bufferInfo
@@ -180,12 +194,13 @@ namespace vma {
 
 			VmaAllocationCreateInfo allocationInfo{};
 			allocationInfo.usage = memoryUsage;
+			allocationInfo.flags = allocationFlags;
 
 			return createBuffer(bufferInfo, allocationInfo);
 		}
 		template <typename T> [[nodiscard]] UniqueBuffer createTypedBuffer(
 			std::size_t numElements, vk::BufferUsageFlags usage, VmaMemoryUsage memoryUsage,
-			const std::vector<uint32_t> *sharedQueues = nullptr
+			const std::vector<uint32_t> *sharedQueues = nullptr, VmaAllocationCreateFlags allocationFlags = 0
 		) {
 			vk::BufferCreateInfo bufferInfo;
 			bufferInfo
@@ -201,6 +216,7 @@ namespace vma {
 
 			VmaAllocationCreateInfo allocationInfo{};
 			allocationInfo.usage = memoryUsage;
+			allocationInfo.flags = allocationFlags;
 
 			return createBuffer(bufferInfo, allocationInfo);
 		}
@@ -218,6 +234,11 @@ namespace vma {
 		{
 			vmaFreeMemory(_allocator, allocation);
 		}
+		// binds a buffer created outside of the allocator to a part of an allocation, which may be shared with other
+		// buffers
+		void bindBufferMemory(VmaAllocation allocation, vk::DeviceSize offset, vk::Buffer buffer) {
+			vkCheck(vmaBindBufferMemory2(_allocator, allocation, offset, buffer, nullptr));
+		}
 		void reset() {
 			if (_allocator) {
 				vmaDestroyAllocator(_allocator);
@@ -236,5 +257,6 @@ namespace vma {
 		);
 	private:
 		VmaAllocator _allocator = nullptr;
+		std::vector<uint32_t> _bufferQueueFamilies;
 	};
 }